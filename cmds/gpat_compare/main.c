@@ -46,12 +46,20 @@ int is_the_same_bbox_proj(SML_DATA_HEADER *dh0, SML_DATA_HEADER *dh1) {
 }
 
 
-void calc_simil_layer(SML_DATA_HEADER *dh0, SML_DATA_HEADER *dh1,char *fname, char *dtype, PALETTE *pal, int *nodata, distance_func *func) {
+/* 
+ * sfunc (if not NULL) compares sparse rows of layers without decoding cells,
+ * ffunc and qfunc compare cells of layers both stored as float or uint16q,
+ * cells of other types are converted to double for func
+ */
+void calc_simil_layer(SML_DATA_HEADER *dh0, SML_DATA_HEADER *dh1,char *fname, char *dtype, PALETTE *pal, int *nodata, distance_func *func, sparse_distance_func *sfunc, float_distance_func *ffunc, q16_distance_func *qfunc) {
 
   EZGDAL_LAYER *l;
 
   int r, c, rows, cols, size;
-  void *rowbuf0, *rowbuf1; 
+  void *rowbuf0, *rowbuf1, *row0 = NULL, *row1 = NULL; 
+  SML_SPARSE_ROW *sr0 = NULL, *sr1 = NULL;
+  SML_D_TYPE d_type = dh0->cell_type->d_type;
+  double *cellbuf = NULL;
 
   double a = 1.0;
   double b = 0.0;
@@ -78,24 +86,76 @@ void calc_simil_layer(SML_DATA_HEADER *dh0, SML_DATA_HEADER *dh1,char *fname, ch
                                
   rowbuf0 = sml_create_cell_row_buffer(dh0);
   rowbuf1 = sml_create_cell_row_buffer(dh1);
+  if(sfunc != NULL) {
+    sr0 = sml_create_sparse_row(dh0);
+    sr1 = sml_create_sparse_row(dh1);
+  }
+  if(d_type != dh1->cell_type->d_type)
+    d_type = SML_DOUBLE;
+  if((d_type == SML_FLOAT && ffunc != NULL) || (d_type == SML_UINT16Q && qfunc != NULL))
+    func = NULL;
+  else if(dh0->cell_type->d_type != SML_DOUBLE || dh1->cell_type->d_type != SML_DOUBLE)
+    cellbuf = malloc(2*omp_get_max_threads()*size*sizeof(double));
  
   ezgdal_show_progress(stdout,0,rows);
   for(r=0; r<rows; r++) {
     ezgdal_show_progress(stdout,r,rows);
-    sml_read_row_from_layer(dh0,rowbuf0,r);
-    sml_read_row_from_layer(dh1,rowbuf1,r);
+    if(sfunc != NULL) {
+      sml_read_sparse_row_from_layer(dh0,sr0,r);
+      sml_read_sparse_row_from_layer(dh1,sr1,r);
+    } else {
+      row0 = sml_get_row_view(dh0,rowbuf0,r);
+      row1 = sml_get_row_view(dh1,rowbuf1,r);
+    }
 
 #pragma omp parallel for
     for(c=0; c<cols; c++) {
-      void *cell0 = sml_get_cell_pointer(dh0,rowbuf0,c);
-      void *cell1 = sml_get_cell_pointer(dh1,rowbuf1,c);
+      if(sfunc != NULL) {
+        if(sr0->null[c] || sr1->null[c]) {
+          ezgdal_set_null(l,&(l->buffer[c]));
+        } else {
+          sparse_signature cs0, cs1, *sbuf[2];
+          cs0.n = sr0->start[c+1]-sr0->start[c];
+          cs0.idx = sr0->idx+sr0->start[c];
+          cs0.val = sr0->val+sr0->start[c];
+          cs1.n = sr1->start[c+1]-sr1->start[c];
+          cs1.idx = sr1->idx+sr1->start[c];
+          cs1.val = sr1->val+sr1->start[c];
+          sbuf[0] = &cs0;
+          sbuf[1] = &cs1;
+          l->buffer[c] = a*(1.0-sfunc(sbuf,2,size,dh0->cell_type->dim,dh0->cell_type->dims))+b;
+        }
+        continue;
+      }
+      void *cell0 = sml_get_cell_pointer(dh0,row0,c);
+      void *cell1 = sml_get_cell_pointer(dh1,row1,c);
       if(sml_is_cell_null(cell0) || sml_is_cell_null(cell1)) {
         ezgdal_set_null(l,&(l->buffer[c]));
       } else {
-        double *buf[2];
-        buf[0] = sml_get_cell_data(cell0);
-        buf[1] = sml_get_cell_data(cell1);
-        l->buffer[c] = a*(1.0-func(buf,2,size,dh0->cell_type->dim,dh0->cell_type->dims))+b;
+        double d;
+        if(func == NULL && d_type == SML_FLOAT) {
+          float *buf[2];
+          buf[0] = sml_get_cell_data(cell0);
+          buf[1] = sml_get_cell_data(cell1);
+          d = ffunc(buf,2,size,dh0->cell_type->dim,dh0->cell_type->dims);
+        } else if(func == NULL) {
+          unsigned short *buf[2];
+          buf[0] = sml_get_cell_data(cell0);
+          buf[1] = sml_get_cell_data(cell1);
+          d = qfunc(buf,2,size,dh0->cell_type->dim,dh0->cell_type->dims);
+        } else {
+          double *buf[2];
+          buf[0] = sml_get_cell_data(cell0);
+          buf[1] = sml_get_cell_data(cell1);
+          if(cellbuf != NULL) {
+            buf[0] = cellbuf+2*omp_get_thread_num()*size;
+            buf[1] = buf[0]+size;
+            sml_get_data_dbl(dh0,sml_get_cell_data(cell0),buf[0]);
+            sml_get_data_dbl(dh1,sml_get_cell_data(cell1),buf[1]);
+          }
+          d = func(buf,2,size,dh0->cell_type->dim,dh0->cell_type->dims);
+        }
+        l->buffer[c] = a*(1.0-d)+b;
       }
     }
     ezgdal_write_buffer(l,r);
@@ -107,6 +167,9 @@ void calc_simil_layer(SML_DATA_HEADER *dh0, SML_DATA_HEADER *dh1,char *fname, ch
 
   free(rowbuf0);
   free(rowbuf1);
+  free(cellbuf);
+  sml_free_sparse_row(sr0);
+  sml_free_sparse_row(sr1);
 
   ezgdal_close_layer(l);
 
@@ -122,6 +185,10 @@ int main(int argc, char **argv) {
     int _nodata = -9999;
     char *dtype = "Float64";
     distance_func *func = get_distance("jsd");
+    sparse_distance_func *sfunc = NULL;
+    float_distance_func *ffunc = NULL;
+    q16_distance_func *qfunc = NULL;
+    char *mname = "jsd";
     PALETTE *palette = NULL;
 
     struct arg_str  *inp   = arg_strn("i","input","<file_name>",2,2,"name of input files (GRID)");
@@ -131,10 +198,13 @@ int main(int argc, char **argv) {
     struct arg_str  *pal   = arg_str0("p","palette","<file_name>","name of the file with colors definition (CSV)");
     struct arg_str  *type  = arg_str0(NULL,"type","Byte/....","output data type (default: Float64)");
     struct arg_int  *nodat = arg_int0("n","no_data","<n>","output NO DATA value (default: none)");
+    struct arg_str  *cmpr  = arg_str0(NULL,"compress","<method>","output compression: DEFLATE, LZW, ZSTD, ... (default: none)");
+    struct arg_lit  *cog   = arg_lit0(NULL,"cog","write output as Cloud Optimized GeoTIFF");
     struct arg_int  *th    = arg_int0("t",NULL,"<n>","number of threads (default: 1)");
+    struct arg_lit  *mmp   = arg_lit0(NULL,"mmap","read input grids directly from the mapped files");
     struct arg_lit  *help  = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end   = arg_end(20);
-    void* argtable[] = {inp,out,type,pal,nodat,mes,mesl,th,help,end};
+    void* argtable[] = {inp,out,type,pal,nodat,cmpr,cog,mes,mesl,th,mmp,help,end};
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -157,7 +227,8 @@ int main(int argc, char **argv) {
     }
 
     if(mes->count > 0) {
-      func = get_distance((char *)(mes->sval[0]));
+      mname = (char *)(mes->sval[0]);
+      func = get_distance(mname);
       /* measure not found */
       if(func==NULL) {
         printf("\nWrong similarity measure: %s\n\n",mes->sval[0]);
@@ -175,6 +246,10 @@ int main(int argc, char **argv) {
     else
       omp_set_num_threads(1);
 
+    /* tiled and compressed output */
+    if(cmpr->count > 0 || cog->count > 0)
+      ezgdal_set_writer_options((cmpr->count > 0) ? cmpr->sval[0] : NULL, cog->count > 0);
+
     if(inp->count!=2) {
       printf("\nTwo input files (GRID) are needed!\n\n");
       usage(argv[0],argtable);
@@ -217,7 +292,19 @@ int main(int argc, char **argv) {
       usage(argv[0],argtable);
     }
 
-    calc_simil_layer(dh0, dh1, (char *)(out->sval[0]), dtype, palette, nodata, func);
+    if(mmp->count > 0) {
+      if(!sml_layer_mmap_mode(dh0))
+        printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[0]);
+      if(!sml_layer_mmap_mode(dh1))
+        printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[1]);
+    }
+
+    if(dh0->layout == SML_LAYOUT_SPARSE || dh1->layout == SML_LAYOUT_SPARSE)
+      sfunc = get_sparse_distance(mname);
+    ffunc = get_float_distance(mname);
+    qfunc = get_q16_distance(mname);
+
+    calc_simil_layer(dh0, dh1, (char *)(out->sval[0]), dtype, palette, nodata, func, sfunc, ffunc, qfunc);
 
     sml_close_layer(dh0);
     sml_close_layer(dh1);
@@ -42,29 +42,94 @@ void usage(char *progname, void *argtable) {
 }
 
 
+/* output grid of motifels of the size and shift */
+SML_DATA_HEADER *create_grid(char *fname, int d_type, int *dims, EZGDAL_LAYER *layer,
+                             int size_val, int shift_val, int sparse, int codec,
+                             char **argv, int argc) {
+    SML_CELL_TYPE *cell_type = sml_create_cell_type((SML_D_TYPE)d_type,1,dims);
+    double *at = ezgdal_layer_get_at(layer);
+    char *wkt = ezgdal_layer_get_wkt(layer);
+
+    SML_WINDOW *window = sml_create_window(	
+                                    1+(layer->rows-size_val)/shift_val,
+                                    1+(layer->cols-size_val)/shift_val,
+                                    at[0]+at[1]*floor((size_val-shift_val)/2),
+                                    at[1]*shift_val,
+                                    at[2],
+                                    at[3]+at[5]*floor((size_val-shift_val)/2),
+                                    at[4],
+                                    at[5]*shift_val,
+                                    wkt
+                                  );
+
+    SML_DATA_HEADER *dh = sml_create_layer(fname, cell_type, window);
+    sml_set_layer_description(dh, argv, argc);
+    if(sparse)
+      sml_set_layer_layout(dh, SML_LAYOUT_SPARSE);
+    if(codec != SML_CODEC_NONE)
+      sml_set_layer_blocks(dh, 0, (SML_CODEC)codec);
+    free(at);
+    return dh;
+}
+
+/* stores the signature sign of a motifel (res as returned by signature 
+   functions) in the cell, sign is the cell's data or a buffer */
+void set_signature_cell(SML_DATA_HEADER *dh, void *cell, double *sign, int sign_len, 
+                        int res, normalization_func *norm_func) {
+    if(res==1) {
+
+      sml_set_cell_not_null(cell);
+      if(norm_func(sign, sign_len)!=0) {
+#pragma omp critical(gridhis_message)
+        printf("\nNormalization error!\n\n");
+        sml_set_cell_null(cell);
+      } else if(sign != sml_get_cell_data(cell))
+        sml_set_data_dbl(dh, sign, sml_get_cell_data(cell));
+
+    } else
+      sml_set_cell_null(cell);
+}
+
+
 int main(int argc, char **argv) {
 
-    int ninputs,i,r,c;
+    int ninputs,i,k,r,c;
 
     int size_val = 150;
     int shift_val = 100;
     int level_val = 0;
-    signature_func *sign_func = get_signature("cooc");
-    signature_len_func *sign_len_func = get_signature_len("cooc");
-    normalization_func *norm_func = get_normalization_method("pdf");
+    /* signatures calculated in one pass, with their normalizations */
+    int nsigns = 1;
+    char **sign_names = NULL;
+    normalization_func **norm_funcs = NULL;
 
     struct arg_str  *inp   = arg_str1("i","input","<file_name>","name of input file (GeoTIFF)");
-    struct arg_str  *out   = arg_str1("o","output","<file_name>","name of output file (GRID)");
-    struct arg_str  *sig   = arg_str0("s","signature","<signature_name>","motifel's signature (use -l to list all signatures, default: 'cooc')");
+    struct arg_str  *out   = arg_strn("o","output","<file_name>",1,16,"name of output file (GRID), one for every signature or one for all signatures concatenated");
+    struct arg_str  *sig   = arg_strn("s","signature","<signature_name>",0,16,"motifel's signature, may be repeated (use -l to list all signatures, default: 'cooc')");
     struct arg_int  *lvl   = arg_int0(NULL,"level","<n>","full decomposition level (default: 0, auto)");
     struct arg_int  *size  = arg_int0("z","size","<n>","motifel size in cells (default: 150)");
     struct arg_int  *shift = arg_int0("f","shift","<n>","shift of motifels (default: 100)");
-    struct arg_str  *norm  = arg_str0("n","normalization","<normalization_name>","signature normalization method (use -l to list all methods, default: 'pdf')");
+    struct arg_str  *norm  = arg_strn("n","normalization","<normalization_name>",0,16,"signature normalization method, one for all signatures or one for every signature (use -l to list all methods, default: 'pdf')");
     struct arg_lit  *list  = arg_lit0("l",NULL,"list all signatures and normalization methods");
     struct arg_int  *th    = arg_int0("t",NULL,"<n>","number of threads (default: 1)");
+    struct arg_lit  *pref  = arg_lit0(NULL,"prefetch","read next row of motifels in background");
+    struct arg_lit  *mmp   = arg_lit0(NULL,"mmap","read uncompressed inputs directly from the mapped file");
+    struct arg_str  *win   = arg_str0(NULL,"window","<c,r,cols,rows>","process only a window of the input (cells)");
+    struct arg_str  *bbox  = arg_str0(NULL,"bbox","<xmin,ymin,xmax,ymax>","process only a bounding box of the input (map units)");
+    struct arg_str  *msk   = arg_str0(NULL,"mask","<file_name>","process only cells not null and not zero in the mask (GeoTIFF)");
+    struct arg_lit  *sps   = arg_lit0(NULL,"sparse","store only not zero elements of signatures (e.g. 'cooc' of many categories)");
+    struct arg_str  *cmpr  = arg_str0(NULL,"compress","<method>","output compression: LZ, ZSTD, LZ4 (default: none)");
+    struct arg_str  *stor  = arg_str0(NULL,"storage","<type>","storage of signatures: float32, uint16q (values of 0..1, 'pdf' or '01') (default: double)");
+    struct arg_str  *pyr   = arg_str0(NULL,"pyramid","<size,...>","also grids of larger motifels from the same pass (multiples of size, shift scaled alike; prod, cooc, ent), written to <output>_<size>");
     struct arg_lit  *help  = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end   = arg_end(20);
-    void* argtable[] = {inp,out,sig,lvl,size,shift,norm,list,th,help,end};
+    void* argtable[] = {inp,out,sig,lvl,size,shift,norm,list,th,pref,mmp,win,bbox,msk,sps,cmpr,stor,pyr,help,end};
+    int codec = SML_CODEC_NONE;
+    int d_type = SML_DOUBLE;
+    /* levels of the pyramid, the first one is -z/-f */
+    int nlevels = 1;
+    int *level_size = NULL;
+    int *level_shift = NULL;
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -89,32 +154,71 @@ int main(int argc, char **argv) {
       usage(argv[0],argtable);
     }
 
-    if(sig->count > 0) {
-      sign_func = get_signature((char *)(sig->sval[0]));
-      sign_len_func = get_signature_len((char *)(sig->sval[0]));
+    if(sig->count > 0)
+      nsigns = sig->count;
+    sign_names = (char **)malloc(nsigns*sizeof(char *));
+    norm_funcs = (normalization_func **)malloc(nsigns*sizeof(normalization_func *));
+    ninputs = 1;
+    for(k=0; k<nsigns; k++) {
+      sign_names[k] = (sig->count > 0) ? (char *)(sig->sval[k]) : "cooc";
       /* signature not found */
-      if(sign_func==NULL || sign_len_func==NULL) {
-        printf("\nWrong signature name: %s\n\n",sig->sval[0]);
+      if(get_signature(sign_names[k])==NULL || get_signature_len(sign_names[k])==NULL) {
+        printf("\nWrong signature name: %s\n\n",sign_names[k]);
         printf("List of available signatures:\n");
         char *list = list_all_signatures();
         printf("\n%s\n",list);
         free(list);
         exit(0);
       }
+      if(strcmp(sign_names[k],"prod")==0)
+        ninputs=inp->count;
     }
-    if(strcmp(sig->sval[0],"prod")!=0) {
-      if(inp->count>1)
-        printf("\nSignatures will be calculated for [%s] only!\n\n",inp->sval[0]);
-      ninputs=1;
-    } else {
-      ninputs=inp->count;
+    if(ninputs==1 && inp->count>1)
+      printf("\nSignatures will be calculated for [%s] only!\n\n",inp->sval[0]);
+
+    if(norm->count > 1 && norm->count != nsigns) {
+      printf("\nGive one normalization method or one for every signature!\n\n");
+      usage(argv[0],argtable);
     }
 
-    if(norm->count > 0) {
-      norm_func = get_normalization_method((char *)(norm->sval[0]));
+    if(out->count > 1 && out->count != nsigns) {
+      printf("\nGive one output file or one for every signature!\n\n");
+      usage(argv[0],argtable);
+    }
+
+    if(cmpr->count > 0) {
+      codec = sml_get_codec(cmpr->sval[0]);
+      if(codec < 0) {
+        printf("\nCompression method '%s' is not available!\n\n", cmpr->sval[0]);
+        usage(argv[0],argtable);
+      }
+      if(sps->count > 0) {
+        printf("\nSparse grids can not be compressed!\n\n");
+        usage(argv[0],argtable);
+      }
+    }
+
+    if(stor->count > 0) {
+      d_type = sml_get_d_type(stor->sval[0]);
+      if(d_type < 0) {
+        printf("\nStorage type '%s' is not available!\n\n", stor->sval[0]);
+        usage(argv[0],argtable);
+      }
+      for(k=0; k<norm->count; k++)
+        if(d_type == SML_UINT16Q && 
+           strcmp(norm->sval[k],"pdf")!=0 && strcmp(norm->sval[k],"01")!=0) {
+          printf("\nStorage 'uint16q' needs signatures normalized to 'pdf' or '01'!\n\n");
+          usage(argv[0],argtable);
+        }
+    }
+
+    for(k=0; k<nsigns; k++) {
+      char *norm_name = (norm->count > 1) ? (char *)(norm->sval[k]) :
+                        (norm->count > 0) ? (char *)(norm->sval[0]) : "pdf";
+      norm_funcs[k] = get_normalization_method(norm_name);
       /* signature not found */
-      if(norm_func==NULL) {
-        printf("\nWrong signature name: %s\n\n",norm->sval[0]);
+      if(norm_funcs[k]==NULL) {
+        printf("\nWrong signature name: %s\n\n",norm_name);
         printf("List of available local normalization methods:\n");
         char *list = list_all_normalization_methods();
         printf("\n%s\n",list);
@@ -131,7 +235,8 @@ int main(int argc, char **argv) {
       }
     }
 
-    if(sig->count>0 && strcmp(sig->sval[0],"fdec")==0) {
+    for(k=0; k<nsigns && strcmp(sign_names[k],"fdec")!=0; k++);
+    if(k<nsigns) {
       if((size_val != 0) && ((size_val & (~size_val + 1)) != size_val)) {
         printf("\nFor the full decomposition, size has to be a power of two.\n\n");
         exit(0);
@@ -159,6 +264,34 @@ int main(int argc, char **argv) {
       exit(0);
     }
 
+    if(pyr->count > 0) {
+      char *list = strdup(pyr->sval[0]);
+      char *p;
+
+      if(nsigns > 1 || out->count > 1) {
+        printf("\nPyramid of grids is available for one signature only!\n\n");
+        usage(argv[0],argtable);
+      }
+      if(get_signature_integral_type(sign_names[0]) == SIGNATURE_INTEGRAL_NONE) {
+        printf("\nPyramid of grids is available for 'prod', 'cooc' and 'ent' only!\n\n");
+        usage(argv[0],argtable);
+      }
+      level_size = (int *)malloc((strlen(list)+2)*sizeof(int));
+      level_shift = (int *)malloc((strlen(list)+2)*sizeof(int));
+      level_size[0] = size_val;
+      level_shift[0] = shift_val;
+      for(p=strtok(list,","); p!=NULL; p=strtok(NULL,",")) {
+        level_size[nlevels] = atoi(p);
+        if(level_size[nlevels] <= level_size[nlevels-1] || level_size[nlevels] % size_val != 0) {
+          printf("\nSizes of the pyramid have to grow and be multiples of 'size': %s\n\n", p);
+          usage(argv[0],argtable);
+        }
+        level_shift[nlevels] = shift_val * (level_size[nlevels] / size_val);
+        nlevels++;
+      }
+      free(list);
+    }
+
     /* set number of threads */
     if (th->count > 0) 
       omp_set_num_threads(th->ival[0]);
@@ -184,6 +317,13 @@ int main(int argc, char **argv) {
         printf("\nCannot open file: '%s'\n\n", inp->sval[i]);
         usage(argv[0],argtable);
       }
+      if(!ezgdal_layer_set_region(input_layers[i],
+                                  (win->count>0) ? win->sval[0] : NULL,
+                                  (bbox->count>0) ? bbox->sval[0] : NULL,
+                                  (msk->count>0) ? msk->sval[0] : NULL)) {
+        printf("\nWrong window, bounding box or mask for: '%s'\n\n", inp->sval[i]);
+        usage(argv[0],argtable);
+      }
     }
 
 
@@ -197,91 +337,244 @@ int main(int argc, char **argv) {
       usage(argv[0],argtable);
     }
 
+    /* the pyramid reads stripes of blocks, of which all motifels are made */
+    int stripe_size = size_val;
+    int stripe_shift = shift_val;
+    if(nlevels > 1) {
+      int a = size_val, b = shift_val, t;
+      while(b != 0) {
+        t = a % b;
+        a = b;
+        b = t;
+      }
+      stripe_size = stripe_shift = a;
+      if(level_size[nlevels-1] > input_layers[0]->rows || level_size[nlevels-1] > input_layers[0]->cols) {
+        printf("\nMotifels of size %d are larger than the input!\n\n", level_size[nlevels-1]);
+        usage(argv[0],argtable);
+      }
+    }
+
     for(i=0; i<ninputs; i++) {
-      ezgdal_create_stripe(input_layers[i],0,size_val);
-      ezgdal_create_all_frames(input_layers[i]->stripe,0,shift_val);
+      ezgdal_create_stripe(input_layers[i],0,stripe_size);
+      ezgdal_create_all_frames(input_layers[i]->stripe,0,stripe_shift);
+      if(pref->count > 0 && !ezgdal_stripe_prefetch_mode(input_layers[i]->stripe))
+        printf("\nPrefetching is not available for: '%s'\n\n", inp->sval[i]);
+      /* one dataset handle per thread, stripes are decoded in parallel */
+      if(th->count > 0 && th->ival[0] > 1)
+        ezgdal_layer_open_handles(input_layers[i], th->ival[0]);
     }
 
     printf("Calculating statistics...     "); fflush(stdout);
-#pragma omp parallel for
+    for(i=0; i<ninputs; i++)
+      ezgdal_calc_layer_categories(input_layers[i]);
+    printf("OK\n"); fflush(stdout);
+
+    /* mapped inputs are not copied, so their values are not translated;
+       categorical signatures get category indices translated once per load */
+    for(k=0; k<nsigns && is_signature_categorical(sign_names[k]); k++);
     for(i=0; i<ninputs; i++) {
-      ezgdal_calc_layer_stats(input_layers[i]);
-      double min = input_layers[i]->stats->min;
-      min = min - 0.5;
-      double max = input_layers[i]->stats->max;
-      max = max + 0.5;
-      int N = (int)floor(fabs(max-min));
-      ezgdal_calc_value_map(input_layers[i],min,max,N);
+      if(mmp->count > 0) {
+        if(ezgdal_layer_mmap_mode(input_layers[i]))
+          continue;
+        printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[i]);
+      }
+      if(k==nsigns)
+        ezgdal_stripe_category_mode(input_layers[i]->stripe);
     }
-    printf("OK\n"); fflush(stdout);
+
+    /* frames know their null cells, signatures skip empty motifs early */
+    for(i=0; i<ninputs; i++)
+      ezgdal_stripe_validity_mode(input_layers[i]->stripe);
 
 
-    int *dims = (int *)malloc(sizeof(int));
-    dims[0] = sign_len_func(input_layers, ninputs, level_val);
-    if(dims[0]<0) {
+    SIGNATURE_SET *set = signature_set_create(sign_names, norm_funcs, nsigns, input_layers, ninputs, level_val);
+    if(set==NULL) {
       printf("\nSignature length cannot be determined!\n\n");
       usage(argv[0],argtable);
     }
-    printf("Signature length: %d\n",dims[0]); fflush(stdout);
+    if(nsigns == 1)
+      printf("Signature length: %d\n",set->len);
+    else
+      for(k=0; k<nsigns; k++)
+        printf("Signature '%s' length: %d\n",sign_names[k],set->signature_len[k]);
+    fflush(stdout);
+
+    /* a grid for every signature, or one grid of signatures concatenated */
+    int ngrids = out->count;
+    SML_DATA_HEADER **grid_dh = (SML_DATA_HEADER **)malloc(ngrids*sizeof(SML_DATA_HEADER *));
+    void **grid_buf = (void **)malloc(ngrids*sizeof(void *));
+    for(k=0; k<ngrids; k++) {
+      grid_dh[k] = create_grid((char *)(out->sval[k]), d_type, (ngrids > 1) ? &(set->signature_len[k]) : &(set->len),
+                               input_layers[0], size_val, shift_val, sps->count > 0, codec, argv, argc);
+      grid_buf[k] = sml_create_cell_row_buffer(grid_dh[k]);
+    }
+    if(ngrids == 1 && nsigns > 1)
+      printf("Concatenated signature length: %d\n",set->len);
+
+    /* motifels of a row are calculated in parallel, every thread
+       has its own frame list and signature buffer */
+    int nthreads = omp_get_max_threads();
+    EZGDAL_FRAME **frames = (EZGDAL_FRAME **)malloc(nthreads*ninputs*sizeof(EZGDAL_FRAME *));
+    /* signatures not stored as double are calculated here */
+    double *sign_buf = NULL;
+    if(d_type != SML_DOUBLE)
+      sign_buf = (double *)malloc(nthreads*set->len*sizeof(double));
+
+    if(nlevels > 1) {
+      /* histograms of blocks are counted once, motifels of all sizes 
+         are summed from them when their last row of blocks is read */
+      SML_DATA_HEADER **level_dh = (SML_DATA_HEADER **)malloc(nlevels*sizeof(SML_DATA_HEADER *));
+      void **level_buf = (void **)malloc(nlevels*sizeof(void *));
+      int *next_row = (int *)calloc(nlevels, sizeof(int));
+      int l, block_rows = input_layers[0]->rows / stripe_size;
+
+      int *dims = &(set->len);
+
+      SIGNATURE_PYRAMID *pyramid = signature_pyramid_create(sign_names[0], input_layers, ninputs, dims[0], 
+                                                            level_size[nlevels-1], nlevels);
+      if(pyramid == NULL) {
+        printf("\nPyramid of grids needs too much memory (blocks of %d cells)!\n\n", stripe_size);
+        exit(0);
+      }
+      level_dh[0] = grid_dh[0];
+      level_buf[0] = grid_buf[0];
+      for(l=1; l<nlevels; l++) {
+        char *fname = (char *)malloc(strlen(out->sval[0])+16);
+        sprintf(fname, "%s_%d", out->sval[0], level_size[l]);
+        level_dh[l] = create_grid(fname, d_type, dims, input_layers[0], 
+                                  level_size[l], level_shift[l], sps->count > 0, codec, argv, argc);
+        level_buf[l] = sml_create_cell_row_buffer(level_dh[l]);
+        printf("Pyramid grid: %s (size: %d, shift: %d)\n", fname, level_size[l], level_shift[l]);
+        free(fname);
+      }
 
-    double *at = ezgdal_layer_get_at(input_layers[0]);
-    char *wkt = ezgdal_layer_get_wkt(input_layers[0]);
+      printf("Calculating pyramid of grids...     "); fflush(stdout);
+      for(r=0; r<block_rows; r++) {
+        ezgdal_show_progress(stdout,r,block_rows);
+        for(i=0; i<ninputs; i++) {
+          ezgdal_load_stripe_data(input_layers[i]->stripe,r*stripe_size);
+          if(r+1<block_rows)
+            ezgdal_prefetch_stripe_data(input_layers[i]->stripe,(r+1)*stripe_size);
+        }
+        signature_pyramid_load(pyramid);
+
+        for(l=0; l<nlevels; l++)
+          while(next_row[l] < level_dh[l]->file_win->rows &&
+                (next_row[l]*level_shift[l] + level_size[l]) / stripe_size <= r+1) {
+            signature_pyramid_sum(pyramid, l, next_row[l]*level_shift[l], level_size[l]);
+
+#pragma omp parallel for schedule(dynamic)
+            for(c=0; c<level_dh[l]->file_win->cols; c++) {
+              int t = omp_get_thread_num();
+              void *cell = sml_get_cell_pointer(level_dh[l],level_buf[l],c);
+              double *cell_data = (sign_buf != NULL) ? sign_buf + t*dims[0] : sml_get_cell_data(cell);
+              int res = signature_pyramid_get(pyramid, l, c*level_shift[l], level_size[l], cell_data);
+              set_signature_cell(level_dh[l], cell, cell_data, dims[0], res, norm_funcs[0]);
+            }
+            sml_write_next_row_to_layer(level_dh[l],level_buf[l]);
+            next_row[l]++;
+          }
+      }
+      ezgdal_show_progress(stdout,100,100);
 
-    SML_CELL_TYPE *cell_type = sml_create_cell_type(SML_DOUBLE,1,dims);
-    SML_WINDOW *window = sml_create_window(	
-                                    1+(input_layers[0]->rows-size_val)/shift_val,
-                                    1+(input_layers[0]->cols-size_val)/shift_val,
-                                    at[0]+at[1]*floor((size_val-shift_val)/2),
-                                    at[1]*shift_val,
-                                    at[2],
-                                    at[3]+at[5]*floor((size_val-shift_val)/2),
-                                    at[4],
-                                    at[5]*shift_val,
-                                    wkt
-                                  );
+      for(l=0; l<nlevels; l++) {
+        sml_close_layer(level_dh[l]);
+        free(level_buf[l]);
+      }
+      free(level_dh);
+      free(level_buf);
+      free(next_row);
+      signature_pyramid_free(pyramid);
 
-    SML_DATA_HEADER *dh = sml_create_layer((char *)(out->sval[0]), cell_type, window);
-    sml_set_layer_description(dh, argv, argc);
+    } else {
 
-    void *buf = sml_create_cell_row_buffer(dh);
-    printf("Calculating grid of signatures...     "); fflush(stdout);
-    for(r=0; r<dh->file_win->rows; r++) {
-//printf("r: %d/%d\n",r,dh->file_win->rows); fflush(stdout);
-      ezgdal_show_progress(stdout,r,dh->file_win->rows);
-//printf("ninputs: %d\n",ninputs); fflush(stdout);
-      for(i=0; i<ninputs; i++)
-        ezgdal_load_stripe_data(input_layers[i]->stripe,r*shift_val);
-//printf("data read\n"); fflush(stdout);
-
-//#pragma omp parallel for 
-      for(c=0; c<dh->file_win->cols; c++) {
-        int i;
-
-        EZGDAL_FRAME **frames = malloc(ninputs*sizeof(EZGDAL_FRAME *));
-        for(i=0; i<ninputs; i++)
-          frames[i] = &(input_layers[i]->stripe->frame[c]);
-
-        void *cell=sml_get_cell_pointer(dh,buf,c);
-        double *cell_data = sml_get_cell_data(cell);
-        if(sign_func(frames, ninputs, cell_data, dims[0], level_val)==1) {
-
-          sml_set_cell_not_null(cell);
-          if(norm_func(cell_data, dims[0])!=0) {
-            printf("\nNormalization error!\n\n");
-            sml_set_cell_null(cell);
+      /* additive signatures of much overlapping motifels are taken 
+         from integral histograms of the stripes, or from histograms 
+         sliding along them if block sums need too much memory */
+      SML_DATA_HEADER *dh = grid_dh[0];
+      double **signs = (double **)malloc(nthreads*nsigns*sizeof(double *));
+      int *results = (int *)malloc(nthreads*nsigns*sizeof(int));
+
+      signature_set_integrals(set, input_layers);
+      for(k=0; k<nsigns; k++)
+        if(set->integral[k] != NULL && set->integral[k]->is_sliding)
+          printf("Sliding histograms: '%s'\n", sign_names[k]);
+        else if(set->integral[k] != NULL)
+          printf("Integral histograms: '%s', blocks of %d columns\n", sign_names[k], set->integral[k]->block);
+      /* sliding histograms need successive motifels in every thread */
+      omp_set_schedule(set->is_sliding ? omp_sched_static : omp_sched_dynamic, 0);
+      printf("Calculating grid of signatures...     "); fflush(stdout);
+      for(r=0; r<dh->file_win->rows; r++) {
+        ezgdal_show_progress(stdout,r,dh->file_win->rows);
+        for(i=0; i<ninputs; i++) {
+          ezgdal_load_stripe_data(input_layers[i]->stripe,r*shift_val);
+          if(r+1<dh->file_win->rows)
+            ezgdal_prefetch_stripe_data(input_layers[i]->stripe,(r+1)*shift_val);
+        }
+        signature_set_load(set);
+
+#pragma omp parallel for schedule(runtime)
+        for(c=0; c<dh->file_win->cols; c++) {
+          int i, k, g;
+          int t = omp_get_thread_num();
+
+          EZGDAL_FRAME **cell_frames = frames + t*ninputs;
+          for(i=0; i<ninputs; i++)
+            cell_frames[i] = &(input_layers[i]->stripe->frame[c]);
+
+          /* signatures are calculated in the cells, or in the buffer
+             if they are not stored as double */
+          double **cell_signs = signs + t*nsigns;
+          int *cell_results = results + t*nsigns;
+          for(k=0; k<nsigns; k++) {
+            g = (ngrids > 1) ? k : 0;
+            cell_signs[k] = (sign_buf != NULL) ? sign_buf + t*set->len + set->offset[k] :
+                            (double *)sml_get_cell_data(sml_get_cell_pointer(grid_dh[g],grid_buf[g],c)) + 
+                            ((ngrids > 1) ? 0 : set->offset[k]);
           }
+          signature_set_calc(set, cell_frames, c, cell_signs, cell_results);
+
+          for(k=0; k<nsigns; k++)
+            if(cell_results[k] < 0) {
+#pragma omp critical(gridhis_message)
+              printf("\nNormalization error!\n\n");
+            }
+
+          /* a concatenated signature is null if any of its parts is */
+          for(g=0; g<ngrids; g++) {
+            void *cell = sml_get_cell_pointer(grid_dh[g],grid_buf[g],c);
+            int k1 = (ngrids > 1) ? g : 0;
+            int k2 = (ngrids > 1) ? g+1 : nsigns;
+            for(k=k1; k<k2 && cell_results[k]==1; k++);
+            if(k<k2)
+              sml_set_cell_null(cell);
+            else {
+              sml_set_cell_not_null(cell);
+              if(sign_buf != NULL)
+                sml_set_data_dbl(grid_dh[g], cell_signs[k1], sml_get_cell_data(cell));
+            }
+          }
+        }
+        for(k=0; k<ngrids; k++)
+          sml_write_next_row_to_layer(grid_dh[k],grid_buf[k]);
+      }
+      ezgdal_show_progress(stdout,100,100);
 
-        } else
-          sml_set_cell_null(cell);
-
-        free(frames);
+      for(k=0; k<ngrids; k++) {
+        sml_close_layer(grid_dh[k]);
+        free(grid_buf[k]);
       }
-      sml_write_next_row_to_layer(dh,buf);
+      free(signs);
+      free(results);
     }
-    ezgdal_show_progress(stdout,100,100);
 
-    sml_close_layer(dh);
-    free(buf);
+    free(frames);
+    free(sign_buf);
+    free(grid_dh);
+    free(grid_buf);
+    signature_set_free(set);
+    free(sign_names);
+    free(norm_funcs);
 
     for(i=0; i<ninputs; i++) 
       ezgdal_close_layer(input_layers[i]);
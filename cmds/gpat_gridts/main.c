@@ -40,17 +40,25 @@ void usage(char *progname, void *argtable) {
 
 int main(int argc, char **argv) {
 
-    int i, row, col;
+    int i, k, b, row, col;
 
     int dim_val = 1;
+    int nelements;
 
-    struct arg_str  *inp  = arg_strn("i","input","<file_name>",1,9999,"name of input file(s) (GeoTIFF)");
+    struct arg_str  *inp  = arg_strn("i","input","<file_name>",1,9999,"name of input file(s) (GeoTIFF, all bands of a single input are used, band 1 of several inputs)");
     struct arg_str  *out  = arg_str1("o","output","<file_name>","name of output file (GRID)");
     struct arg_int  *dim  = arg_int0("d","dimension","<n>","dimension of vector that describes time series element (default: 1)");
     struct arg_lit  *norm = arg_lit0("n","normalize","normalize each vector coordinate to [0.0, 1.0] (default: no)");
+    struct arg_str  *win  = arg_str0(NULL,"window","<c,r,cols,rows>","process only a window of the input (cells)");
+    struct arg_str  *bbox = arg_str0(NULL,"bbox","<xmin,ymin,xmax,ymax>","process only a bounding box of the input (map units)");
+    struct arg_str  *msk  = arg_str0(NULL,"mask","<file_name>","process only cells not null and not zero in the mask (GeoTIFF)");
+    struct arg_str  *cmpr = arg_str0(NULL,"compress","<method>","output compression: LZ, ZSTD, LZ4 (default: none)");
+    struct arg_str  *stor = arg_str0(NULL,"storage","<type>","storage of time series: float32, uint16q (needs -n) (default: double)");
     struct arg_lit  *help = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end  = arg_end(20);
-    void* argtable[] = {inp,out,dim,norm,help,end};
+    void* argtable[] = {inp,out,dim,norm,win,bbox,msk,cmpr,stor,help,end};
+    int codec = SML_CODEC_NONE;
+    int d_type = SML_DOUBLE;
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -62,10 +70,25 @@ int main(int argc, char **argv) {
       usage(argv[0],argtable);
     }
 
-    if(dim->count>0) {
+    if(dim->count>0)
       dim_val = dim->ival[0];
-      if(inp->count % dim_val != 0) {
-        printf("\nNumber of input files does not fit to vector dimension!\n\n");
+
+    if(cmpr->count > 0) {
+      codec = sml_get_codec(cmpr->sval[0]);
+      if(codec < 0) {
+        printf("\nCompression method '%s' is not available!\n\n", cmpr->sval[0]);
+        usage(argv[0],argtable);
+      }
+    }
+
+    if(stor->count > 0) {
+      d_type = sml_get_d_type(stor->sval[0]);
+      if(d_type < 0) {
+        printf("\nStorage type '%s' is not available!\n\n", stor->sval[0]);
+        usage(argv[0],argtable);
+      }
+      if(d_type == SML_UINT16Q && norm->count == 0) {
+        printf("\nStorage 'uint16q' needs normalized time series (-n)!\n\n");
         usage(argv[0],argtable);
       }
     }
@@ -86,6 +109,32 @@ int main(int argc, char **argv) {
         printf("\nCannot open file: '%s'\n\n", inp->sval[i]);
         usage(argv[0],argtable);
       }
+      if(!ezgdal_layer_set_region(input_layers[i],
+                                  (win->count>0) ? win->sval[0] : NULL,
+                                  (bbox->count>0) ? bbox->sval[0] : NULL,
+                                  (msk->count>0) ? msk->sval[0] : NULL)) {
+        printf("\nWrong window, bounding box or mask for: '%s'\n\n", inp->sval[i]);
+        usage(argv[0],argtable);
+      }
+    }
+
+    /* elements of the series are the bands of a single input, 
+       or the first bands of several inputs, in the input order */
+    int all_bands = (inp->count == 1);
+    nelements = 0;
+    for(i=0; i<inp->count; i++)
+      nelements += all_bands ? input_layers[i]->bands : 1;
+    int *el_layer = (int *)malloc(nelements*sizeof(int));
+    int *el_band = (int *)malloc(nelements*sizeof(int));
+    for(i=0, k=0; i<inp->count; i++)
+      for(b=0; b<(all_bands ? input_layers[i]->bands : 1); b++, k++) {
+        el_layer[k] = i;
+        el_band[k] = b;
+      }
+
+    if(dim_val<1 || nelements % dim_val != 0) {
+      printf("\nNumber of input bands does not fit to vector dimension!\n\n");
+      usage(argv[0],argtable);
     }
 
     if(!ezgdal_is_projection_ok(input_layers, inp->count)) {
@@ -98,21 +147,31 @@ int main(int argc, char **argv) {
       usage(argv[0],argtable);
     }
 
-    if(norm->count>0) 
-      for(i=0; i<inp->count; i++) {
-        ezgdal_calc_layer_stats(input_layers[i]);
-        if(norm->count>0 && input_layers[i]->stats->min==input_layers[i]->stats->max) {
-          printf("\nInput layer (%d) contains only one value!\n\n", i);
+    double *el_min = (double *)malloc(nelements*sizeof(double));
+    double *el_max = (double *)malloc(nelements*sizeof(double));
+    if(norm->count>0) {
+      for(k=0; k<nelements; k+=(all_bands ? input_layers[el_layer[k]]->bands : 1)) {
+        i = el_layer[k];
+        if(!all_bands || input_layers[i]->bands==1) {
+          ezgdal_calc_layer_stats(input_layers[i]);
+          el_min[k] = input_layers[i]->stats->min;
+          el_max[k] = input_layers[i]->stats->max;
+        } else
+          ezgdal_calc_bands_range(input_layers[i], el_min+k, el_max+k);
+      }
+      for(k=0; k<nelements; k++)
+        if(el_min[k]>=el_max[k]) {
+          printf("\nInput layer (%d), band %d contains only one value!\n\n", el_layer[k], el_band[k]+1);
           usage(argv[0],argtable);
         }
-      }
+    }
 
 
     int *dims = (int *)malloc(2*sizeof(int));
     dims[0] = dim_val;
-    dims[1] = inp->count / dim_val;
+    dims[1] = nelements / dim_val;
 
-    SML_CELL_TYPE *cell_type = sml_create_cell_type(SML_DOUBLE,2,dims);
+    SML_CELL_TYPE *cell_type = sml_create_cell_type((SML_D_TYPE)d_type,2,dims);
     double *at = ezgdal_layer_get_at(input_layers[0]);
     char *wkt = ezgdal_layer_get_wkt(input_layers[0]);
     SML_WINDOW *window = sml_create_window(
@@ -125,33 +184,40 @@ int main(int argc, char **argv) {
 
     if(dh!=NULL) {
       void *buf = sml_create_cell_row_buffer(dh);
+      if(cmpr->count > 0)
+        sml_set_layer_blocks(dh, 0, (SML_CODEC)codec);
 
       /* import data */
       ezgdal_show_progress(stdout,0,dh->file_win->rows);
       for(row=0; row<dh->file_win->rows; row++) {
 
         ezgdal_show_progress(stdout,row,dh->file_win->rows);
+        /* one read per input file for all its bands */
         for(i=0; i<inp->count; i++) 
+          if(all_bands)
+            ezgdal_read_bands_buffer(input_layers[i], row);
+          else
             ezgdal_read_buffer(input_layers[i], row);
 
         for(col=0; col<dh->file_win->cols; col++) {
           void *cell = sml_get_cell_pointer(dh, buf, col);
           sml_set_cell_not_null(cell);
 
-          for(i=0; i<inp->count; i++) {
+          for(k=0; k<nelements; k++) {
 
             if(sml_is_cell_null(cell)) 
                continue;
 
+            EZGDAL_LAYER *l = input_layers[el_layer[k]];
             double v;
-            v = input_layers[i]->buffer[col];
-            if(ezgdal_is_null(input_layers[i],v))
+            v = all_bands ? l->band_buffer[(long)el_band[k]*l->cols + col] : l->buffer[col];
+            if(ezgdal_is_band_null(l,el_band[k],v))
               sml_set_cell_null(cell);
             else {
               if(norm->count>0)
-                v = (v - input_layers[i]->stats->min)/(input_layers[i]->stats->max - input_layers[i]->stats->min);
+                v = (v - el_min[k])/(el_max[k] - el_min[k]);
 
-              sml_set_cell_val_dbl(dh, v, cell, i);
+              sml_set_cell_val_dbl(dh, v, cell, k);
             }
           }
         }
@@ -169,6 +235,10 @@ int main(int argc, char **argv) {
     for(i=0; i<inp->count; i++) 
       ezgdal_close_layer(input_layers[i]);
     free(input_layers);
+    free(el_layer);
+    free(el_band);
+    free(el_min);
+    free(el_max);
 
 
 return 0;
@@ -66,9 +66,14 @@ int main(int argc, char **argv) {
     struct arg_str  *desc  = arg_str0("d","description","<string>","Description of the location");
     struct arg_str  *xy    = arg_str0(NULL,"xy_file","<file_name>","name of file with coordinates (TXT)");
     struct arg_lit  *app   = arg_lit0("a","append","append results to output file");
+    struct arg_lit  *mmp   = arg_lit0(NULL,"mmap","read uncompressed input directly from the mapped file");
+    struct arg_int  *cch   = arg_int0(NULL,"cache","<size in MB>","cache decoded blocks of input shared by close points (default: none)");
+    struct arg_str  *win   = arg_str0(NULL,"window","<c,r,cols,rows>","process only a window of the input (cells)");
+    struct arg_str  *bbox  = arg_str0(NULL,"bbox","<xmin,ymin,xmax,ymax>","process only a bounding box of the input (map units)");
+    struct arg_str  *msk   = arg_str0(NULL,"mask","<file_name>","process only cells not null and not zero in the mask (GeoTIFF)");
     struct arg_lit  *help  = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end   = arg_end(20);
-    void* argtable[] = {inp,out,sign,lvl,size,norm,list,x,y,desc,xy,app,help,end};
+    void* argtable[] = {inp,out,sign,lvl,size,norm,list,x,y,desc,xy,app,mmp,cch,win,bbox,msk,help,end};
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -173,23 +178,34 @@ int main(int argc, char **argv) {
         printf("\nFile [%s] cannot be opened.\n\n", inp->sval[0]);
         usage(argv[0],argtable);
       }
+      if(!ezgdal_layer_set_region(input_layers[i],
+                                  (win->count>0) ? win->sval[0] : NULL,
+                                  (bbox->count>0) ? bbox->sval[0] : NULL,
+                                  (msk->count>0) ? msk->sval[0] : NULL)) {
+        printf("\nWrong window, bounding box or mask for: '%s'\n\n", inp->sval[0]);
+        usage(argv[0],argtable);
+      }
       frameset = ezgdal_create_frameset_with_size(input_layers[i],1);
+      ezgdal_frameset_validity_mode(frameset);
       frame = ezgdal_add_frameset_frame(frameset,0,0,0,0);
       frames[i] = frame;
     }
 
     printf("Calculating statistics... "); fflush(stdout);
-    for(i=0; i<ninputs; i++) {
-      ezgdal_calc_layer_stats(input_layers[i]);
-      double min = input_layers[i]->stats->min;
-      min = min - 0.5;
-      double max = input_layers[i]->stats->max;
-      max = max + 0.5;
-      int N = (int)floor(fabs(max-min));
-      ezgdal_calc_value_map(input_layers[i],min,max,N);
-    }
+    for(i=0; i<ninputs; i++)
+      ezgdal_calc_layer_categories(input_layers[i]);
     printf("OK\n"); fflush(stdout);
 
+    if(mmp->count>0)
+      for(i=0; i<ninputs; i++)
+        if(!ezgdal_layer_mmap_mode(input_layers[i]))
+          printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[0]);
+
+    if(cch->count>0)
+      for(i=0; i<ninputs; i++)
+        if(!ezgdal_layer_cache_mode(input_layers[i], (unsigned long)(cch->ival[0])*1048576))
+          printf("\nBlock cache is not available for: '%s'\n\n", inp->sval[0]);
+
     if(!ezgdal_is_projection_ok(input_layers,ninputs)) {
       printf("\nInput files have various projections!\n\n");
       usage(argv[0],argtable);
@@ -267,8 +283,12 @@ printf("r: %d, c: %d, n: %d, len: %d, hist: %d, mx: %d, max: %lf, min: %lf\n",ro
     }
 
     fclose(f);
-    for(i=0; i<ninputs; i++)
+    H_free();
+    for(i=0; i<ninputs; i++) {
+      if(input_layers[i]->cache!=NULL)
+        printf("Block cache: %ld hits, %ld misses\n", input_layers[i]->cache->hits, input_layers[i]->cache->misses);
       ezgdal_close_layer(input_layers[i]);
+    }
 
 printf("OK\n");
 
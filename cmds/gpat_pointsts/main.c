@@ -38,7 +38,7 @@ int main(int argc, char **argv) {
 
     char *description;
     SML_DATA_HEADER *dh_f;
-    void *xybuf;
+    void *xybuf, *cell;
     FILE *f, *fxy;
     char desc_text[MAX_DESC_LEN];
     double coord_x,coord_y;
@@ -50,9 +50,10 @@ int main(int argc, char **argv) {
     struct arg_str  *desc = arg_str0("d","description","<string>","Description of the location");
     struct arg_str  *xy   = arg_str0(NULL,"xy_file","<file_name>","name of file with coordinates (TXT)");
     struct arg_lit  *app  = arg_lit0("a","append","append results to output file");
+    struct arg_lit  *mmp  = arg_lit0(NULL,"mmap","read the input grid directly from the mapped file");
     struct arg_lit  *help = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end  = arg_end(20);
-    void* argtable[] = {inp,out,x,y,desc,xy,app,help,end};
+    void* argtable[] = {inp,out,x,y,desc,xy,app,mmp,help,end};
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -84,6 +85,10 @@ int main(int argc, char **argv) {
       usage(argv[0],argtable);
     }
 
+    /* cells are then written from the mapping, without a seek and a read per point */
+    if(mmp->count > 0 && !sml_layer_mmap_mode(dh_f))
+      printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[0]);
+
     xybuf=(char*)calloc(1,dh_f->cell_size);
     if(app->count>0)
       f = fopen(out->sval[0],"a");
@@ -94,14 +99,14 @@ int main(int argc, char **argv) {
       if(desc->count>0)
         description = (char *)(desc->sval[0]);
 
-      sml_read_cell_from_layer_xy(dh_f,xybuf,x->dval[0],y->dval[0]);
-      sml_write_cell_txt(f,x->dval[0],y->dval[0],description,xybuf,dh_f);
+      cell = sml_get_cell_view_xy(dh_f,xybuf,x->dval[0],y->dval[0]);
+      sml_write_cell_txt(f,x->dval[0],y->dval[0],description,cell,dh_f);
     } else {
       fxy = fopen((char *)xy->sval[0],"r");
       int line = 1;
       while(read_xy_txt(line++,fxy,&coord_x,&coord_y,desc_text, MAX_DESC_LEN)) {
-        sml_read_cell_from_layer_xy(dh_f,xybuf,coord_x,coord_y);
-        sml_write_cell_txt(f,coord_x,coord_y,desc_text,xybuf,dh_f);
+        cell = sml_get_cell_view_xy(dh_f,xybuf,coord_x,coord_y);
+        sml_write_cell_txt(f,coord_x,coord_y,desc_text,cell,dh_f);
       }
       fclose(fxy);
     }
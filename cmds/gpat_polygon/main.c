@@ -58,9 +58,15 @@ int main(int argc, char **argv) {
     struct arg_int  *max   = arg_int0("m","max_buffer_size","<size in MB>","max size of the internal buffer for a polygon's extent, default: '4096')");
     struct arg_lit  *list  = arg_lit0("l",NULL,"list all signatures and normalization methods");
     struct arg_int  *th    = arg_int0("t",NULL,"<n>","number of threads (default: 1)");
+    struct arg_int  *cch   = arg_int0(NULL,"cache","<size in MB>","cache decoded blocks of inputs shared by overlapping polygons (default: none)");
+    struct arg_str  *win   = arg_str0(NULL,"window","<c,r,cols,rows>","process only a window of the input (cells)");
+    struct arg_str  *bbox  = arg_str0(NULL,"bbox","<xmin,ymin,xmax,ymax>","process only a bounding box of the input (map units)");
+    struct arg_str  *msk   = arg_str0(NULL,"mask","<file_name>","process only cells not null and not zero in the mask (GeoTIFF)");
+    struct arg_str  *stor  = arg_str0(NULL,"storage","<type>","precision of signatures: float32, uint16q (values of 0..1, 'pdf' or '01') (default: double)");
     struct arg_lit  *help  = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end   = arg_end(20);
-    void* argtable[] = {inp,seg,out,sig,norm,list,max,th,help,end};
+    void* argtable[] = {inp,seg,out,sig,norm,list,max,th,cch,win,bbox,msk,stor,help,end};
+    int d_type = SML_DOUBLE;
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -119,6 +125,19 @@ int main(int argc, char **argv) {
       }
     }
 
+    if(stor->count > 0) {
+      d_type = sml_get_d_type(stor->sval[0]);
+      if(d_type < 0) {
+        printf("\nStorage type '%s' is not available!\n\n", stor->sval[0]);
+        usage(argv[0],argtable);
+      }
+      if(d_type == SML_UINT16Q && norm->count > 0 && 
+         strcmp(norm->sval[0],"pdf")!=0 && strcmp(norm->sval[0],"01")!=0) {
+        printf("\nStorage 'uint16q' needs signatures normalized to 'pdf' or '01'!\n\n");
+        usage(argv[0],argtable);
+      }
+    }
+
     if(max->count > 0) {
       if(max->ival[0]>0)
         ezgdal_frameset_max_buffer_size((unsigned long)(max->ival[0])*1048575);
@@ -153,6 +172,13 @@ int main(int argc, char **argv) {
       printf("\nCannot open file: '%s'\n\n", seg->sval[0]);
       usage(argv[0],argtable);
     }
+    if(!ezgdal_layer_set_region(input_layers[0],
+                                (win->count>0) ? win->sval[0] : NULL,
+                                (bbox->count>0) ? bbox->sval[0] : NULL,
+                                (msk->count>0) ? msk->sval[0] : NULL)) {
+      printf("\nWrong window, bounding box or mask for: '%s'\n\n", seg->sval[0]);
+      usage(argv[0],argtable);
+    }
 
     for(i=1; i<ninputs; i++) {
       input_layers[i] = ezgdal_open_layer((char *)(inp->sval[i-1]));
@@ -160,6 +186,13 @@ int main(int argc, char **argv) {
         printf("\nCannot open file: '%s'\n\n", inp->sval[i-1]);
         usage(argv[0],argtable);
       }
+      if(!ezgdal_layer_set_region(input_layers[i],
+                                  (win->count>0) ? win->sval[0] : NULL,
+                                  (bbox->count>0) ? bbox->sval[0] : NULL,
+                                  (msk->count>0) ? msk->sval[0] : NULL)) {
+        printf("\nWrong window, bounding box or mask for: '%s'\n\n", inp->sval[i-1]);
+        usage(argv[0],argtable);
+      }
     }
 
 
@@ -174,17 +207,20 @@ int main(int argc, char **argv) {
     }
 
     printf("Calculating statistics... "); fflush(stdout);
-    for(i=0; i<ninputs; i++) {
-      ezgdal_calc_layer_stats(input_layers[i]);
-      double min = input_layers[i]->stats->min;
-      min = min - 0.5;
-      double max = input_layers[i]->stats->max;
-      max = max + 0.5;
-      int N = (int)floor(fabs(max-min));
-      ezgdal_calc_value_map(input_layers[i],min,max,N);
-    }
+    for(i=0; i<ninputs; i++)
+      ezgdal_calc_layer_categories(input_layers[i]);
     printf("OK\n"); fflush(stdout);
 
+    /* one dataset handle per thread, polygons are read in parallel */
+    if(th->count > 0 && th->ival[0] > 1)
+      for(i=0; i<ninputs; i++)
+        ezgdal_layer_open_handles(input_layers[i], th->ival[0]);
+
+    if(cch->count > 0)
+      for(i=0; i<ninputs; i++)
+        if(!ezgdal_layer_cache_mode(input_layers[i], (unsigned long)(cch->ival[0])*1048576))
+          printf("\nBlock cache is not available for input %d\n\n", i+1);
+
 
     int *dims = (int *)malloc(sizeof(int));
     dims[0] = sign_len_func(input_layers+1, ninputs-1);
@@ -247,6 +283,9 @@ int main(int argc, char **argv) {
 
     for(i=1; i<ninputs; i++) {
       EZGDAL_FRAMESET *fs = ezgdal_create_frameset_with_size(input_layers[i],nCats);
+      /* cells out of a polygon are null in the validity bitmasks,
+         frames keep the cell type of the input */
+      ezgdal_frameset_validity_mode(fs);
       for(j=0; j<nCats; j++)
         if(ezgdal_add_frameset_frame(fs,
                                      frmsetCats->frame[j]->col1,
@@ -257,70 +296,82 @@ int main(int argc, char **argv) {
             ezgdal_show_message(stderr,"Not enough RAM to proceed!");
             exit(EXIT_FAILURE);
           }
-      if(!input_layers[i]->is_no_data) {
-        input_layers[i]->is_no_data = TRUE;
-        input_layers[i]->no_data = DBL_MIN;
-      }
     }
 
 
-    double *result = (double *)malloc(dims[0]*sizeof(double));
-    EZGDAL_FRAME **frames = (EZGDAL_FRAME **)malloc((ninputs-1)*sizeof(EZGDAL_FRAME *));
+#pragma omp parallel private(j,r,c)
+    {
+      double *result = (double *)malloc(dims[0]*sizeof(double));
+      EZGDAL_FRAME **frames = (EZGDAL_FRAME **)malloc((ninputs-1)*sizeof(EZGDAL_FRAME *));
 
-    for(i=0; i<nCats; i++) {
-      ezgdal_show_progress(stdout, i, nCats);
+#pragma omp for ordered schedule(dynamic)
+      for(i=0; i<nCats; i++) {
 
-      EZGDAL_FRAME *frmCats = frmsetCats->frame[i];
-      ezgdal_load_frameset_frame_data(frmCats);
+        EZGDAL_FRAME *frmCats = frmsetCats->frame[i];
+        ezgdal_load_frameset_frame_data(frmCats);
 
-      double cat = ezgdal_get_index_value(input_layers[0],i);
+        double cat = ezgdal_get_index_value(input_layers[0],i);
 
-      for(j=1; j<ninputs; j++) {
+        for(j=1; j<ninputs; j++) {
 
-        EZGDAL_FRAME *frmInp = input_layers[j]->frameset->frame[i];
-        frames[j-1] = frmInp;
+          EZGDAL_FRAME *frmInp = input_layers[j]->frameset->frame[i];
+          frames[j-1] = frmInp;
 
-        ezgdal_load_frameset_frame_data(frmInp);
+          ezgdal_load_frameset_frame_data(frmInp);
 
-        for(r=0; r<frmCats->rows; r++)
-          for(c=0; c<frmCats->cols; c++) 
-            if(ezgdal_get_value_index(input_layers[0],frmCats->buffer[r][c])!=i)
-              ezgdal_set_null(input_layers[j],&(frmInp->buffer[r][c]));
+          for(r=0; r<frmCats->rows; r++)
+            for(c=0; c<frmCats->cols; c++) 
+              if(ezgdal_frame_get_cat(frmCats,r,c)!=i)
+                ezgdal_set_frame_null(input_layers[j],frmInp,r,c);
 
-      }
+        }
 
-      sign_func(frames ,ninputs-1, result, *dims);
-      norm_func(result,*dims);
+        sign_func(frames ,ninputs-1, result, *dims);
+        norm_func(result,*dims);
 
-      double x = 0;
-      double y = 0;
-      int n = 0;
-      
-      for(r=0; r<frmCats->rows; r++)
-        for(c=0; c<frmCats->cols; c++)
-          if(ezgdal_get_value_index(input_layers[0],frmCats->buffer[r][c])==i) {
-            x += c;
-            y += r;
-            n++;
-          }
-      c = (int)round(x/(double)n + frmCats->col1);
-      r = (int)round(y/(double)n + frmCats->row1);
-      x = ezgdal_cr2x(input_layers[0],c,r);
-      y = ezgdal_cr2y(input_layers[0],c,r);
-      char desc[64];
-      sprintf(desc,"cat: %.0lf",cat);
-      sml_write_dblbuf_txt(file,x,y,desc,result,*dims,1,dims);
+        /* buffers go back to the pool for the next polygons */
+        for(j=1; j<ninputs; j++)
+          ezgdal_unload_frameset_frame_data(frames[j-1]);
+
+        double x = 0;
+        double y = 0;
+        int n = 0;
+        
+        for(r=0; r<frmCats->rows; r++)
+          for(c=0; c<frmCats->cols; c++)
+            if(ezgdal_frame_get_cat(frmCats,r,c)==i) {
+              x += c;
+              y += r;
+              n++;
+            }
+        c = (int)round(x/(double)n + frmCats->col1);
+        r = (int)round(y/(double)n + frmCats->row1);
+        ezgdal_unload_frameset_frame_data(frmCats);
+        x = ezgdal_cr2x(input_layers[0],c,r);
+        y = ezgdal_cr2y(input_layers[0],c,r);
+        char desc[64];
+        sprintf(desc,"cat: %.0lf",cat);
+#pragma omp ordered
+        {
+          ezgdal_show_progress(stdout, i, nCats);
+          sml_write_dblbuf_txt_as(file,x,y,desc,result,*dims,1,dims,(SML_D_TYPE)d_type);
+        }
+      }
+
+      free(result);
+      free(frames);
     }
     ezgdal_show_progress(stdout, 100,100);
 
-    free(result);
-    free(frames);
-
 /////////////////////////////////////////////////////////////////////////////
 
     fclose(file);
-    for(i=0; i<ninputs; i++) 
+    H_free();
+    for(i=0; i<ninputs; i++) {
+      if(input_layers[i]->cache!=NULL)
+        printf("Block cache: %ld hits, %ld misses\n", input_layers[i]->cache->hits, input_layers[i]->cache->misses);
       ezgdal_close_layer(input_layers[i]);
+    }
     free(input_layers);
 
 return 0;
@@ -42,9 +42,19 @@ void usage(char *progname, void *argtable) {
 }
 
 
-void calc_simil_layer(SML_DATA_HEADER *dh, char *fname, double *refbuf, char *dtype, PALETTE *pal, int *nodata, distance_func *func) {
-  int r,c,rows,cols,size;
-  void *rowbuf; //, *cell;
+/* 
+ * sfunc (if not NULL) compares sparse rows of the layer without decoding cells,
+ * ffunc and qfunc compare cells stored as float and uint16q without converting
+ * them, cells of other types are converted to double for func
+ */
+void calc_simil_layer(SML_DATA_HEADER *dh, char *fname, double *refbuf, char *dtype, PALETTE *pal, int *nodata, distance_func *func, sparse_distance_func *sfunc, float_distance_func *ffunc, q16_distance_func *qfunc) {
+  int r,c,i,rows,cols,size;
+  void *rowbuf, *row = NULL; //, *cell;
+  void *refdata = NULL;
+  double *cellbuf = NULL;
+  SML_D_TYPE d_type = dh->cell_type->d_type;
+  SML_SPARSE_ROW *sr = NULL;
+  sparse_signature ref;
 
   EZGDAL_LAYER *l;
 
@@ -71,22 +81,83 @@ void calc_simil_layer(SML_DATA_HEADER *dh, char *fname, double *refbuf, char *dt
                         nodata);
 
   rowbuf = sml_create_cell_row_buffer(dh);
+
+  ref.n = 0;
+  ref.idx = NULL;
+  ref.val = NULL;
+  if(sfunc != NULL) {
+    sr = sml_create_sparse_row(dh);
+    ref.idx = malloc(size*sizeof(int));
+    ref.val = malloc(size*sizeof(double));
+    for(i=0; i<size; i++)
+      if(refbuf[i] != 0.0) {
+        ref.idx[ref.n] = i;
+        ref.val[ref.n++] = refbuf[i];
+      }
+  }
+
+  /* the reference is stored as cells of the layer */
+  if(d_type == SML_FLOAT && ffunc != NULL)
+    func = NULL;
+  else if(d_type == SML_UINT16Q && qfunc != NULL)
+    func = NULL;
+  else if(d_type != SML_DOUBLE)
+    cellbuf = malloc(omp_get_max_threads()*size*sizeof(double));
+  if(func == NULL) {
+    refdata = malloc(dh->cell_size);
+    sml_set_data_dbl(dh,refbuf,refdata);
+  }
  
   ezgdal_show_progress(stdout,0,rows);
   for(r=0; r<rows; r++) {
     ezgdal_show_progress(stdout,r,rows);
-    sml_read_row_from_layer(dh,rowbuf,r);
+    if(sr != NULL)
+      sml_read_sparse_row_from_layer(dh,sr,r);
+    else
+      row = sml_get_row_view(dh,rowbuf,r);
 
 #pragma omp parallel for
     for(c=0; c<cols; c++) {
-      void *cell = sml_get_cell_pointer(dh,rowbuf,c);
+      if(sr != NULL) {
+        if(sr->null[c]) {
+          ezgdal_set_null(l,&(l->buffer[c]));
+        } else {
+          sparse_signature cs, *sbuf[2];
+          cs.n = sr->start[c+1]-sr->start[c];
+          cs.idx = sr->idx+sr->start[c];
+          cs.val = sr->val+sr->start[c];
+          sbuf[0] = &ref;
+          sbuf[1] = &cs;
+          l->buffer[c] = a*(1.0-sfunc(sbuf,2,size,1,&size))+b;
+        }
+        continue;
+      }
+      void *cell = sml_get_cell_pointer(dh,row,c);
       if(sml_is_cell_null(cell)) {
         ezgdal_set_null(l,&(l->buffer[c]));
       } else {
-        double *buf[2];
-        buf[0] = refbuf;
-        buf[1] = sml_get_cell_data(cell);
-        l->buffer[c] = a*(1.0-func(buf,2,size,1,&size))+b;
+        double d;
+        if(func == NULL && d_type == SML_FLOAT) {
+          float *buf[2];
+          buf[0] = refdata;
+          buf[1] = sml_get_cell_data(cell);
+          d = ffunc(buf,2,size,1,&size);
+        } else if(func == NULL) {
+          unsigned short *buf[2];
+          buf[0] = refdata;
+          buf[1] = sml_get_cell_data(cell);
+          d = qfunc(buf,2,size,1,&size);
+        } else {
+          double *buf[2];
+          buf[0] = refbuf;
+          buf[1] = sml_get_cell_data(cell);
+          if(cellbuf != NULL) {
+            buf[1] = cellbuf+omp_get_thread_num()*size;
+            sml_get_data_dbl(dh,sml_get_cell_data(cell),buf[1]);
+          }
+          d = func(buf,2,size,1,&size);
+        }
+        l->buffer[c] = a*(1.0-d)+b;
       }
     }
     ezgdal_write_buffer(l,r);
@@ -99,6 +170,11 @@ void calc_simil_layer(SML_DATA_HEADER *dh, char *fname, double *refbuf, char *dt
   ezgdal_close_layer(l);
   
   free(rowbuf);
+  free(refdata);
+  free(cellbuf);
+  free(ref.idx);
+  free(ref.val);
+  sml_free_sparse_row(sr);
 
 }
 
@@ -120,6 +196,10 @@ int main(int argc, char **argv) {
     int _nodata = -9999;
     char *dtype = "Float64";
     distance_func *func = get_distance("jsd");
+    sparse_distance_func *sfunc = NULL;
+    float_distance_func *ffunc = NULL;
+    q16_distance_func *qfunc = NULL;
+    char *mname = "jsd";
     PALETTE *palette = NULL;
 
     struct arg_str  *inp   = arg_str1("i","input","<file_name>","name of input file (GRID)");
@@ -130,10 +210,13 @@ int main(int argc, char **argv) {
     struct arg_str  *pal   = arg_str0("p","palette","<file_name>","name of the file with colors definition (CSV)");
     struct arg_str  *type  = arg_str0(NULL,"type","Byte/....","output data type (default: Float64)");
     struct arg_int  *nodat = arg_int0("n","no_data","<n>","output NO DATA value (default: none)");
+    struct arg_str  *cmpr  = arg_str0(NULL,"compress","<method>","output compression: DEFLATE, LZW, ZSTD, ... (default: none)");
+    struct arg_lit  *cog   = arg_lit0(NULL,"cog","write output as Cloud Optimized GeoTIFF");
     struct arg_int  *th    = arg_int0("t",NULL,"<n>","number of threads (default: 1)");
+    struct arg_lit  *mmp   = arg_lit0(NULL,"mmap","read the input grid directly from the mapped file");
     struct arg_lit  *help  = arg_lit0("h","help","print this help and exit");
     struct arg_end  *end   = arg_end(20);
-    void* argtable[] = {inp,out,ref,mes,mesl,type,pal,nodat,th,help,end};
+    void* argtable[] = {inp,out,ref,mes,mesl,type,pal,nodat,cmpr,cog,th,mmp,help,end};
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -156,7 +239,8 @@ int main(int argc, char **argv) {
     }
 
     if(mes->count > 0) {
-      func = get_distance((char *)(mes->sval[0]));
+      mname = (char *)(mes->sval[0]);
+      func = get_distance(mname);
       /* measure not found */
       if(func==NULL) {
         printf("\nWrong similarity measure: %s\n\n",mes->sval[0]);
@@ -174,6 +258,10 @@ int main(int argc, char **argv) {
     else
       omp_set_num_threads(1);
 
+    /* tiled and compressed output */
+    if(cmpr->count > 0 || cog->count > 0)
+      ezgdal_set_writer_options((cmpr->count > 0) ? cmpr->sval[0] : NULL, cog->count > 0);
+
     if(inp->count>0 && !ezgdal_file_exists((char *)(inp->sval[0]))) {
       printf("\nFile '%s' does not exists!\n\n", inp->sval[0]);
       usage(argv[0],argtable);
@@ -206,7 +294,13 @@ int main(int argc, char **argv) {
     }
     
     dh = sml_open_layer((char *)(inp->sval[0]));
+    if(mmp->count > 0 && !sml_layer_mmap_mode(dh))
+      printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[0]);
     ct = (SML_CELL_TYPE *)calloc(1,sizeof(SML_CELL_TYPE));
+    if(dh->layout == SML_LAYOUT_SPARSE)
+      sfunc = get_sparse_distance(mname);
+    ffunc = get_float_distance(mname);
+    qfunc = get_q16_distance(mname);
     
     size = dh->cell_N_elements;
     refbuf = malloc(size*sizeof(double));
@@ -221,7 +315,7 @@ int main(int argc, char **argv) {
         else
           fname = create_fname((char *)(out->sval[0]));
         if(fname!=NULL) {
-          calc_simil_layer(dh, fname, refbuf, dtype, palette, nodata, func);
+          calc_simil_layer(dh, fname, refbuf, dtype, palette, nodata, func, sfunc, ffunc, qfunc);
           free(fname);
         }
       }
@@ -91,7 +91,8 @@ int read_histograms_to_memory(DATAINFO* d, LOCAL_PARAMS* p)
 	int ncols=d->cell_hd.cols;
 	int ncells=nrows*ncols;
 
-	d->all_histograms=malloc(ncells*sizeof(double*));
+	d->all_histograms=malloc(ncells*sizeof(void*));
+	d->hist_type=SML_DOUBLE;
 
 	/* new histogram returns null if doesn't contain enough data */
 	for(i=0;i<ncells;++i)
@@ -152,20 +153,60 @@ int* sample_histogram_ids(struct fifo* queue , int num_of_samples) {
 	return samples;
 }
 
-double* use_histogram(DATAINFO* d, int index)
+void* use_histogram(DATAINFO* d, int index)
 {
 	return (index<0)?NULL:d->all_histograms[index];
 	/* this function will be extended in the future to get data from SSD or from memory*/
 }
 
-int add_histograms(DATAINFO* d, double* o, double* h, int num_of_areas)
+/* h is a histogram of all_histograms, in hist_type */
+int copy_histogram(DATAINFO* d, double* o, void* h)
+{
+	int i;
+
+	switch(d->hist_type) {
+	case SML_FLOAT:
+		for(i=0;i<d->size_of_histogram;++i)
+			o[i]=((float*)h)[i];
+		break;
+	case SML_UINT16Q:
+		for(i=0;i<d->size_of_histogram;++i)
+			o[i]=((unsigned short*)h)[i]/(double)SML_UINT16Q_MAX;
+		break;
+	default:
+		memcpy(o,h,d->size_of_histogram*sizeof(double));
+	}
+
+	return 0;
+}
+
+/* h is a histogram of all_histograms, in hist_type */
+int add_histograms(DATAINFO* d, double* o, void* h, int num_of_areas)
 {
 	double o_div=(num_of_areas-1.)/(double)num_of_areas;
 	double h_div=1./(double)num_of_areas;
 	int i;
 
-	for(i=0;i<d->size_of_histogram;++i)
-		o[i]=o[i]*o_div+h[i]*h_div;
+	switch(d->hist_type) {
+	case SML_FLOAT: {
+		float* f=h;
+		for(i=0;i<d->size_of_histogram;++i)
+			o[i]=o[i]*o_div+f[i]*h_div;
+		break;
+	}
+	case SML_UINT16Q: {
+		unsigned short* q=h;
+		h_div/=SML_UINT16Q_MAX;
+		for(i=0;i<d->size_of_histogram;++i)
+			o[i]=o[i]*o_div+q[i]*h_div;
+		break;
+	}
+	default: {
+		double* v=h;
+		for(i=0;i<d->size_of_histogram;++i)
+			o[i]=o[i]*o_div+v[i]*h_div;
+	}
+	}
 
 	return 0;
 }
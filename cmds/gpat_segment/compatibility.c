@@ -256,25 +256,40 @@ int read_signatures_to_memory(DATAINFO* d) {
     int ncols=d->cell_hd.cols;
     long int ncells=nrows*ncols;
     long int i = 0;
-    void *row, *cell;
+    void *row, *view, *cell;
+    int mapped;
 
     printf("Reading data... 0%%");
     ezgdal_show_progress(stdout,0,nrows);
-    d->all_histograms=malloc(ncells*sizeof(double*));
-    size = d->size_of_histogram*sizeof(double);
+    d->all_histograms=malloc(ncells*sizeof(void*));
     row = sml_create_cell_row_buffer(d->dh);
+    /* float and uint16q histograms are kept as stored, other types as double */
+    d->hist_type = d->dh->cell_type->d_type;
+    if(d->hist_type != SML_FLOAT && d->hist_type != SML_UINT16Q)
+        d->hist_type = SML_DOUBLE;
+    if(d->hist_type == SML_DOUBLE)
+        size = d->size_of_histogram*sizeof(double);
+    else
+        size = d->size_of_histogram*d->dh->cell_element_size;
+    /* histograms of a mapped grid are read-only views of the file */
+    mapped = (d->dh->map != NULL && d->dh->cell_type->d_type == d->hist_type);
 
     for(r=0; r<nrows; r++) {
 
         ezgdal_show_progress(stdout,r,nrows);
-        sml_read_row_from_layer(d->dh,row,r);
+        view = sml_get_row_view(d->dh,row,r);
         for(c=0; c<ncols; c++) {
-            cell = sml_get_cell_pointer(d->dh, row, c);
+            cell = sml_get_cell_pointer(d->dh, view, c);
             if(sml_is_cell_null(cell))
                 d->all_histograms[i] = NULL;
+            else if(mapped)
+                d->all_histograms[i] = sml_get_cell_data(cell);
             else {
                 d->all_histograms[i] = malloc(size);
-                memcpy(d->all_histograms[i], sml_get_cell_data(cell), size);
+                if(d->hist_type == SML_DOUBLE)
+                    sml_get_data_dbl(d->dh, sml_get_cell_data(cell), d->all_histograms[i]);
+                else
+                    memcpy(d->all_histograms[i], sml_get_cell_data(cell), size);
             }
             i++;
         }
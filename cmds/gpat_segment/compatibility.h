@@ -59,7 +59,8 @@ typedef struct {
   int taken;
   FILE *fd;
   int* buffer;
-  double** all_histograms;
+  void** all_histograms;
+  SML_D_TYPE hist_type; /* double, float or uint16q */
   SML_DATA_HEADER *dh;
 } DATAINFO;
 
@@ -144,7 +144,7 @@ int* hex_init_histogram_list(DATAINFO** d, LOCAL_PARAMS* p, HEXGRID* hx, int hin
 double* hex_create_histogram(DATAINFO* d, HEXGRID* hx, int index)
 {
 	int i,k=0;
-	double* h;
+	void* h;
 	int* histogram_ids;
 	double* histogram;
 
@@ -204,7 +204,7 @@ double* hex_join_quad_histograms(DATAINFO** d, HEXGRID* hx, int index)
 	/* difference between quad and hex: hex requires creation of new histogram
 	 * while quad do not so we use function use_histogram
 	 */
-	double* h;
+	void* h;
 	int i, start=0;
 	double* histogram;
 
@@ -217,7 +217,7 @@ double* hex_join_quad_histograms(DATAINFO** d, HEXGRID* hx, int index)
 	histogram=malloc(hx->size_of_histogram*sizeof(double));
 	for(i=0;i<hx->num_of_subhistograms;++i) {
 		h=use_histogram(d[i],index);
-		memcpy(histogram+start,h,hx->sh_size_of_histogram[i]*sizeof(double));
+		copy_histogram(d[i],histogram+start,h);
 		start+=hx->sh_size_of_histogram[i];
 	}
 
@@ -124,11 +124,12 @@ struct area** init_areas(DATAINFO* d, LOCAL_PARAMS* p);
 double* new_histogram(DATAINFO* d, LOCAL_PARAMS* pars, unsigned index);
 struct area* new_area(DATAINFO* d, LOCAL_PARAMS* pars, unsigned index);
 int remove_area(struct area** a);
-double* use_histogram(DATAINFO* d, int index);
+void* use_histogram(DATAINFO* d, int index);
 double calculate_similarity(DATAINFO* d, LOCAL_PARAMS* p, struct area* a, struct area* b);
 int read_histograms_to_memory(DATAINFO* d, LOCAL_PARAMS* p);
 int* sample_histogram_ids(struct fifo* queue , int num_of_samples);
-int add_histograms(DATAINFO* d, double* o, double* h, int num_of_areas);
+int copy_histogram(DATAINFO* d, double* o, void* h);
+int add_histograms(DATAINFO* d, double* o, void* h, int num_of_areas);
 int compare_grids_datainfo(DATAINFO* a, DATAINFO* b);
 double calculate2(HEXGRID* hx, LOCAL_PARAMS* p, double** pair);
 int get_num_of_grids(char* files[]);
@@ -69,7 +69,10 @@ int main(int argc, char *argv[])
     struct arg_lit  *flag_skip_hierarchical = arg_lit0("r","no_hierarchical","skip hierarchical phase");
 //    struct arg_lit  *flag_all               = arg_lit0("a","all_layers","multilayer only: compare a threshold against all layers instead of an average");
     struct arg_lit  *flag_quad              = arg_lit0("q","quad","quad mode (rook topology)");
+    struct arg_str  *cmpr  = arg_str0(NULL,"compress","<method>","output compression: DEFLATE, LZW, ZSTD, ... (default: none)");
+    struct arg_lit  *cog   = arg_lit0(NULL,"cog","write output as Cloud Optimized GeoTIFF");
     struct arg_int  *th    = arg_int0("t",NULL,"<n>","number of threads (default: 1)");
+    struct arg_lit  *mmp   = arg_lit0(NULL,"mmap","use signatures directly from the mapped input files, without copying");
     struct arg_lit  *help  = arg_lit0("h","help","print help and exit");
     struct arg_end  *end   = arg_end(20);
 
@@ -78,7 +81,7 @@ int main(int argc, char *argv[])
                         swap,minarea,maxhist,
                         flag_complete,/*flag_threshold,*/flag_skip_growing,
                         flag_skip_hierarchical,/*flag_all,*/flag_quad,
-                        th,help,end};
+                        cmpr,cog,th,mmp,help,end};
 
     int nerrors = arg_parse(argc,argv,argtable);
     int num_of_layers = inp->count;
@@ -105,6 +108,10 @@ int main(int argc, char *argv[])
       omp_set_num_threads(th->ival[0]);
     else
       omp_set_num_threads(1);
+
+    /* tiled and compressed output */
+    if(cmpr->count > 0 || cog->count > 0)
+      ezgdal_set_writer_options((cmpr->count > 0) ? cmpr->sval[0] : NULL, cog->count > 0);
   
     int i;
     for(i=0; i<inp->count; i++){
@@ -209,6 +216,8 @@ int main(int argc, char *argv[])
     for(i=0; i<num_of_layers; ++i) {
         datainfo[i] = malloc(sizeof(DATAINFO));
         init_grid_datainfo(datainfo[i],(char *)(inp->sval[i]),(char *)(out->sval[0]));
+        if(mmp->count > 0 && !sml_layer_mmap_mode(datainfo[i]->dh))
+            printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[i]);
         read_signatures_to_memory(datainfo[i]);
     }
     
@@ -59,7 +59,9 @@ typedef struct {
   int taken;
   FILE *fd;
   int* buffer;
-  double** all_histograms;
+  void** all_histograms;
+  SML_D_TYPE hist_type; /* double, float or uint16q */
+  int mapped_histograms; /* all_histograms are views of the mapped grid */
   SML_DATA_HEADER *dh;
 } DATAINFO;
 
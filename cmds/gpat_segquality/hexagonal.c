@@ -132,7 +132,7 @@ double* hex_create_histogram(DATAINFO* d, HEXGRID* hx, int index)
 	if(hx->histogram_ids[index]==NULL)
 		return NULL;
 
-	double* h;
+	void* h;
 	int* histogram_ids=hx->histogram_ids[index];
 	double* histogram=calloc(d->size_of_histogram,sizeof(double));
 
@@ -254,6 +254,18 @@ HEXGRID* hex_build_topology(DATAINFO* d, LOCAL_PARAMS* p)
 			hx->histogram_ids[i]=NULL;
 
 			hx->histograms[i]=use_histogram(d,i);
+			/* hexgrid frees its histograms, views of the mapped grid 
+			   and histograms not kept as double are copied; the stored 
+			   copy is not used any more, so it is freed at once */
+			if(hx->histograms[i] && (d->mapped_histograms || d->hist_type!=SML_DOUBLE)) {
+				double *h=malloc(hx->size_of_histogram*sizeof(double));
+				copy_histogram(d,h,hx->histograms[i]);
+				if(!d->mapped_histograms) {
+					free(hx->histograms[i]);
+					d->all_histograms[i]=NULL;
+				}
+				hx->histograms[i]=h;
+			}
 			if(hx->histograms[i]) {
 				hx->histogram_ids[i]=malloc(2*sizeof(int));
 				hx->histogram_ids[i][0]=i;
@@ -80,8 +80,9 @@ int sort_desc (const void * a, const void * b);
 int sort_asc (const void * b, const void * a);
 int sort_double_desc (const void * a, const void * b);
 int sort_double_asc (const void * a, const void * b);
-double* use_histogram(DATAINFO* d, int index);
-int add_histograms(DATAINFO* d, double* o, double* h, int num_of_areas);
+void* use_histogram(DATAINFO* d, int index);
+int copy_histogram(DATAINFO* d, double* o, void* h);
+int add_histograms(DATAINFO* d, double* o, void* h, int num_of_areas);
 
 /* write */
 void write_raster(SML_DATA_HEADER* dh, void *map, char *raster_fname, int size);
@@ -64,12 +64,13 @@ int main(int argc, char *argv[])
     struct arg_lit  *flag_quad     = arg_lit0("q","quad","quad mode (rook topology)");
     struct arg_lit  *flag_noweight = arg_lit0("w","no_weight","switch off edge-based weighting in isolation");
     struct arg_int  *th            = arg_int0("t",NULL,"<n>","number of threads (default: 1)");
+    struct arg_lit  *mmp           = arg_lit0(NULL,"mmap","use signatures directly from the mapped input file, without copying");
     struct arg_lit  *help          = arg_lit0("h","help","print help and exit");
     struct arg_end  *end           = arg_end(20);
 
     void* argtable[] = {inp,seg,het,iso,mes,mesl,
                         maxhist,flag_complete,flag_quad,
-                        flag_noweight,th,help,end};
+                        flag_noweight,th,mmp,help,end};
 
     int nerrors = arg_parse(argc,argv,argtable);
 
@@ -155,6 +156,8 @@ int main(int argc, char *argv[])
 	/* open and read grid */
     datainfo=malloc(sizeof(DATAINFO));
     init_grid_datainfo(datainfo,(char *)(inp->sval[0]),"apud");
+    if(mmp->count > 0 && !sml_layer_mmap_mode(datainfo->dh))
+        printf("\nMemory mapping is not available for: '%s'\n\n", inp->sval[0]);
     read_signatures_to_memory(datainfo);
     parameters->parameters = init_measure_parameters(datainfo->size_of_histogram,0); /* use distance, not similarity */
     
@@ -39,27 +39,60 @@ extern "C" {
 #define SML_DATA_DESC_LEN 32768
 #define SML_DATA_PROJ_LEN 8192
 
+/* binary header: "<name>.smh", the text "<name>.hdr" is kept for older readers */
+#define SML_HEADER_MAGIC "SMLH"
+#define SML_HEADER_VERSION 4
+#define SML_HEADER_ENDIAN 0x01020304
+
 typedef enum SML_FILE_STATUS {
 		SML_NEW,
 		SML_EXISTING
 	} SML_FILE_STATUS;
 
 
+/*
+ * SML_UINT16Q keeps values of the interval [0, 1] quantized 
+ * to unsigned short, v = q/SML_UINT16Q_MAX
+ */
 typedef enum SML_D_TYPE {
 		SML_BYTE,
 		SML_SHORT_INT,
 		SML_INT,
 		SML_FLOAT,
-		SML_DOUBLE
+		SML_DOUBLE,
+		SML_UINT16Q
 	} SML_D_TYPE;
 
+#define SML_UINT16Q_MAX 65535
+
+/*
+ * layout of cells in the data file; in SML_LAYOUT_SPARSE a not null 
+ * cell keeps the number of not zero elements, their indices (int) 
+ * and their values (cell type), the index keeps offsets of rows;
+ * SML_LAYOUT_BLOCKS keeps blocks of block_rows rows compressed 
+ * independently, the index keeps offsets of blocks
+ */
+typedef enum SML_LAYOUT {
+		SML_LAYOUT_ROWS,
+		SML_LAYOUT_SPARSE,
+		SML_LAYOUT_BLOCKS
+	} SML_LAYOUT;
+
+/* LZ is built in, ZSTD and LZ4 if built with SML_ZSTD / SML_LZ4 */
+typedef enum SML_CODEC {
+		SML_CODEC_NONE,
+		SML_CODEC_LZ,
+		SML_CODEC_ZSTD,
+		SML_CODEC_LZ4
+	} SML_CODEC;
+
 typedef double SML_AFFINE_TRANSFORM[6];
 
 typedef struct SML_WINDOW {
 	SML_AFFINE_TRANSFORM at;
 	int rows;
 	int cols;
-	char proj[SML_DATA_PROJ_LEN];
+	char *proj;
 } SML_WINDOW;
 
 typedef struct SML_CELL_TYPE {
@@ -69,18 +102,47 @@ typedef struct SML_CELL_TYPE {
 	SML_D_TYPE d_type;
 } SML_CELL_TYPE;
 
+/*
+ * index (if index_len>0) keeps file offsets of rows or tiles 
+ * of the layout, index[index_len-1] is the end of data;
+ * map is the read-only mapping of the data file (sml_layer_mmap_mode)
+ */
 typedef struct SML_DATA_HEADER {
 	FILE *f;
 	SML_FILE_STATUS file_status;
-	char name[SML_DATA_NAME_LEN];
-	char desc[SML_DATA_DESC_LEN];
+	char *name;
+	char *desc;
 	SML_CELL_TYPE *cell_type;
 	SML_WINDOW *file_win;
 	int cell_N_elements;
 	int cell_element_size;
 	int cell_size;
+	SML_LAYOUT layout;
+	int index_len;
+	long long *index;
+	void *map;
+	long long map_size;
+	void *coded;
+	long long coded_size;
+	int block_rows;
+	SML_CODEC codec;
+	void *blocks;
 } SML_DATA_HEADER;
 
+/*
+ * not zero elements of a row of cells: elements of the cell c are 
+ * idx[start[c]] ... idx[start[c+1]-1] with values val[start[c]] ...
+ */
+typedef struct SML_SPARSE_ROW {
+	int cols;
+	char *null;
+	int *start;
+	int *idx;
+	double *val;
+	int size;
+	void *row_buffer;
+} SML_SPARSE_ROW;
+
 
 /**   WINDOW
  * 
@@ -95,6 +157,7 @@ SML_DLL_API void sml_free_window(SML_WINDOW *w);
 SML_DLL_API SML_CELL_TYPE *sml_create_cell_type(SML_D_TYPE d, int ndim, int* dims);
 SML_DLL_API SML_CELL_TYPE *sml_create_cell_type_copy(SML_CELL_TYPE *ct0);
 SML_DLL_API void sml_free_cell_type(SML_CELL_TYPE *ct);
+SML_DLL_API int sml_get_d_type(const char *name);
 
 /**   LAYER
  * 
@@ -105,10 +168,19 @@ SML_DLL_API SML_DATA_HEADER* sml_create_layer(
 		SML_CELL_TYPE *cell_type,
 		SML_WINDOW *w);
 SML_DLL_API void sml_close_layer(SML_DATA_HEADER *dh);
+SML_DLL_API int sml_layer_mmap_mode(SML_DATA_HEADER *dh);
+SML_DLL_API int sml_set_layer_layout(SML_DATA_HEADER *dh, SML_LAYOUT layout);
+SML_DLL_API int sml_set_layer_blocks(SML_DATA_HEADER *dh, int block_rows, SML_CODEC codec);
+SML_DLL_API int sml_codec_available(SML_CODEC codec);
+SML_DLL_API int sml_get_codec(const char *name);
 SML_DLL_API void sml_set_layer_description(SML_DATA_HEADER *dh, char *desc[], int cnt);
+SML_DLL_API long long sml_get_row_offset(SML_DATA_HEADER *dh, int row);
 SML_DLL_API void sml_read_cell_from_layer(SML_DATA_HEADER *dh, void *cell, int col, int row);
 SML_DLL_API void sml_read_cell_from_layer_xy(SML_DATA_HEADER *dh, void *cell, double x, double y);
 SML_DLL_API void sml_read_row_from_layer(SML_DATA_HEADER *dh, void *cell_row, int row);
+SML_DLL_API void *sml_get_row_view(SML_DATA_HEADER *dh, void *cell_row, int row);
+SML_DLL_API void *sml_get_cell_view(SML_DATA_HEADER *dh, void *cell, int col, int row);
+SML_DLL_API void *sml_get_cell_view_xy(SML_DATA_HEADER *dh, void *cell, double x, double y);
 SML_DLL_API void sml_write_row_to_layer(SML_DATA_HEADER *dh, void *cell_row, int row);
 SML_DLL_API void sml_write_next_row_to_layer(SML_DATA_HEADER *dh, void *cell_row);
 
@@ -118,6 +190,13 @@ SML_DLL_API void sml_write_next_row_to_layer(SML_DATA_HEADER *dh, void *cell_row
 SML_DLL_API void *sml_create_cell_row_buffer(SML_DATA_HEADER *dh);
 SML_DLL_API void *sml_get_cell_pointer(SML_DATA_HEADER *dh, void *row_buffer, int i);
 
+/**   SPARSE ROW
+ * 
+ */
+SML_DLL_API SML_SPARSE_ROW *sml_create_sparse_row(SML_DATA_HEADER *dh);
+SML_DLL_API void sml_free_sparse_row(SML_SPARSE_ROW *sr);
+SML_DLL_API void sml_read_sparse_row_from_layer(SML_DATA_HEADER *dh, SML_SPARSE_ROW *sr, int row);
+
 /**   CELL
  * 
  */
@@ -130,12 +209,15 @@ SML_DLL_API int sml_get_cell_val_int(SML_DATA_HEADER *dh, void *cell, int i);
 SML_DLL_API void *sml_get_cell_val(SML_DATA_HEADER *dh, void *cell, int i);
 SML_DLL_API void sml_set_cell_val_dbl(SML_DATA_HEADER *dh, double v, void *cell, int i);
 SML_DLL_API void sml_set_cell_val_int(SML_DATA_HEADER *dh, int v, void *cell, int i);
+SML_DLL_API void sml_get_data_dbl(SML_DATA_HEADER *dh, void *data, double *v);
+SML_DLL_API void sml_set_data_dbl(SML_DATA_HEADER *dh, double *v, void *data);
 
 /**   CELL - text file
  * 
  */
 SML_DLL_API void sml_write_cell_txt(FILE *f, double x, double y, char *desc, void *cell, SML_DATA_HEADER *dh);
 SML_DLL_API void sml_write_dblbuf_txt(FILE *f, double x, double y, char *desc, double *buffer, int size, int dim, int *dims);
+SML_DLL_API void sml_write_dblbuf_txt_as(FILE *f, double x, double y, char *desc, double *buffer, int size, int dim, int *dims, SML_D_TYPE d_type);
 SML_DLL_API void sml_write_cell_csv(FILE *f, double x, double y, char *desc, void *cell, int use_nodata, double nodata, int decimals, SML_DATA_HEADER *dh);
 SML_DLL_API int sml_read_dblbuf_txt(FILE *f, double *x, double *y, char *desc, double *buffer, int size, SML_CELL_TYPE *ct);
 
@@ -0,0 +1,633 @@
+/****************************************************************************
+ *
+ * LIBRARY:	SML - Spatial Matrix Library
+ * AUTHOR(S):	Pawel Netzel
+ * PURPOSE:	compressed blocks of rows (SML_LAYOUT_BLOCKS)
+ * COPYRIGHT:	(C) Pawel Netzel
+ *              http://pawel.netzel.pl
+ *
+ *		This program is free software under the GNU Lesser General
+ *		Public License (>=v3). Read the file lgpl-3.0.txt
+ *
+ *****************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#include <pthread.h>
+#define SML_THREADS
+#endif
+
+#ifdef SML_ZSTD
+#include <zstd.h>
+#endif
+#ifdef SML_LZ4
+#include <lz4.h>
+#endif
+
+#define DLL_EXPORT
+
+#include "smlblock.h"
+
+/* size of a decoded block if the number of rows is not given */
+#define SML_BLOCK_SIZE (4L<<20)
+#define SML_LZ_HASH_BITS 14
+
+/*
+ * A block is a byte of the codec used (SML_CODEC_NONE if the block
+ * does not shrink) and the compressed cells. Cells are shuffled before
+ * compression: the k-th bytes of all cells of the block go together,
+ * so similar signatures give long runs.
+ */
+
+typedef enum {
+	SML_SLOT_EMPTY,
+	SML_SLOT_QUEUED,
+	SML_SLOT_BUSY,
+	SML_SLOT_READY
+} SML_SLOT_STATE;
+
+typedef struct SML_BLOCK_SLOT {
+	int block;
+	SML_SLOT_STATE state;
+	char *data;
+} SML_BLOCK_SLOT;
+
+/*
+ * Readers keep a ring of decoded blocks, block b lives in the slot
+ * b % nslots; workers decode blocks queued ahead of the consumer
+ * while it reads the blocks in order (last_block is the previous one).
+ * Writers fill one block of rows while the previous one is compressed
+ * and written in background.
+ */
+typedef struct SML_BLOCKS {
+	SML_DATA_HEADER *dh;
+	int nblocks;
+	long row_size;
+	long block_size;
+	char *coded;
+	char *shuffled;
+	/* reader */
+	int nslots;
+	SML_BLOCK_SLOT *slot;
+	int last_block;
+	int nthreads;
+	int stop;
+	/* writer */
+	char *rows;
+	int nrows;
+	char *pending;
+	int pending_rows;
+	int written;
+	int writer_started;
+#ifdef SML_THREADS
+	pthread_t *threads;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+#endif
+} SML_BLOCKS;
+
+
+/*****************************************************/
+/* codecs                                            */
+
+static char *sml_put_varint(char *d, char *end, unsigned long v) {
+	while(v >= 128) {
+		if(d >= end) return NULL;
+		*(d++) = (char)((v & 127) | 128);
+		v >>= 7;
+	}
+	if(d >= end) return NULL;
+	*(d++) = (char)v;
+	return d;
+}
+
+static const char *sml_get_varint(const char *s, const char *end, unsigned long *v) {
+	int shift = 0;
+	*v = 0;
+	while(s < end && shift < 64) {
+		unsigned char c = (unsigned char)*(s++);
+		*v |= (unsigned long)(c & 127) << shift;
+		if(!(c & 128)) return s;
+		shift += 7;
+	}
+	return NULL;
+}
+
+static unsigned int sml_lz_hash(const char *p) {
+	unsigned int v;
+	memcpy(&v,p,4);
+	return (v*2654435761u) >> (32-SML_LZ_HASH_BITS);
+}
+
+/*
+ * built-in LZ77: literal length, literals, match length - 3
+ * (0 ends the block) and offset; returns 0 if dst is too small
+ */
+static long sml_lz_compress(const char *src, long n, char *dst, long cap) {
+	long *table;
+	long i = 0, lit = 0, cand, len;
+	char *d = dst, *end = dst+cap;
+	unsigned int h;
+
+	table = (long *)calloc(1<<SML_LZ_HASH_BITS,sizeof(long));
+	if(table == NULL) error("\nNo RAM to proceed\n");
+
+	while(i+4 <= n) {
+		h = sml_lz_hash(src+i);
+		cand = table[h]-1;
+		table[h] = i+1;
+		if(cand < 0 || memcmp(src+cand,src+i,4) != 0) {
+			i++;
+			continue;
+		}
+		len = 4;
+		while(i+len < n && src[cand+len] == src[i+len]) len++;
+		if((d = sml_put_varint(d,end,i-lit)) == NULL || end-d < i-lit) break;
+		memcpy(d,src+lit,i-lit);
+		d += i-lit;
+		if((d = sml_put_varint(d,end,len-3)) == NULL ||
+		   (d = sml_put_varint(d,end,i-cand)) == NULL) break;
+		i += len;
+		lit = i;
+	}
+	free(table);
+	if(d == NULL || i+4 <= n) return 0;
+
+	if((d = sml_put_varint(d,end,n-lit)) == NULL || end-d < n-lit) return 0;
+	memcpy(d,src+lit,n-lit);
+	d += n-lit;
+	if((d = sml_put_varint(d,end,0)) == NULL) return 0;
+	return d-dst;
+}
+
+/* returns the length of decoded data, -1 if data are broken */
+static long sml_lz_decompress(const char *src, long n, char *dst, long cap) {
+	const char *end = src+n;
+	unsigned long lit, len, off;
+	long o = 0;
+
+	for(;;) {
+		if((src = sml_get_varint(src,end,&lit)) == NULL) return -1;
+		if(lit > (unsigned long)(end-src) || lit > (unsigned long)(cap-o)) return -1;
+		memcpy(dst+o,src,lit);
+		src += lit;
+		o += lit;
+		if((src = sml_get_varint(src,end,&len)) == NULL) return -1;
+		if(len == 0) break;
+		if((src = sml_get_varint(src,end,&off)) == NULL) return -1;
+		len += 3;
+		if(off == 0 || off > (unsigned long)o || len > (unsigned long)(cap-o)) return -1;
+		/* byte by byte, the match may overlap */
+		while(len-- > 0) {
+			dst[o] = dst[o-off];
+			o++;
+		}
+	}
+	return o;
+}
+
+int sml_codec_available(SML_CODEC codec) {
+	switch(codec) {
+		case SML_CODEC_NONE:
+		case SML_CODEC_LZ:
+			return 1;
+#ifdef SML_ZSTD
+		case SML_CODEC_ZSTD:
+			return 1;
+#endif
+#ifdef SML_LZ4
+		case SML_CODEC_LZ4:
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+/* codec of the name, -1 if it is unknown or not built in */
+int sml_get_codec(const char *name) {
+	int codec = -1;
+	if(strcmp(name,"NONE") == 0) codec = SML_CODEC_NONE;
+	else if(strcmp(name,"LZ") == 0) codec = SML_CODEC_LZ;
+	else if(strcmp(name,"ZSTD") == 0) codec = SML_CODEC_ZSTD;
+	else if(strcmp(name,"LZ4") == 0) codec = SML_CODEC_LZ4;
+	if(codec < 0 || !sml_codec_available((SML_CODEC)codec)) return -1;
+	return codec;
+}
+
+/* returns 0 if data do not fit into cap bytes */
+static long sml_compress(int codec, const char *src, long n, char *dst, long cap) {
+	switch(codec) {
+		case SML_CODEC_LZ:
+			return sml_lz_compress(src,n,dst,cap);
+#ifdef SML_ZSTD
+		case SML_CODEC_ZSTD: {
+			size_t r = ZSTD_compress(dst,cap,src,n,3);
+			return ZSTD_isError(r) ? 0 : (long)r;
+		}
+#endif
+#ifdef SML_LZ4
+		case SML_CODEC_LZ4:
+			return LZ4_compress_default(src,dst,(int)n,(int)cap);
+#endif
+	}
+	return 0;
+}
+
+static long sml_decompress(int codec, const char *src, long n, char *dst, long cap) {
+	switch(codec) {
+		case SML_CODEC_LZ:
+			return sml_lz_decompress(src,n,dst,cap);
+#ifdef SML_ZSTD
+		case SML_CODEC_ZSTD: {
+			size_t r = ZSTD_decompress(dst,cap,src,n);
+			return ZSTD_isError(r) ? -1 : (long)r;
+		}
+#endif
+#ifdef SML_LZ4
+		case SML_CODEC_LZ4:
+			return LZ4_decompress_safe(src,dst,(int)n,(int)cap);
+#endif
+	}
+	error("\nCompression method of the layer is not available\n");
+	return -1;
+}
+
+static void sml_shuffle(const char *src, char *dst, long ncells, int cell_size) {
+	long c;
+	int k;
+	for(k=0; k<cell_size; k++)
+		for(c=0; c<ncells; c++)
+			*(dst++) = src[c*cell_size+k];
+}
+
+static void sml_unshuffle(const char *src, char *dst, long ncells, int cell_size) {
+	long c;
+	int k;
+	for(k=0; k<cell_size; k++)
+		for(c=0; c<ncells; c++)
+			dst[c*cell_size+k] = *(src++);
+}
+
+
+/*****************************************************/
+/* blocks                                            */
+
+static int sml_rows_of_block(SML_DATA_HEADER *dh, int b) {
+	int r = dh->file_win->rows - b*dh->block_rows;
+	return (r < dh->block_rows) ? r : dh->block_rows;
+}
+
+static SML_BLOCKS *sml_create_blocks(SML_DATA_HEADER *dh) {
+	SML_BLOCKS *bl = (SML_BLOCKS *)calloc(1,sizeof(SML_BLOCKS));
+	if(bl == NULL) error("\nNo RAM to proceed\n");
+
+	bl->dh = dh;
+	bl->nblocks = (dh->file_win->rows+dh->block_rows-1)/dh->block_rows;
+	bl->row_size = (long)dh->file_win->cols*dh->cell_size;
+	bl->block_size = bl->row_size*dh->block_rows;
+	bl->coded = (char *)malloc(bl->block_size+1);
+	bl->shuffled = (char *)malloc(bl->block_size);
+	if(bl->coded == NULL || bl->shuffled == NULL) error("\nNo RAM to proceed\n");
+#ifdef SML_THREADS
+	pthread_mutex_init(&bl->lock,NULL);
+	pthread_cond_init(&bl->work,NULL);
+	pthread_cond_init(&bl->done,NULL);
+#endif
+	return bl;
+}
+
+/*
+ * Switches a new layer to compressed blocks of block_rows rows
+ * (about 4 MB if block_rows<=0), before the first row is written.
+ * Rows have to be written in order.
+ */
+int sml_set_layer_blocks(SML_DATA_HEADER *dh, int block_rows, SML_CODEC codec) {
+	long row_size = (long)dh->file_win->cols*dh->cell_size;
+	int nblocks;
+
+	if(!sml_codec_available(codec) || dh->file_win->rows < 1) return 0;
+	if(!sml_set_layer_layout(dh,SML_LAYOUT_ROWS)) return 0;
+
+	if(block_rows <= 0)
+		block_rows = (row_size < SML_BLOCK_SIZE) ? (int)(SML_BLOCK_SIZE/row_size) : 1;
+	if(block_rows > dh->file_win->rows)
+		block_rows = dh->file_win->rows;
+	nblocks = (dh->file_win->rows+block_rows-1)/block_rows;
+
+	dh->layout = SML_LAYOUT_BLOCKS;
+	dh->block_rows = block_rows;
+	dh->codec = codec;
+	dh->index = (long long *)calloc(nblocks+1,sizeof(long long));
+	if(dh->index == NULL) error("\nNo RAM to proceed\n");
+	dh->index_len = 1;
+	dh->blocks = sml_create_blocks(dh);
+	return 1;
+}
+
+
+/*****************************************************/
+/* writer                                            */
+
+static void sml_write_block(SML_BLOCKS *bl, const char *rows, int nrows) {
+	SML_DATA_HEADER *dh = bl->dh;
+	long n = nrows*bl->row_size;
+	long len;
+
+	sml_shuffle(rows,bl->shuffled,(long)nrows*dh->file_win->cols,dh->cell_size);
+	len = sml_compress(dh->codec,bl->shuffled,n,bl->coded+1,n);
+	if(len <= 0 || len >= n) {
+		bl->coded[0] = SML_CODEC_NONE;
+		memcpy(bl->coded+1,bl->shuffled,n);
+		len = n;
+	} else
+		bl->coded[0] = (char)dh->codec;
+	len++;
+	if(fwrite(bl->coded,1,len,dh->f) != (size_t)len) error("");
+	dh->index[dh->index_len] = dh->index[dh->index_len-1]+len;
+	dh->index_len++;
+}
+
+#ifdef SML_THREADS
+static void *sml_writer_thread(void *arg) {
+	SML_BLOCKS *bl = (SML_BLOCKS *)arg;
+	int n;
+
+	pthread_mutex_lock(&bl->lock);
+	for(;;) {
+		while(bl->pending_rows == 0 && !bl->stop)
+			pthread_cond_wait(&bl->work,&bl->lock);
+		if(bl->pending_rows == 0) break;
+		n = bl->pending_rows;
+		pthread_mutex_unlock(&bl->lock);
+		sml_write_block(bl,bl->pending,n);
+		pthread_mutex_lock(&bl->lock);
+		bl->pending_rows = 0;
+		pthread_cond_broadcast(&bl->done);
+	}
+	pthread_mutex_unlock(&bl->lock);
+	return NULL;
+}
+#endif
+
+static void sml_flush_block(SML_BLOCKS *bl) {
+	if(bl->nrows == 0) return;
+#ifdef SML_THREADS
+	if(!bl->writer_started) {
+		bl->pending = (char *)malloc(bl->block_size);
+		if(bl->pending != NULL && pthread_create(&bl->writer,NULL,sml_writer_thread,bl) == 0)
+			bl->writer_started = 1;
+	}
+	if(bl->writer_started) {
+		char *p;
+		pthread_mutex_lock(&bl->lock);
+		while(bl->pending_rows > 0)
+			pthread_cond_wait(&bl->done,&bl->lock);
+		p = bl->pending;
+		bl->pending = bl->rows;
+		bl->rows = p;
+		bl->pending_rows = bl->nrows;
+		pthread_cond_signal(&bl->work);
+		pthread_mutex_unlock(&bl->lock);
+		bl->nrows = 0;
+		return;
+	}
+#endif
+	sml_write_block(bl,bl->rows,bl->nrows);
+	bl->nrows = 0;
+}
+
+/* row<0 is the next row */
+void sml_write_block_row(SML_DATA_HEADER *dh, void *cell_row, int row) {
+	SML_BLOCKS *bl = (SML_BLOCKS *)dh->blocks;
+
+	if(row >= 0 && row != bl->written) error("\nRows of a compressed layer have to be written in order\n");
+	if(bl->written >= dh->file_win->rows) error("\nRow is out of the layer\n");
+	if(bl->rows == NULL) {
+		bl->rows = (char *)malloc(bl->block_size);
+		if(bl->rows == NULL) error("\nNo RAM to proceed\n");
+	}
+	memcpy(bl->rows+bl->nrows*bl->row_size,cell_row,bl->row_size);
+	bl->nrows++;
+	bl->written++;
+	if(bl->nrows == dh->block_rows)
+		sml_flush_block(bl);
+}
+
+
+/*****************************************************/
+/* reader                                            */
+
+static void sml_read_at(SML_DATA_HEADER *dh, char *buf, long len, long long pos) {
+#ifdef SML_THREADS
+	long n = 0;
+	ssize_t r;
+	while(n < len) {
+		r = pread(fileno(dh->f),buf+n,len-n,(off_t)(pos+n));
+		if(r <= 0) error("\nError in reading compressed layer\n");
+		n += r;
+	}
+#else
+	if(fseek(dh->f,pos,SEEK_SET)!=0) error("");
+	if(fread(buf,1,len,dh->f)!=(size_t)len) error("");
+#endif
+}
+
+static void sml_decode_block(SML_BLOCKS *bl, int b, char *data, char *coded, char *shuffled) {
+	SML_DATA_HEADER *dh = bl->dh;
+	long long len = dh->index[b+1]-dh->index[b];
+	long n = sml_rows_of_block(dh,b)*bl->row_size;
+	long ncells = (long)sml_rows_of_block(dh,b)*dh->file_win->cols;
+
+	if(len < 1 || len > n+1) error("\nError in reading compressed layer\n");
+	sml_read_at(dh,coded,(long)len,dh->index[b]);
+	if(coded[0] == SML_CODEC_NONE) {
+		if(len-1 != n) error("\nError in reading compressed layer\n");
+		sml_unshuffle(coded+1,data,ncells,dh->cell_size);
+		return;
+	}
+	if(sml_decompress(coded[0],coded+1,(long)len-1,shuffled,n) != n)
+		error("\nError in reading compressed layer\n");
+	sml_unshuffle(shuffled,data,ncells,dh->cell_size);
+}
+
+#ifdef SML_THREADS
+static SML_BLOCK_SLOT *sml_next_queued(SML_BLOCKS *bl) {
+	SML_BLOCK_SLOT *s = NULL;
+	int i;
+	for(i=0; i<bl->nslots; i++)
+		if(bl->slot[i].state == SML_SLOT_QUEUED && (s == NULL || bl->slot[i].block < s->block))
+			s = &(bl->slot[i]);
+	return s;
+}
+
+static void *sml_reader_thread(void *arg) {
+	SML_BLOCKS *bl = (SML_BLOCKS *)arg;
+	SML_BLOCK_SLOT *s;
+	char *coded = (char *)malloc(bl->block_size+1);
+	char *shuffled = (char *)malloc(bl->block_size);
+	int b;
+
+	if(coded == NULL || shuffled == NULL) error("\nNo RAM to proceed\n");
+	pthread_mutex_lock(&bl->lock);
+	for(;;) {
+		while(!bl->stop && (s = sml_next_queued(bl)) == NULL)
+			pthread_cond_wait(&bl->work,&bl->lock);
+		if(bl->stop) break;
+		s->state = SML_SLOT_BUSY;
+		b = s->block;
+		pthread_mutex_unlock(&bl->lock);
+		sml_decode_block(bl,b,s->data,coded,shuffled);
+		pthread_mutex_lock(&bl->lock);
+		s->state = SML_SLOT_READY;
+		pthread_cond_broadcast(&bl->done);
+	}
+	pthread_mutex_unlock(&bl->lock);
+	free(coded);
+	free(shuffled);
+	return NULL;
+}
+
+/* the slot of block b, NULL if a worker still decodes another block in it */
+static SML_BLOCK_SLOT *sml_queue_block(SML_BLOCKS *bl, int b) {
+	SML_BLOCK_SLOT *s = &(bl->slot[b % bl->nslots]);
+	if(s->block == b) return s;
+	if(s->state == SML_SLOT_BUSY) return NULL;
+	s->block = b;
+	s->state = SML_SLOT_QUEUED;
+	pthread_cond_signal(&bl->work);
+	return s;
+}
+#endif
+
+/* one worker per OpenMP thread, two slots per worker */
+static void sml_start_reader(SML_DATA_HEADER *dh) {
+	SML_BLOCKS *bl;
+	int i, n = 1;
+
+	if(dh->block_rows < 1 || (dh->file_win->rows+dh->block_rows-1)/dh->block_rows != dh->index_len-1)
+		error("\nError in reading compressed layer\n");
+	bl = sml_create_blocks(dh);
+	bl->last_block = -1;
+	dh->blocks = bl;
+#if defined(SML_THREADS) && defined(_OPENMP)
+	n = omp_get_max_threads();
+#endif
+	bl->nslots = (n > 1) ? 2*n : 2;
+	if(bl->nslots > bl->nblocks) bl->nslots = bl->nblocks;
+	bl->slot = (SML_BLOCK_SLOT *)calloc(bl->nslots,sizeof(SML_BLOCK_SLOT));
+	if(bl->slot == NULL) error("\nNo RAM to proceed\n");
+	for(i=0; i<bl->nslots; i++) {
+		bl->slot[i].block = -1;
+		bl->slot[i].data = (char *)malloc(bl->block_size);
+		if(bl->slot[i].data == NULL) error("\nNo RAM to proceed\n");
+	}
+#ifdef SML_THREADS
+	if(bl->nblocks > 1) {
+		bl->threads = (pthread_t *)malloc(n*sizeof(pthread_t));
+		for(i=0; bl->threads != NULL && i<n; i++) {
+			if(pthread_create(&(bl->threads[i]),NULL,sml_reader_thread,bl) != 0)
+				break;
+			bl->nthreads++;
+		}
+	}
+#endif
+}
+
+/* decoded row, valid until the next call */
+char *sml_get_block_row(SML_DATA_HEADER *dh, int row) {
+	SML_BLOCKS *bl;
+	SML_BLOCK_SLOT *s;
+	int b;
+
+	if(row < 0 || row >= dh->file_win->rows) error("\nRow is out of the layer\n");
+	if(dh->blocks == NULL) sml_start_reader(dh);
+	bl = (SML_BLOCKS *)dh->blocks;
+	b = row/dh->block_rows;
+	s = &(bl->slot[b % bl->nslots]);
+
+#ifdef SML_THREADS
+	if(bl->nthreads > 0) {
+		int k;
+		pthread_mutex_lock(&bl->lock);
+		while(s->block != b && s->state == SML_SLOT_BUSY)
+			pthread_cond_wait(&bl->done,&bl->lock);
+		sml_queue_block(bl,b);
+		/* read ahead only when the blocks are read in order,
+		   random access decodes just the block of the row */
+		if(b == bl->last_block+1)
+			for(k=1; k<bl->nslots && b+k<bl->nblocks; k++)
+				sml_queue_block(bl,b+k);
+		bl->last_block = b;
+		while(s->state != SML_SLOT_READY)
+			pthread_cond_wait(&bl->done,&bl->lock);
+		pthread_mutex_unlock(&bl->lock);
+		return s->data+(row-b*dh->block_rows)*bl->row_size;
+	}
+#endif
+	if(s->block != b) {
+		sml_decode_block(bl,b,s->data,bl->coded,bl->shuffled);
+		s->block = b;
+	}
+	return s->data+(row-b*dh->block_rows)*bl->row_size;
+}
+
+
+/*****************************************************/
+
+/* writes the last block and stops threads */
+void sml_finish_blocks(SML_DATA_HEADER *dh) {
+	SML_BLOCKS *bl = (SML_BLOCKS *)dh->blocks;
+	if(bl == NULL) return;
+
+	if(dh->file_status == SML_NEW)
+		sml_flush_block(bl);
+#ifdef SML_THREADS
+	pthread_mutex_lock(&bl->lock);
+	while(bl->pending_rows > 0)
+		pthread_cond_wait(&bl->done,&bl->lock);
+	bl->stop = 1;
+	pthread_cond_broadcast(&bl->work);
+	pthread_mutex_unlock(&bl->lock);
+	if(bl->writer_started) {
+		pthread_join(bl->writer,NULL);
+		bl->writer_started = 0;
+	}
+	while(bl->nthreads > 0)
+		pthread_join(bl->threads[--bl->nthreads],NULL);
+#endif
+}
+
+void sml_free_blocks(SML_DATA_HEADER *dh) {
+	SML_BLOCKS *bl = (SML_BLOCKS *)dh->blocks;
+	int i;
+	if(bl == NULL) return;
+
+	sml_finish_blocks(dh);
+#ifdef SML_THREADS
+	free(bl->threads);
+	pthread_mutex_destroy(&bl->lock);
+	pthread_cond_destroy(&bl->work);
+	pthread_cond_destroy(&bl->done);
+#endif
+	for(i=0; i<bl->nslots; i++)
+		free(bl->slot[i].data);
+	free(bl->slot);
+	free(bl->rows);
+	free(bl->pending);
+	free(bl->coded);
+	free(bl->shuffled);
+	free(bl);
+	dh->blocks = NULL;
+}
@@ -0,0 +1,27 @@
+#ifndef _SML_BLOCK_H_
+#define _SML_BLOCK_H_
+
+/****************************************************************************
+ *
+ * LIBRARY:	SML - Spatial Matrix Library
+ * AUTHOR(S):	Pawel Netzel
+ * PURPOSE:	compressed blocks of rows (SML_LAYOUT_BLOCKS),
+ *		internal functions used by smllib.c
+ * COPYRIGHT:	(C) Pawel Netzel
+ *              http://pawel.netzel.pl
+ *
+ *		This program is free software under the GNU Lesser General
+ *		Public License (>=v3). Read the file lgpl-3.0.txt
+ *
+ *****************************************************************************/
+
+#include "sml.h"
+
+void error(char *err);
+
+char *sml_get_block_row(SML_DATA_HEADER *dh, int row);
+void sml_write_block_row(SML_DATA_HEADER *dh, void *cell_row, int row);
+void sml_finish_blocks(SML_DATA_HEADER *dh);
+void sml_free_blocks(SML_DATA_HEADER *dh);
+
+#endif
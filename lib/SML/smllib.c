@@ -22,9 +22,14 @@
 #include <assert.h>
 #include <math.h>
 
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+
 #define DLL_EXPORT
 
 #include "sml.h"
+#include "smlblock.h"
 
 #define _FILE_OFFSET_BITS 64
 
@@ -37,6 +42,22 @@ void error(char *err) {
 }
 
 
+/* values out of [0, 1] are clamped */
+static unsigned short sml_quantize(double v) {
+	if(!(v > 0.0)) return 0;
+	if(v >= 1.0) return SML_UINT16Q_MAX;
+	return (unsigned short)(v*SML_UINT16Q_MAX+0.5);
+}
+
+char *sml_strdup(const char *s) {
+	char *d;
+	if(s==NULL) s="";
+	d = (char *)malloc(strlen(s)+1);
+	if(d==NULL) error("\nNo RAM to proceed\n");
+	strcpy(d,s);
+	return d;
+}
+
 long int sml_get_file_size(FILE *f) {
     long int p,i;
     p = ftell(f);
@@ -59,7 +80,7 @@ SML_WINDOW *sml_create_window(int rows, int cols,
 	win->at[5] = at5;
 	win->rows = rows;
 	win->cols = cols;
-	strncpy(win->proj,proj,SML_DATA_PROJ_LEN-1);
+	win->proj = sml_strdup(proj);
 	return win;
 }
 
@@ -70,11 +91,12 @@ SML_WINDOW *sml_create_window_copy(SML_WINDOW *w) {
 	  win->at[i] = w->at[i];
 	win->rows = w->rows;
 	win->cols = w->cols;
-	strncpy(win->proj,w->proj,SML_DATA_PROJ_LEN-1);
+	win->proj = sml_strdup(w->proj);
 	return win;
 }
 
 void sml_free_window(SML_WINDOW *w) {
+	free(w->proj);
 	free(w);
 }
 
@@ -98,6 +120,14 @@ SML_CELL_TYPE *sml_create_cell_type(SML_D_TYPE d_type, int ndim, int* dims) {
 	return ct;
 }
 
+/* names of storage types of signatures, -1 if unknown */
+int sml_get_d_type(const char *name) {
+	if(strcmp(name,"double") == 0) return SML_DOUBLE;
+	if(strcmp(name,"float32") == 0) return SML_FLOAT;
+	if(strcmp(name,"uint16q") == 0) return SML_UINT16Q;
+	return -1;
+}
+
 SML_CELL_TYPE *sml_create_cell_type_copy(SML_CELL_TYPE *ct0) {
 	int i;
 	SML_CELL_TYPE *ct = (SML_CELL_TYPE *)malloc(sizeof(SML_CELL_TYPE));
@@ -134,6 +164,7 @@ void sml_recalc_data_header(SML_DATA_HEADER *dh) {
 		for(i=0; i<dh->cell_type->dim; i++) 
 			j*=dh->cell_type->dims[i];
 	dh->cell_N_elements = j;
+	free(dh->cell_type->len);
 	dh->cell_type->len=(int *)malloc(sizeof(int)*dh->cell_type->dim);
 	dh->cell_type->len[dh->cell_type->dim-1] = 1;
 		for(i=dh->cell_type->dim-2; i>=0; i--)
@@ -155,19 +186,31 @@ void sml_recalc_data_header(SML_DATA_HEADER *dh) {
 		case SML_DOUBLE:
 				k=sizeof(double);
 				break;
+		case SML_UINT16Q: 
+				k=sizeof(unsigned short);
+				break;
 	}
 	dh->cell_element_size=k;
 	dh->cell_size=j*k+1;
 }
 
+char *sml_header_name(SML_DATA_HEADER *dh, const char *ext) {
+	char *name = (char *)malloc(strlen(dh->name)+strlen(ext)+1);
+	if(name==NULL) error("\nNo RAM to proceed\n");
+	strcpy(name,dh->name);
+	strcat(name,ext);
+	return name;
+}
+
 int sml_write_layer_header(SML_DATA_HEADER *dh) {
-	char name[512];
+	char *name;
 	FILE *f;
 	int i;
 	
-	strcpy(name,dh->name);
-	strcat(name,".hdr");
+	name = sml_header_name(dh,".hdr");
 	f=fopen(name,"w");
+	free(name);
+	if(!f) error("\nHeader file can not be created\n");
 	fprintf(f,"dim: %d\n",dh->cell_type->dim);
 	if(dh->cell_type->dim > 0) {
 		fprintf(f,"dims: %d",dh->cell_type->dims[0]);
@@ -191,6 +234,9 @@ int sml_write_layer_header(SML_DATA_HEADER *dh) {
 		case SML_BYTE:
 				fprintf(f,"type: BYTE\n");
 				break;
+		case SML_UINT16Q:
+				fprintf(f,"type: UINT16Q\n");
+				break;
 	}
 	fprintf(f,"at0: %.18lf\n",dh->file_win->at[0]);
 	fprintf(f,"at1: %.18lf\n",dh->file_win->at[1]);
@@ -207,16 +253,141 @@ int sml_write_layer_header(SML_DATA_HEADER *dh) {
 	return 0;
 }
 
+/*
+ * Binary header v4: magic, version, byte order mark, cell type, 
+ * window, layout, lengths of the projection, description and index,
+ * rows of blocks and codec (v3), then the projection, the description 
+ * and the index; v4 adds the SML_UINT16Q cell type.
+ */
+int sml_write_layer_header_bin(SML_DATA_HEADER *dh) {
+	char *name;
+	FILE *f;
+	int v[9], b[2];
+
+	name = sml_header_name(dh,".smh");
+	f=fopen(name,"wb");
+	free(name);
+	if(!f) error("\nHeader file can not be created\n");
+
+	v[0] = SML_HEADER_VERSION;
+	v[1] = SML_HEADER_ENDIAN;
+	v[2] = dh->cell_type->d_type;
+	v[3] = dh->cell_type->dim;
+	v[4] = dh->file_win->rows;
+	v[5] = dh->file_win->cols;
+	v[6] = dh->layout;
+	v[7] = (int)strlen(dh->file_win->proj);
+	v[8] = (int)strlen(dh->desc);
+	b[0] = dh->block_rows;
+	b[1] = dh->codec;
+	if(fwrite(SML_HEADER_MAGIC,4,1,f)!=1 ||
+	   fwrite(v,sizeof(int),9,f)!=9 ||
+	   fwrite(&(dh->index_len),sizeof(int),1,f)!=1 ||
+	   fwrite(b,sizeof(int),2,f)!=2 ||
+	   (dh->cell_type->dim>0 && fwrite(dh->cell_type->dims,sizeof(int),dh->cell_type->dim,f)!=dh->cell_type->dim) ||
+	   fwrite(dh->file_win->at,sizeof(double),6,f)!=6 ||
+	   fwrite(dh->file_win->proj,1,v[7],f)!=v[7] ||
+	   fwrite(dh->desc,1,v[8],f)!=v[8] ||
+	   (dh->index_len>0 && fwrite(dh->index,sizeof(long long),dh->index_len,f)!=dh->index_len))
+		error("\nError in writing header file\n");
+	fclose(f);
+
+	return 0;
+}
+
+/* reads the binary header, returns -1 if there is none */
+int sml_read_layer_header_bin(SML_DATA_HEADER *dh) {
+	char *name;
+	char magic[4];
+	FILE *f;
+	int v[9], b[2] = {0, SML_CODEC_NONE};
+
+	name = sml_header_name(dh,".smh");
+	f=fopen(name,"rb");
+	free(name);
+	if(!f) return -1;
+
+	if(fread(magic,4,1,f)!=1 || memcmp(magic,SML_HEADER_MAGIC,4)!=0 ||
+	   fread(v,sizeof(int),9,f)!=9) {
+		fclose(f);
+		return -1;
+	}
+	if(v[1]!=SML_HEADER_ENDIAN) error("\nByte order of the layer differs from this machine\n");
+	if(v[0]>SML_HEADER_VERSION) error("\nHeader file version is not supported\n");
+	if(v[6]!=SML_LAYOUT_ROWS && v[6]!=SML_LAYOUT_SPARSE && v[6]!=SML_LAYOUT_BLOCKS) 
+		error("\nLayout of the layer is not supported\n");
+	if(v[2]<SML_BYTE || v[2]>SML_UINT16Q) 
+		error("\nCell type of the layer is not supported\n");
+
+	dh->cell_type=(SML_CELL_TYPE *)calloc(1,sizeof(SML_CELL_TYPE));
+	dh->file_win=(SML_WINDOW *)calloc(1,sizeof(SML_WINDOW));
+	dh->cell_type->d_type = (SML_D_TYPE)v[2];
+	dh->cell_type->dim = v[3];
+	dh->file_win->rows = v[4];
+	dh->file_win->cols = v[5];
+	dh->layout = (SML_LAYOUT)v[6];
+	dh->file_win->proj = (char *)malloc(v[7]+1);
+	dh->desc = (char *)malloc(v[8]+1);
+	if(fread(&(dh->index_len),sizeof(int),1,f)!=1 ||
+	   (v[0]>=3 && fread(b,sizeof(int),2,f)!=2)) error("\nError in reading header file\n");
+	dh->block_rows = b[0];
+	dh->codec = (SML_CODEC)b[1];
+	if(dh->cell_type->dim > 0) {
+		dh->cell_type->dims=(int *)malloc(sizeof(int)*dh->cell_type->dim);
+		if(fread(dh->cell_type->dims,sizeof(int),dh->cell_type->dim,f)!=dh->cell_type->dim) error("\nError in reading header file\n");
+	}
+	if(dh->index_len > 0)
+		dh->index=(long long *)malloc(sizeof(long long)*dh->index_len);
+	if(dh->file_win->proj==NULL || dh->desc==NULL || (dh->index_len>0 && dh->index==NULL))
+		error("\nNo RAM to proceed\n");
+	if(fread(dh->file_win->at,sizeof(double),6,f)!=6 ||
+	   fread(dh->file_win->proj,1,v[7],f)!=v[7] ||
+	   fread(dh->desc,1,v[8],f)!=v[8] ||
+	   (dh->index_len>0 && fread(dh->index,sizeof(long long),dh->index_len,f)!=dh->index_len))
+		error("\nError in reading header file\n");
+	dh->file_win->proj[v[7]] = 0;
+	dh->desc[v[8]] = 0;
+	fclose(f);
+
+	return 0;
+}
+
+/* value of the "key: value" line, of any length */
+char *sml_read_header_line(FILE *f) {
+	int c, n = 0, len = 256;
+	char *s = (char *)malloc(len);
+
+	if(s==NULL) error("\nNo RAM to proceed\n");
+	while((c=fgetc(f))!=EOF && c!=':');
+	if(c==':' && (c=fgetc(f))!=' ' && c!=EOF) ungetc(c,f);
+	while(c!=EOF && (c=fgetc(f))!=EOF && c!='\n') {
+		if(n+1==len) {
+			len *= 2;
+			s = (char *)realloc(s,len);
+			if(s==NULL) error("\nNo RAM to proceed\n");
+		}
+		s[n++] = (char)c;
+	}
+	s[n] = 0;
+	return s;
+}
+
 int sml_read_layer_header(SML_DATA_HEADER *dh) {
-	char name[4096];
+	char *name;
 	FILE *f;
 	int i;
-	strcpy(name,dh->name);
-	strcat(name,".hdr");
+
+	if(sml_read_layer_header_bin(dh)==0)
+		return 0;
+
+	/* text header of older layers */
+	name = sml_header_name(dh,".hdr");
 	f=fopen(name,"r");
+	free(name);
 	if(!f) error("\nHeader file does not exist\n");
+	dh->layout = SML_LAYOUT_ROWS;
 	
-	dh->cell_type=(SML_CELL_TYPE *)malloc(sizeof(SML_CELL_TYPE));
+	dh->cell_type=(SML_CELL_TYPE *)calloc(1,sizeof(SML_CELL_TYPE));
 	if(fscanf(f,"%*[^:]: %d\n",&(dh->cell_type->dim))!=1) error("\nError in reading header file\n");
 	if(dh->cell_type->dim > 0) {
 		dh->cell_type->dims=(int *)malloc(sizeof(int)*dh->cell_type->dim);
@@ -224,7 +395,7 @@ int sml_read_layer_header(SML_DATA_HEADER *dh) {
 		for(i=1; i < dh->cell_type->dim; i++)
 			if(fscanf(f,",%d",&(dh->cell_type->dims[i]))!=1) error("\nError in reading header file\n");
 	}
-	if(fscanf(f,"%*[^: ]: %s\n",name)!=1) error("\nError in reading header file\n");
+	name = sml_read_header_line(f);
 	if(strcmp(name,"DOUBLE")==0)
 		dh->cell_type->d_type=SML_DOUBLE;
 	else if(strcmp(name,"FLOAT")==0)
@@ -235,8 +406,11 @@ int sml_read_layer_header(SML_DATA_HEADER *dh) {
 		dh->cell_type->d_type=SML_SHORT_INT;
 	else if(strcmp(name,"BYTE")==0)
 		dh->cell_type->d_type=SML_BYTE;
+	else if(strcmp(name,"UINT16Q")==0)
+		dh->cell_type->d_type=SML_UINT16Q;
 	else
 		error("\nError in reading header file\n");
+	free(name);
 	dh->file_win = (SML_WINDOW *)calloc(1,sizeof(SML_WINDOW));
 	if(fscanf(f,"%*[^:]: %lf",&(dh->file_win->at[0]))!=1) error("\nError in reading header file\n");
 	if(fscanf(f,"%*[^:]: %lf",&(dh->file_win->at[1]))!=1) error("\nError in reading header file\n");
@@ -247,13 +421,8 @@ int sml_read_layer_header(SML_DATA_HEADER *dh) {
 	if(fscanf(f,"%*[^:]: %d",&(dh->file_win->rows))!=1) error("\nError in reading header file\n");
 	if(fscanf(f,"%*[^:]: %d",&(dh->file_win->cols))!=1) error("\nError in reading header file\n");
 
-	fscanf(f,"%*[^:]: %[^\n]",dh->file_win->proj);
-	fscanf(f,"%*[^:]: %[^\n]",dh->desc);
-/*
-	if(fscanf(f,"%*[^:]: %[^\n]",dh->file_win->proj)!=1) error("\nError in reading header file\n");
-	
-	if(fscanf(f,"%*[^:]: %[^\n]",dh->desc)!=1) error("\nError in reading header file\n");
-*/
+	dh->file_win->proj = sml_read_header_line(f);
+	dh->desc = sml_read_header_line(f);
 	fclose(f);
 
 	return 0;
@@ -266,8 +435,10 @@ SML_DATA_HEADER* sml_create_layer(
 
 	SML_DATA_HEADER *dh = (SML_DATA_HEADER *)calloc(1,sizeof(SML_DATA_HEADER));
 	dh->f = fopen(fname,"wb");
-	strcpy(dh->name,fname);
+	dh->name = sml_strdup(fname);
+	dh->desc = sml_strdup("");
 	dh->file_status=SML_NEW;
+	dh->layout = SML_LAYOUT_ROWS;
 
 	dh->cell_type = cell_type;
 	dh->file_win = w;
@@ -282,7 +453,7 @@ SML_DATA_HEADER* sml_open_layer(char* fname) {
 	SML_DATA_HEADER *dh = (SML_DATA_HEADER *)calloc(1,sizeof(SML_DATA_HEADER));
 	dh->f = fopen(fname,"rb");
 	if(dh->f == NULL) error("\nData file can not be opened\n");
-	strcpy(dh->name,fname);
+	dh->name = sml_strdup(fname);
 	dh->file_status = SML_EXISTING;
 
 	sml_read_layer_header(dh);
@@ -293,35 +464,188 @@ SML_DATA_HEADER* sml_open_layer(char* fname) {
 };
 
 void sml_close_layer(SML_DATA_HEADER *dh) {
+	if(dh->layout == SML_LAYOUT_BLOCKS)
+	  sml_free_blocks(dh);
+#ifndef _MSC_VER
+	if(dh->map != NULL)
+	  munmap(dh->map,(size_t)dh->map_size);
+#endif
 	fclose(dh->f);
-	if(dh->file_status == SML_NEW)
-	  sml_write_layer_header(dh);
+	if(dh->file_status == SML_NEW) {
+	  sml_write_layer_header_bin(dh);
+	  if(dh->layout == SML_LAYOUT_ROWS)
+	    sml_write_layer_header(dh);
+	}
 	sml_free_cell_type(dh->cell_type);
 	sml_free_window(dh->file_win);
+	free(dh->index);
+	free(dh->coded);
+	free(dh->name);
+	free(dh->desc);
 	free(dh);
 };
 
+/*
+ * Sets the layout of a new layer, before the first row is written.
+ * Rows of SML_LAYOUT_SPARSE layers have to be written in order.
+ */
+int sml_set_layer_layout(SML_DATA_HEADER *dh, SML_LAYOUT layout) {
+	if(dh->file_status != SML_NEW || ftell(dh->f) != 0) return 0;
+	/* blocks are set by sml_set_layer_blocks */
+	if(layout == SML_LAYOUT_BLOCKS || dh->layout == SML_LAYOUT_BLOCKS) return 0;
+
+	free(dh->index);
+	dh->index = NULL;
+	dh->index_len = 0;
+	dh->layout = layout;
+	if(layout == SML_LAYOUT_SPARSE) {
+		dh->index = (long long *)calloc(dh->file_win->rows+1,sizeof(long long));
+		if(dh->index == NULL) error("\nNo RAM to proceed\n");
+		dh->index_len = 1;
+	}
+	return 1;
+}
+
+/*
+ * Maps the data file of an existing layer read-only. Rows and cells are
+ * then copied from the mapping, and sml_get_row_view/sml_get_cell_view
+ * return pointers into the file without copying at all. Pages are shared
+ * with other processes reading the same grid. Returns 0 and leaves
+ * the layer unchanged if the file cannot be mapped.
+ */
+int sml_layer_mmap_mode(SML_DATA_HEADER *dh) {
+#ifdef _MSC_VER
+	return 0;
+#else
+	long long size;
+	void *map;
+
+	if(dh == NULL || dh->file_status != SML_EXISTING) return 0;
+	if(dh->map != NULL) return 1;
+	if(dh->layout != SML_LAYOUT_ROWS) return 0;
+
+	size = sml_get_row_offset(dh,dh->file_win->rows);
+	if(size <= 0 || (long long)(size_t)size != size) return 0;
+	if(sml_get_file_size(dh->f) < size) return 0;
+
+	map = mmap(NULL,(size_t)size,PROT_READ,MAP_SHARED,fileno(dh->f),0);
+	if(map == MAP_FAILED) return 0;
+
+	dh->map = map;
+	dh->map_size = size;
+	return 1;
+#endif
+}
+
 void sml_set_layer_description(SML_DATA_HEADER *dh, char *desc[], int cnt) {
     char *s;
     int i,l;
 
-    l = SML_DATA_DESC_LEN-1;
+    l = 1;
+    for(i = 0; i < cnt; i++)
+        l += (int)strlen(desc[i])+1;
+    free(dh->desc);
+    dh->desc = (char *)malloc(l);
+    if(dh->desc==NULL) error("\nNo RAM to proceed\n");
     s = dh->desc;
     *s = 0;
     for(i = 0; i < cnt; i++) {
-	strncpy(s,desc[i],l);
-	l-=(int)strlen(desc[i]);
-        if(l<1) break;
+        strcpy(s,desc[i]);
         s+=strlen(desc[i]);
-        if(i<cnt-1) {
-	    strncpy(s,"|",l--);
-    	    if(l<1) break;
-    	    s+=1;
-        }
+        if(i<cnt-1)
+            *(s++) = '|';
     }
     *s=0;
 }
 
+/* buffer for an encoded row */
+static char *sml_coded_buffer(SML_DATA_HEADER *dh, long long size) {
+	if(size > dh->coded_size) {
+		free(dh->coded);
+		dh->coded = malloc((size_t)size);
+		if(dh->coded == NULL) error("\nNo RAM to proceed\n");
+		dh->coded_size = size;
+	}
+	return (char *)dh->coded;
+}
+
+static char *sml_read_coded_row(SML_DATA_HEADER *dh, int row) {
+	long long len;
+	char *p;
+
+	if(row+1 >= dh->index_len) error("\nRow is out of the layer\n");
+	len = dh->index[row+1]-dh->index[row];
+	p = sml_coded_buffer(dh,len);
+	if(fseek(dh->f,dh->index[row],SEEK_SET)!=0) error("");
+	if(len>0 && fread(p,1,(size_t)len,dh->f)!=(size_t)len) error("");
+	return p;
+}
+
+static int sml_is_element_zero(char *p, int size) {
+	while(size-- > 0)
+		if(*p++) return 0;
+	return 1;
+}
+
+/* null byte, then (if not null) n, n indices and n values */
+static long long sml_encode_sparse_row(SML_DATA_HEADER *dh, void *cell_row) {
+	int c, i, n;
+	int N = dh->cell_N_elements;
+	int es = dh->cell_element_size;
+	char *cell, *data, *p, *v;
+
+	p = sml_coded_buffer(dh,(long long)dh->file_win->cols*(1+sizeof(int)+(long long)N*(sizeof(int)+es)));
+	for(c=0; c<dh->file_win->cols; c++) {
+		cell = (char *)cell_row + (long)c*dh->cell_size;
+		*(p++) = *cell;
+		if(sml_is_cell_null(cell)) continue;
+		data = (char *)sml_get_cell_data(cell);
+		n = 0;
+		for(i=0; i<N; i++)
+			if(!sml_is_element_zero(data+i*es,es)) n++;
+		memcpy(p,&n,sizeof(int));
+		p += sizeof(int);
+		v = p + n*sizeof(int);
+		for(i=0; i<N; i++)
+			if(!sml_is_element_zero(data+i*es,es)) {
+				memcpy(p,&i,sizeof(int));
+				p += sizeof(int);
+				memcpy(v,data+i*es,es);
+				v += es;
+			}
+		p = v;
+	}
+	return p-(char *)dh->coded;
+}
+
+/* decodes a cell into cell (if not NULL), returns the next encoded cell */
+static char *sml_decode_sparse_cell(SML_DATA_HEADER *dh, char *p, void *cell) {
+	int i, j, n;
+	int es = dh->cell_element_size;
+
+	if(cell != NULL) {
+		memset(cell,0,dh->cell_size);
+		*((char *)cell) = *p;
+	}
+	if(sml_is_cell_null(p++)) return p;
+	memcpy(&n,p,sizeof(int));
+	p += sizeof(int);
+	if(cell != NULL)
+		for(i=0; i<n; i++) {
+			memcpy(&j,p+i*sizeof(int),sizeof(int));
+			if(j<0 || j>=dh->cell_N_elements) error("\nError in reading sparse layer\n");
+			memcpy((char *)sml_get_cell_data(cell)+j*es,p+n*sizeof(int)+i*es,es);
+		}
+	return p+n*(sizeof(int)+es);
+}
+
+/* file offset of the row, from the index if the layer has one */
+long long sml_get_row_offset(SML_DATA_HEADER *dh, int row) {
+    if(dh->index_len > row)
+        return dh->index[row];
+    return (long long)row*(long long)(dh->file_win->cols)*(long long)(dh->cell_size);
+}
+
 
 void *sml_create_cell_row_buffer(SML_DATA_HEADER *dh) {
   unsigned int size = dh->file_win->cols * dh->cell_size;
@@ -341,7 +665,22 @@ void sml_read_cell_from_layer(SML_DATA_HEADER *dh, void *cell, int col, int row)
       sml_set_cell_null(cell);
       return;
     }
-    unsigned long pos = ((unsigned long)row*(unsigned long)(dh->file_win->cols)+(unsigned long)col)*(unsigned long)(dh->cell_size);
+    if(dh->layout == SML_LAYOUT_BLOCKS) {
+      memcpy(cell,sml_get_block_row(dh,row)+(long)col*dh->cell_size,dh->cell_size);
+      return;
+    }
+    if(dh->layout == SML_LAYOUT_SPARSE) {
+      char *p = sml_read_coded_row(dh,row);
+      while(col-- > 0)
+        p = sml_decode_sparse_cell(dh,p,NULL);
+      sml_decode_sparse_cell(dh,p,cell);
+      return;
+    }
+    long long pos = sml_get_row_offset(dh,row)+(long long)col*(long long)(dh->cell_size);
+    if(dh->map != NULL) {
+      memcpy(cell,(char *)dh->map+pos,dh->cell_size);
+      return;
+    }
     if(fseek(dh->f,pos,SEEK_SET)!=0) error("");
     if(fread(cell,dh->cell_size,1,dh->f)!=1) error("");
 }
@@ -353,26 +692,167 @@ void sml_read_cell_from_layer_xy(SML_DATA_HEADER *dh, void *cell, double x, doub
 }
 
 void sml_read_row_from_layer(SML_DATA_HEADER *dh, void *cell_row, int row) {
-    unsigned long pos = (unsigned long)row*(unsigned long)(dh->file_win->cols)*(unsigned long)(dh->cell_size);
+    long long pos = sml_get_row_offset(dh,row);
+    if(dh->layout == SML_LAYOUT_BLOCKS) {
+      memcpy(cell_row,sml_get_block_row(dh,row),(size_t)dh->file_win->cols*dh->cell_size);
+      return;
+    }
+    if(dh->layout == SML_LAYOUT_SPARSE) {
+      char *p = sml_read_coded_row(dh,row);
+      int c;
+      for(c=0; c<dh->file_win->cols; c++)
+        p = sml_decode_sparse_cell(dh,p,(char *)cell_row+(long)c*dh->cell_size);
+      return;
+    }
+    if(dh->map != NULL) {
+      memcpy(cell_row,(char *)dh->map+pos,(size_t)dh->file_win->cols*dh->cell_size);
+      return;
+    }
     if(fseek(dh->f,pos,SEEK_SET)!=0) error("");
     if(fread(cell_row,dh->cell_size,dh->file_win->cols,dh->f)!=dh->file_win->cols)
         error("");
 }
 
+/*
+ * Row of cells as a pointer into the mapped file, or read into cell_row
+ * if the layer is not mapped. The view is read-only.
+ */
+void *sml_get_row_view(SML_DATA_HEADER *dh, void *cell_row, int row) {
+    if(dh->map != NULL)
+      return (char *)dh->map+sml_get_row_offset(dh,row);
+    sml_read_row_from_layer(dh,cell_row,row);
+    return cell_row;
+}
+
+/* the same for a single cell, cells outside the grid are null cells in cell */
+void *sml_get_cell_view(SML_DATA_HEADER *dh, void *cell, int col, int row) {
+    if(dh->map != NULL && col>=0 && col<dh->file_win->cols && row>=0 && row<dh->file_win->rows)
+      return (char *)dh->map+sml_get_row_offset(dh,row)+(long long)col*(long long)(dh->cell_size);
+    sml_read_cell_from_layer(dh,cell,col,row);
+    return cell;
+}
+
+void *sml_get_cell_view_xy(SML_DATA_HEADER *dh, void *cell, double x, double y) {
+    return sml_get_cell_view(dh,cell,sml_xy2c(dh,x,y),sml_xy2r(dh,x,y));
+}
+
 void sml_write_row_to_layer(SML_DATA_HEADER *dh, void *cell_row, int row) {
-    unsigned long pos = (unsigned long)row*(unsigned long)(dh->file_win->cols)*(unsigned long)(dh->cell_size);
+    long long pos;
+    /* the index of blocks is filled by the writer thread */
+    if(dh->layout == SML_LAYOUT_BLOCKS) {
+      sml_write_block_row(dh,cell_row,row);
+      return;
+    }
+    pos = sml_get_row_offset(dh,row);
+    if(dh->layout == SML_LAYOUT_SPARSE) {
+      if(row != dh->index_len-1) error("\nRows of a sparse layer have to be written in order\n");
+      if(fseek(dh->f,pos,SEEK_SET)!=0) error("");
+      sml_write_next_row_to_layer(dh,cell_row);
+      return;
+    }
     if(fseek(dh->f,pos,SEEK_SET)!=0) error("");
     if(fwrite(cell_row,dh->cell_size,dh->file_win->cols,dh->f)!=dh->file_win->cols)
         error("");
 }
 
 void sml_write_next_row_to_layer(SML_DATA_HEADER *dh, void *cell_row) {
+    if(dh->layout == SML_LAYOUT_BLOCKS) {
+      sml_write_block_row(dh,cell_row,-1);
+      return;
+    }
+    if(dh->layout == SML_LAYOUT_SPARSE) {
+      long long len = sml_encode_sparse_row(dh,cell_row);
+      if(dh->index_len > dh->file_win->rows) error("\nRow is out of the layer\n");
+      if(fwrite(dh->coded,1,(size_t)len,dh->f)!=(size_t)len) error("");
+      dh->index[dh->index_len] = dh->index[dh->index_len-1]+len;
+      dh->index_len++;
+      return;
+    }
     if(fwrite(cell_row,dh->cell_size,dh->file_win->cols,dh->f)!=dh->file_win->cols)
         error("");
 }
 
 
 
+SML_SPARSE_ROW *sml_create_sparse_row(SML_DATA_HEADER *dh) {
+	SML_SPARSE_ROW *sr = (SML_SPARSE_ROW *)calloc(1,sizeof(SML_SPARSE_ROW));
+	if(sr == NULL) error("\nNo RAM to proceed\n");
+	sr->cols = dh->file_win->cols;
+	sr->null = (char *)malloc(sr->cols);
+	sr->start = (int *)malloc((sr->cols+1)*sizeof(int));
+	if(dh->layout != SML_LAYOUT_SPARSE)
+		sr->row_buffer = sml_create_cell_row_buffer(dh);
+	if(sr->null == NULL || sr->start == NULL || 
+	   (dh->layout != SML_LAYOUT_SPARSE && sr->row_buffer == NULL)) 
+		error("\nNo RAM to proceed\n");
+	return sr;
+}
+
+void sml_free_sparse_row(SML_SPARSE_ROW *sr) {
+	if(sr == NULL) return;
+	free(sr->null);
+	free(sr->start);
+	free(sr->idx);
+	free(sr->val);
+	free(sr->row_buffer);
+	free(sr);
+}
+
+static void sml_sparse_row_size(SML_SPARSE_ROW *sr, int size) {
+	if(size <= sr->size) return;
+	if(size < 2*sr->size) size = 2*sr->size;
+	sr->idx = (int *)realloc(sr->idx,size*sizeof(int));
+	sr->val = (double *)realloc(sr->val,size*sizeof(double));
+	if(sr->idx == NULL || sr->val == NULL) error("\nNo RAM to proceed\n");
+	sr->size = size;
+}
+
+/* 
+ * Not zero elements of a row, sparse layers are not decoded into cells.
+ * Values of the encoded cell are laid out as data of a cell, so they 
+ * are converted by sml_get_cell_val_dbl.
+ */
+void sml_read_sparse_row_from_layer(SML_DATA_HEADER *dh, SML_SPARSE_ROW *sr, int row) {
+	int c, i, n, len = 0;
+	int N = dh->cell_N_elements;
+	int es = dh->cell_element_size;
+	char *p, *data;
+
+	if(dh->layout == SML_LAYOUT_SPARSE) {
+		p = sml_read_coded_row(dh,row);
+		for(c=0; c<sr->cols; c++) {
+			sr->start[c] = len;
+			sr->null[c] = sml_is_cell_null(p++);
+			if(sr->null[c]) continue;
+			memcpy(&n,p,sizeof(int));
+			p += sizeof(int);
+			sml_sparse_row_size(sr,len+n);
+			memcpy(sr->idx+len,p,n*sizeof(int));
+			p += n*sizeof(int);
+			for(i=0; i<n; i++)
+				sr->val[len+i] = sml_get_cell_val_dbl(dh,p-1,i);
+			p += n*es;
+			len += n;
+		}
+	} else {
+		sml_read_row_from_layer(dh,sr->row_buffer,row);
+		for(c=0; c<sr->cols; c++) {
+			p = (char *)sr->row_buffer + (long)c*dh->cell_size;
+			sr->start[c] = len;
+			sr->null[c] = sml_is_cell_null(p);
+			if(sr->null[c]) continue;
+			data = (char *)sml_get_cell_data(p);
+			for(i=0; i<N; i++)
+				if(!sml_is_element_zero(data+i*es,es)) {
+					sml_sparse_row_size(sr,len+1);
+					sr->idx[len] = i;
+					sr->val[len++] = sml_get_cell_val_dbl(dh,p,i);
+				}
+		}
+	}
+	sr->start[sr->cols] = len;
+}
+
 int sml_xy2c(SML_DATA_HEADER *dh, double x, double y) {
 	double *a = dh->file_win->at;
         return (int)floor((x - a[0])/a[1]);
@@ -451,6 +931,9 @@ double sml_get_cell_val_dbl(SML_DATA_HEADER *dh, void *cell, int i) {
 			case SML_BYTE:
 				v=*((char *)((char *)sml_get_cell_data(cell)+pos));
 				break;
+			case SML_UINT16Q:
+				v=*((unsigned short *)((char *)sml_get_cell_data(cell)+pos))/(double)SML_UINT16Q_MAX;
+				break;
 		}
 	}
 	return v;
@@ -475,6 +958,9 @@ int sml_get_cell_val_int(SML_DATA_HEADER *dh, void *cell, int i) {
 			case SML_BYTE:
 				v=(int)*((char *)((char *)sml_get_cell_data(cell)+pos));
 				break;
+			case SML_UINT16Q:
+				v=*((unsigned short *)((char *)sml_get_cell_data(cell)+pos))/SML_UINT16Q_MAX;
+				break;
 		}
 	}
 	return v;
@@ -517,6 +1003,9 @@ void sml_set_cell_val_dbl(SML_DATA_HEADER *dh, double v, void *cell, int i) {
 				else if(vv>255) vv=255;
 				*((unsigned char *)((char *)sml_get_cell_data(cell)+pos))=vv;
 				break;
+			case SML_UINT16Q:
+				*((unsigned short *)((char *)sml_get_cell_data(cell)+pos))=sml_quantize(v);
+				break;
 		}
 	}
 };
@@ -543,6 +1032,69 @@ void sml_set_cell_val_int(SML_DATA_HEADER *dh, int v, void *cell, int i) {
 				else if(v>255) v=255;
 				*((char *)((char *)sml_get_cell_data(cell)+pos))=v;
 				break;
+			case SML_UINT16Q:
+				*((unsigned short *)((char *)sml_get_cell_data(cell)+pos))=(v>0)?SML_UINT16Q_MAX:0;
+				break;
 		}
 	}
 };
+
+/* 
+ * All elements of cell data from/to doubles, data of cells do not 
+ * have to be aligned to the element type
+ */
+void sml_get_data_dbl(SML_DATA_HEADER *dh, void *data, double *v) {
+	int i, N = dh->cell_N_elements;
+	char *p = (char *)data;
+	float f;
+	unsigned short q;
+
+	switch(dh->cell_type->d_type) {
+		case SML_DOUBLE:
+			memcpy(v,p,N*sizeof(double));
+			break;
+		case SML_FLOAT:
+			for(i=0; i<N; i++, p+=sizeof(float)) {
+				memcpy(&f,p,sizeof(float));
+				v[i] = f;
+			}
+			break;
+		case SML_UINT16Q:
+			for(i=0; i<N; i++, p+=sizeof(unsigned short)) {
+				memcpy(&q,p,sizeof(unsigned short));
+				v[i] = q/(double)SML_UINT16Q_MAX;
+			}
+			break;
+		default:
+			for(i=0; i<N; i++)
+				v[i] = sml_get_cell_val_dbl(dh,p-1,i);
+	}
+}
+
+void sml_set_data_dbl(SML_DATA_HEADER *dh, double *v, void *data) {
+	int i, N = dh->cell_N_elements;
+	char *p = (char *)data;
+	float f;
+	unsigned short q;
+
+	switch(dh->cell_type->d_type) {
+		case SML_DOUBLE:
+			memcpy(p,v,N*sizeof(double));
+			break;
+		case SML_FLOAT:
+			for(i=0; i<N; i++, p+=sizeof(float)) {
+				f = (float)v[i];
+				memcpy(p,&f,sizeof(float));
+			}
+			break;
+		case SML_UINT16Q:
+			for(i=0; i<N; i++, p+=sizeof(unsigned short)) {
+				q = sml_quantize(v[i]);
+				memcpy(p,&q,sizeof(unsigned short));
+			}
+			break;
+		default:
+			for(i=0; i<N; i++)
+				sml_set_cell_val_dbl(dh,v[i],p-1,i);
+	}
+}
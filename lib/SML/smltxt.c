@@ -15,6 +15,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 #define DLL_EXPORT
 
@@ -63,17 +64,39 @@ void sml_write_cell_csv(FILE *f, double x, double y, char *desc, void *cell, int
 }
 
 void sml_write_dblbuf_txt(FILE *f, double x, double y, char *desc, double *buffer, int size, int dim, int *dims) {
+  sml_write_dblbuf_txt_as(f,x,y,desc,buffer,size,dim,dims,SML_DOUBLE);
+}
+
+/* 
+ * values are written with the precision of d_type: float32 keeps 
+ * 9 significant digits, uint16q is quantized and keeps 6 decimals
+ */
+void sml_write_dblbuf_txt_as(FILE *f, double x, double y, char *desc, double *buffer, int size, int dim, int *dims, SML_D_TYPE d_type) {
 
   int i;
+  double v;
   
   fprintf(f,"[%.10lf,%.10lf] \"%s\" %d:(%d",x,y,desc,dim,dims[0]);
   for(i=1; i<dim; i++)
     fprintf(f,",%d",dims[i]);
   if(size>0) {
     fprintf(f,") => ");
-    fprintf(f,"%.18lf",buffer[0]);
-    for(i=1; i<size; i++)
-      fprintf(f,",%.18lf",buffer[i]);
+    for(i=0; i<size; i++) {
+      if(i>0)
+        fprintf(f,",");
+      switch(d_type) {
+        case SML_FLOAT:
+          fprintf(f,"%.9g",(double)(float)buffer[i]);
+          break;
+        case SML_UINT16Q:
+          v = (buffer[i]>0.0) ? buffer[i] : 0.0;
+          if(v>1.0) v = 1.0;
+          fprintf(f,"%.6lf",floor(v*SML_UINT16Q_MAX+0.5)/SML_UINT16Q_MAX);
+          break;
+        default:
+          fprintf(f,"%.18lf",buffer[i]);
+      }
+    }
     fprintf(f,"\n");
   } else {
     fprintf(f,") -> ");
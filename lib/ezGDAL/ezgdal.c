@@ -19,9 +19,16 @@
 #include <float.h>
 #include <limits.h>
 #include <assert.h>
+#include <string.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <gdal.h>
 #include <ogr_srs_api.h>
 #include <cpl_string.h>
+#include <cpl_multiproc.h>
+#include <cpl_vsi.h>
 
 
 #define DLL_EXPORT
@@ -35,6 +42,10 @@
 
 static unsigned long max_frame_buffer_size = MAX_FRAME_BUFFER_SIZE;
 
+/* creation options of output layers, see ezgdal_set_writer_options */
+static char **create_options = NULL;
+static int cog_layout = FALSE;
+
 int  ezgdal_file_exists(const char *fname) {
   FILE *f = fopen(fname,"r");
   if(f) {
@@ -70,15 +81,24 @@ void  ezgdal_show_message(FILE *f, char *message) {
 /*                 TOOLS                    */
 /*                                          */
 
+/* geotransform of the layer's window, signatures ask for it from
+   parallel loops and the dataset handle is shared */
+void  ezgdal_layer_geo_transform(EZGDAL_LAYER *layer, double *p) {
+#pragma omp critical(ezgdal_layer_io)
+  GDALGetGeoTransform(layer->dataset_h, p);
+  p[0] += layer->win_col*p[1] + layer->win_row*p[2];
+  p[3] += layer->win_col*p[4] + layer->win_row*p[5];
+}
+
 int  ezgdal_is_bbox_ok(EZGDAL_LAYER **inputs, int ninputs) {
   double eps = 0.00000000001;
   double geo_transform[2][6];
   int i,j;
   
   if(ninputs<2) return 1;
-  GDALGetGeoTransform(inputs[0]->dataset_h,geo_transform[0]);
+  ezgdal_layer_geo_transform(inputs[0],geo_transform[0]);
   for(i=1; i<ninputs; i++) {
-	GDALGetGeoTransform(inputs[i]->dataset_h,geo_transform[1]);
+	ezgdal_layer_geo_transform(inputs[i],geo_transform[1]);
 	for(j=0; j<6; j++)
 	  if(fabs(geo_transform[0][j]-geo_transform[1][j])>eps)
 	    return 0;
@@ -141,7 +161,7 @@ char*  ezgdal_layer_get_wkt(EZGDAL_LAYER *layer) {
 double*  ezgdal_layer_get_at(EZGDAL_LAYER *layer) {
   double *p = malloc(6*sizeof(double));
 
-  GDALGetGeoTransform(layer->dataset_h, p);
+  ezgdal_layer_geo_transform(layer, p);
   return p;
 }
 
@@ -191,6 +211,85 @@ double  ezgdal_cr2y(EZGDAL_LAYER *layer, int col, int row) {
 /*                  LAYER                   */
 /*                                          */
 
+GDALDataType  ezgdal_gdal_data_type(EZGDAL_DATA_TYPE data_type) {
+  switch(data_type) {
+    case EZGDAL_UINT8:   return GDT_Byte;
+    case EZGDAL_UINT16:  return GDT_UInt16;
+    case EZGDAL_INT16:   return GDT_Int16;
+    case EZGDAL_INT32:   return GDT_Int32;
+    case EZGDAL_FLOAT32: return GDT_Float32;
+    default:             return GDT_Float64;
+  }
+}
+
+int  ezgdal_data_type_size(EZGDAL_DATA_TYPE data_type) {
+  switch(data_type) {
+    case EZGDAL_UINT8:   return sizeof(unsigned char);
+    case EZGDAL_UINT16:  return sizeof(unsigned short);
+    case EZGDAL_INT16:   return sizeof(short);
+    case EZGDAL_INT32:   return sizeof(int);
+    case EZGDAL_FLOAT32: return sizeof(float);
+    default:             return sizeof(double);
+  }
+}
+
+/* 
+ * Picks the type of stripe and frame cells: the band's own type
+ * as long as the no-data value fits into it, double otherwise.
+ */
+void  ezgdal_update_data_type(EZGDAL_LAYER *layer) {
+  EZGDAL_DATA_TYPE t;
+  double v;
+
+  switch(GDALGetRasterDataType(layer->band_h)) {
+    case GDT_Byte:    t = EZGDAL_UINT8; break;
+    case GDT_UInt16:  t = EZGDAL_UINT16; break;
+    case GDT_Int16:   t = EZGDAL_INT16; break;
+    case GDT_Int32:   t = EZGDAL_INT32; break;
+    case GDT_Float32: t = EZGDAL_FLOAT32; break;
+    default:          t = EZGDAL_FLOAT64; break;
+  }
+
+  if(layer->is_no_data) {
+    v = layer->no_data;
+    switch(t) {
+      case EZGDAL_UINT8:   if(v!=(double)(unsigned char)v) t = EZGDAL_FLOAT64; break;
+      case EZGDAL_UINT16:  if(v!=(double)(unsigned short)v) t = EZGDAL_FLOAT64; break;
+      case EZGDAL_INT16:   if(v!=(double)(short)v) t = EZGDAL_FLOAT64; break;
+      case EZGDAL_INT32:   if(v!=(double)(int)v) t = EZGDAL_FLOAT64; break;
+      case EZGDAL_FLOAT32: if(v!=(double)(float)v) t = EZGDAL_FLOAT64; break;
+      default: break;
+    }
+  }
+
+  layer->data_type = t;
+  layer->data_size = ezgdal_data_type_size(t);
+}
+
+void  ezgdal_fill_cells(void *p, EZGDAL_DATA_TYPE data_type, long n, double v) {
+  long i;
+  switch(data_type) {
+    case EZGDAL_UINT8:
+      memset(p, (unsigned char)v, n);
+      break;
+    case EZGDAL_UINT16:
+      for(i=0; i<n; i++) ((unsigned short *)p)[i] = (unsigned short)v;
+      break;
+    case EZGDAL_INT16:
+      for(i=0; i<n; i++) ((short *)p)[i] = (short)v;
+      break;
+    case EZGDAL_INT32:
+      for(i=0; i<n; i++) ((int *)p)[i] = (int)v;
+      break;
+    case EZGDAL_FLOAT32:
+      for(i=0; i<n; i++) ((float *)p)[i] = (float)v;
+      break;
+    default:
+      for(i=0; i<n; i++) ((double *)p)[i] = v;
+      break;
+  }
+}
+
 EZGDAL_LAYER*  ezgdal_open_layer(char *fname) {
 
   EZGDAL_LAYER *layer = NULL;
@@ -211,11 +310,17 @@ EZGDAL_LAYER*  ezgdal_open_layer(char *fname) {
   }
 
   layer->band_h = GDALGetRasterBand(layer->dataset_h,1);
+  layer->bands = GDALGetRasterCount(layer->dataset_h);
 
   layer->cols = GDALGetRasterBandXSize(layer->band_h);
   layer->rows = GDALGetRasterBandYSize(layer->band_h);
+  GDALGetBlockSize(layer->band_h, &(layer->block_cols), &(layer->block_rows));
 
   layer->no_data = GDALGetRasterNoDataValue(layer->band_h, &(layer->is_no_data));
+  /* alpha bands, .msk files and per dataset masks are not no-data,
+     cells out of them are null the same way as out of a mask */
+  layer->is_mask_band = !(GDALGetMaskFlags(layer->band_h) & (GMF_ALL_VALID | GMF_NODATA));
+  ezgdal_update_data_type(layer);
   layer->buffer = (double *)malloc(layer->cols*sizeof(double));
   layer->stripe = NULL;
   layer->frameset = NULL;
@@ -256,17 +361,627 @@ void  ezgdal_set_palette255(EZGDAL_LAYER *layer, double palette[][5], int n) {
 
 
 void  free_layer_stats(EZGDAL_LAYER *layer);
+void  ezgdal_write_cog(EZGDAL_LAYER *layer);
+void  ezgdal_wait_for_prefetch(EZGDAL_STRIPE *stripe);
+void  ezgdal_free_cache(EZGDAL_BLOCK_CACHE *cache);
+void  ezgdal_cache_set_data_type(EZGDAL_BLOCK_CACHE *cache, EZGDAL_LAYER *layer, EZGDAL_DATA_TYPE data_type);
 
 
 void  ezgdal_close_layer(EZGDAL_LAYER *layer) {
+  int i;
 
-  GDALClose(layer->dataset_h);
+  /* frames and their buffer pools */
+  if(layer->frameset!=NULL)
+    ezgdal_free_frameset(layer->frameset);
+  ezgdal_free_cache(layer->cache);
+  if(layer->vmem!=NULL)
+    CPLVirtualMemFree(layer->vmem);
+  for(i=0; i<layer->handles; i++)
+    GDALClose(layer->dataset_pool[i]);
+  free(layer->dataset_pool);
+  free(layer->band_pool);
+  if(layer->write_data!=NULL) {
+    ezgdal_flush_write_buffer(layer);
+    free(layer->write_data);
+    free(layer->write_flags);
+  }
+  if(layer->cog_fname!=NULL) {
+    ezgdal_write_cog(layer);
+    CPLFree(layer->cog_fname);
+  } else
+    GDALClose(layer->dataset_h);
   free(layer->buffer);
+  free(layer->band_buffer);
+  free(layer->band_no_data);
+  free(layer->band_is_no_data);
   free_layer_stats(layer);
+  if(layer->mask!=NULL)
+    ezgdal_close_layer(layer->mask);
 
   free(layer);
 }
 
+/*
+ * Opens n independent handles of the layer's dataset, one for each
+ * thread of a parallel region, so that threads can read and decompress 
+ * data at the same time. Returns the number of handles opened.
+ */
+int  ezgdal_layer_open_handles(EZGDAL_LAYER *layer, int n) {
+  const char *fname;
+  int i;
+
+  if(layer == NULL || n <= layer->handles) return layer ? layer->handles : 0;
+
+  fname = GDALGetDescription(layer->dataset_h);
+  layer->dataset_pool = (GDALDatasetH *)realloc(layer->dataset_pool, n*sizeof(GDALDatasetH));
+  layer->band_pool = (GDALRasterBandH *)realloc(layer->band_pool, n*sizeof(GDALRasterBandH));
+  if(layer->dataset_pool==NULL || layer->band_pool==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  for(i=layer->handles; i<n; i++) {
+    layer->dataset_pool[i] = GDALOpen(fname,GA_ReadOnly);
+    if(layer->dataset_pool[i]==NULL) break;
+    layer->band_pool[i] = GDALGetRasterBand(layer->dataset_pool[i],1);
+  }
+  layer->handles = i;
+  if(layer->mask!=NULL)
+    ezgdal_layer_open_handles(layer->mask, n);
+  return layer->handles;
+}
+
+/* 
+ * Band handle of the calling thread: band_h outside parallel regions,
+ * a pool handle inside them, NULL if the thread has no handle 
+ */
+GDALRasterBandH  ezgdal_layer_band(EZGDAL_LAYER *layer) {
+#ifdef _OPENMP
+  int t;
+
+  if(!omp_in_parallel()) return layer->band_h;
+  t = omp_get_thread_num();
+  return (t < layer->handles) ? layer->band_pool[t] : NULL;
+#else
+  return layer->band_h;
+#endif
+}
+
+/*
+ * Switches the layer to the mapped mode if the band's layout is directly
+ * addressable in the file (uncompressed, native byte order, cell type 
+ * not promoted). Stripe rows and frameset frames lying inside the raster
+ * are then served as views of the mapping instead of being read and 
+ * copied; the mapped frames are read-only, ezgdal_set_frame_null()
+ * clears the validity bit of a frameset frame in the validity mode and
+ * copies other frameset frames before writing into them. GDAL maps striped
+ * GeoTIFFs only, tiled ones are read and copied as before. Returns 
+ * FALSE and leaves the layer unchanged if the layout cannot be mapped.
+ */
+int  ezgdal_layer_mmap_mode(EZGDAL_LAYER *layer) {
+  char **options = NULL;
+  int pixel_space;
+  GIntBig line_space;
+
+  if(layer == NULL) return FALSE;
+  if(layer->vmem != NULL) return TRUE;
+
+  ezgdal_update_data_type(layer);
+  if(ezgdal_gdal_data_type(layer->data_type) != GDALGetRasterDataType(layer->band_h))
+    return FALSE;
+
+  /* no fallback to the page fault based emulation, it copies as well */
+  options = CSLSetNameValue(options, "USE_DEFAULT_IMPLEMENTATION", "NO");
+  layer->vmem = GDALGetVirtualMemAuto(layer->band_h, GF_Read, 
+                                      &pixel_space, &line_space, options);
+  CSLDestroy(options);
+  if(layer->vmem == NULL) return FALSE;
+
+  if(pixel_space != layer->data_size || line_space < (GIntBig)layer->cols*pixel_space) {
+    CPLVirtualMemFree(layer->vmem);
+    layer->vmem = NULL;
+    return FALSE;
+  }
+  layer->map_line = (long)line_space;
+  layer->map_data = (char *)CPLVirtualMemGetAddr(layer->vmem) + 
+                    (long)layer->win_row*layer->map_line + (long)layer->win_col*layer->data_size;
+
+  /* stripes choose their views again on the next load */
+  if(layer->stripe != NULL) {
+    ezgdal_wait_for_prefetch(layer->stripe);
+    layer->stripe->prefetch_row1 = INT_MIN;
+    layer->stripe->row1 = INT_MIN;
+  }
+  return TRUE;
+}
+
+/* GDALRasterIO through the calling thread's handle, threads 
+   without their own handle share band_h one at a time; 
+   col and row are counted in the layer's window */
+CPLErr  ezgdal_layer_raster_io(EZGDAL_LAYER *layer, GDALRWFlag rw,
+                               int col, int row, int cols, int rows,
+                               void *data, int buf_cols, int buf_rows,
+                               GDALDataType data_type, int pixel_space, int line_space) {
+  GDALRasterBandH band = ezgdal_layer_band(layer);
+  CPLErr res;
+
+  col += layer->win_col;
+  row += layer->win_row;
+
+  if(band != NULL)
+    return GDALRasterIO(band, rw, col, row, cols, rows, data, buf_cols, buf_rows,
+                        data_type, pixel_space, line_space);
+
+#pragma omp critical(ezgdal_layer_io)
+  res = GDALRasterIO(layer->band_h, rw, col, row, cols, rows, data, buf_cols, buf_rows,
+                     data_type, pixel_space, line_space);
+  return res;
+}
+
+/* reads the GDAL mask band of the layer (0 - null cell) through 
+   the calling thread's handle; col and row are counted in the window */
+CPLErr  ezgdal_layer_mask_band_io(EZGDAL_LAYER *layer, int col, int row, int cols, int rows, double *data) {
+  GDALRasterBandH band = ezgdal_layer_band(layer);
+  CPLErr res;
+
+  col += layer->win_col;
+  row += layer->win_row;
+
+  if(band != NULL)
+    return GDALRasterIO(GDALGetMaskBand(band), GF_Read, col, row, cols, rows, 
+                        data, cols, rows, GDT_Float64, 0, 0);
+
+#pragma omp critical(ezgdal_layer_io)
+  res = GDALRasterIO(GDALGetMaskBand(layer->band_h), GF_Read, col, row, cols, rows, 
+                     data, cols, rows, GDT_Float64, 0, 0);
+  return res;
+}
+
+/*
+ * Switches the layer to the cached mode: frameset frames are assembled
+ * from decoded blocks kept in an LRU cache of size bytes, so overlapping
+ * frames read every block of the band once. Hits and misses are counted
+ * in layer->cache.
+ */
+int  ezgdal_layer_cache_mode(EZGDAL_LAYER *layer, unsigned long size) {
+  EZGDAL_BLOCK_CACHE *cache;
+
+  if(layer == NULL || layer->cache != NULL) return FALSE;
+  ezgdal_update_data_type(layer);
+  if(size < (unsigned long)layer->block_rows*layer->block_cols*layer->data_size) return FALSE;
+
+  cache = (EZGDAL_BLOCK_CACHE *)calloc(1,sizeof(EZGDAL_BLOCK_CACHE));
+  if(cache==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  cache->size = size;
+  cache->lock = CPLCreateMutex();
+  if(cache->lock==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  CPLReleaseMutex((CPLMutex *)cache->lock);
+  ezgdal_cache_set_data_type(cache, layer, layer->data_type);
+
+  layer->cache = cache;
+  return TRUE;
+}
+
+/* 
+ * Number of blocks of data_type kept within the cache size, at least 
+ * one; the cache has to be empty.
+ */
+void  ezgdal_cache_set_data_type(EZGDAL_BLOCK_CACHE *cache, EZGDAL_LAYER *layer, EZGDAL_DATA_TYPE data_type) {
+  int i;
+
+  cache->data_type = data_type;
+  cache->blocks_len = cache->size / ((unsigned long)layer->block_rows*layer->block_cols*ezgdal_data_type_size(data_type));
+  if(cache->blocks_len < 1) cache->blocks_len = 1;
+  cache->block = (EZGDAL_CACHE_BLOCK *)realloc(cache->block, cache->blocks_len*sizeof(EZGDAL_CACHE_BLOCK));
+  cache->hash_len = 2*cache->blocks_len+1;
+  cache->hash = (int *)realloc(cache->hash, cache->hash_len*sizeof(int));
+  if(cache->block==NULL || cache->hash==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  for(i=0; i<cache->hash_len; i++)
+    cache->hash[i] = -1;
+  cache->head = cache->tail = -1;
+}
+
+void  ezgdal_free_cache(EZGDAL_BLOCK_CACHE *cache) {
+  int i;
+
+  if(cache == NULL) return;
+  for(i=0; i<cache->blocks; i++)
+    free(cache->block[i].data);
+  free(cache->block);
+  free(cache->hash);
+  CPLDestroyMutex((CPLMutex *)cache->lock);
+  free(cache);
+}
+
+int  ezgdal_cache_hash(EZGDAL_BLOCK_CACHE *cache, int block_row, int block_col) {
+  return (int)(((unsigned long)block_row*40503UL + (unsigned long)block_col) % cache->hash_len);
+}
+
+/* unlinks the block from the LRU list */
+void  ezgdal_cache_unlink(EZGDAL_BLOCK_CACHE *cache, int i) {
+  EZGDAL_CACHE_BLOCK *b = &(cache->block[i]);
+
+  if(b->prev >= 0) cache->block[b->prev].next = b->next; else cache->head = b->next;
+  if(b->next >= 0) cache->block[b->next].prev = b->prev; else cache->tail = b->prev;
+}
+
+void  ezgdal_cache_push_front(EZGDAL_BLOCK_CACHE *cache, int i) {
+  EZGDAL_CACHE_BLOCK *b = &(cache->block[i]);
+
+  b->prev = -1;
+  b->next = cache->head;
+  if(cache->head >= 0) cache->block[cache->head].prev = i;
+  cache->head = i;
+  if(cache->tail < 0) cache->tail = i;
+}
+
+int  ezgdal_cache_find(EZGDAL_BLOCK_CACHE *cache, int block_row, int block_col) {
+  int i = cache->hash[ezgdal_cache_hash(cache, block_row, block_col)];
+
+  while(i >= 0 && (cache->block[i].block_row != block_row || cache->block[i].block_col != block_col))
+    i = cache->block[i].hash_next;
+  return i;
+}
+
+/* drops all blocks, e.g. when the type of frames changes */
+void  ezgdal_cache_clear(EZGDAL_BLOCK_CACHE *cache) {
+  int i;
+
+  for(i=0; i<cache->blocks; i++)
+    free(cache->block[i].data);
+  cache->blocks = 0;
+  for(i=0; i<cache->hash_len; i++)
+    cache->hash[i] = -1;
+  cache->head = cache->tail = -1;
+}
+
+/* stores a decoded block, the least recently used one is evicted if the cache is full */
+int  ezgdal_cache_insert(EZGDAL_BLOCK_CACHE *cache, int block_row, int block_col, void *data) {
+  int i, *p;
+
+  if(cache->blocks < cache->blocks_len)
+    i = cache->blocks++;
+  else {
+    i = cache->tail;
+    ezgdal_cache_unlink(cache, i);
+    p = &(cache->hash[ezgdal_cache_hash(cache, cache->block[i].block_row, cache->block[i].block_col)]);
+    while(*p != i)
+      p = &(cache->block[*p].hash_next);
+    *p = cache->block[i].hash_next;
+    free(cache->block[i].data);
+  }
+
+  cache->block[i].block_row = block_row;
+  cache->block[i].block_col = block_col;
+  cache->block[i].data = data;
+  p = &(cache->hash[ezgdal_cache_hash(cache, block_row, block_col)]);
+  cache->block[i].hash_next = *p;
+  *p = i;
+  ezgdal_cache_push_front(cache, i);
+  return i;
+}
+
+/* 
+ * Reads cols x rows cells starting at col, row (inside the layer) 
+ * into data with line bytes per row, block by block through the cache.
+ * Blocks are decoded outside the lock, so threads read in parallel.
+ */
+void  ezgdal_cache_read(EZGDAL_LAYER *layer, int col, int row, int cols, int rows,
+                        void *data, EZGDAL_DATA_TYPE data_type, long line) {
+  EZGDAL_BLOCK_CACHE *cache = layer->cache;
+  int size = ezgdal_data_type_size(data_type);
+  int band_cols = GDALGetRasterBandXSize(layer->band_h);
+  int band_rows = GDALGetRasterBandYSize(layer->band_h);
+  int br, bc, br1, br2, bc1, bc2, bx, by, bw, bh, c1, c2, r1, r2, r, i;
+  void *block;
+
+  br1 = (row + layer->win_row) / layer->block_rows;
+  br2 = (row + rows - 1 + layer->win_row) / layer->block_rows;
+  bc1 = (col + layer->win_col) / layer->block_cols;
+  bc2 = (col + cols - 1 + layer->win_col) / layer->block_cols;
+
+  for(br=br1; br<=br2; br++)
+    for(bc=bc1; bc<=bc2; bc++) {
+      /* the block in band coordinates and its part needed by the frame */
+      bx = bc*layer->block_cols;
+      by = br*layer->block_rows;
+      bw = (bx + layer->block_cols > band_cols) ? band_cols - bx : layer->block_cols;
+      bh = (by + layer->block_rows > band_rows) ? band_rows - by : layer->block_rows;
+      c1 = (bx > col + layer->win_col) ? bx : col + layer->win_col;
+      c2 = (bx + bw < col + layer->win_col + cols) ? bx + bw - 1 : col + layer->win_col + cols - 1;
+      r1 = (by > row + layer->win_row) ? by : row + layer->win_row;
+      r2 = (by + bh < row + layer->win_row + rows) ? by + bh - 1 : row + layer->win_row + rows - 1;
+
+      CPLAcquireMutex((CPLMutex *)cache->lock, 1000.0);
+      /* frames of a layer share their type, it changes only with no-data */
+      if(cache->data_type != data_type) {
+        ezgdal_cache_clear(cache);
+        ezgdal_cache_set_data_type(cache, layer, data_type);
+      }
+      i = ezgdal_cache_find(cache, br, bc);
+      if(i >= 0) {
+        cache->hits++;
+        ezgdal_cache_unlink(cache, i);
+        ezgdal_cache_push_front(cache, i);
+      } else {
+        cache->misses++;
+        CPLReleaseMutex((CPLMutex *)cache->lock);
+
+        block = malloc((long)layer->block_rows*layer->block_cols*size);
+        if(block==NULL) {
+          ezgdal_show_message(stderr,"No RAM to proceed!");
+          exit(EXIT_FAILURE);
+        }
+        CPLErr res = ezgdal_layer_raster_io(layer, GF_Read,
+                                bx - layer->win_col, by - layer->win_row, bw, bh,
+                                block, bw, bh, ezgdal_gdal_data_type(data_type),
+                                0, (long)layer->block_cols*size);
+        if(res>CE_Warning) {
+          ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+          exit(EXIT_FAILURE);
+        }
+
+        CPLAcquireMutex((CPLMutex *)cache->lock, 1000.0);
+        /* another thread may have read the block in the meantime */
+        i = ezgdal_cache_find(cache, br, bc);
+        if(i >= 0)
+          free(block);
+        else
+          i = ezgdal_cache_insert(cache, br, bc, block);
+      }
+
+      for(r=r1; r<=r2; r++)
+        memcpy((char *)data + (long)(r - row - layer->win_row)*line + (long)(c1 - col - layer->win_col)*size,
+               (char *)cache->block[i].data + ((long)(r - by)*layer->block_cols + (c1 - bx))*size,
+               (long)(c2 - c1 + 1)*size);
+      CPLReleaseMutex((CPLMutex *)cache->lock);
+    }
+}
+
+/*
+ * Limits the layer to a window of its band: rows, cols, stripes, frames,
+ * statistics and the geotransform refer to the window only. col1 and 
+ * row1 are counted in the band. Has to be called before statistics, 
+ * stripes and framesets are made. Returns FALSE if the window 
+ * does not overlap the band.
+ */
+int  ezgdal_layer_set_window(EZGDAL_LAYER *layer, int col1, int row1, int cols, int rows) {
+  int band_cols, band_rows;
+
+  if(layer == NULL || layer->stripe != NULL || layer->frameset != NULL) return FALSE;
+
+  band_cols = GDALGetRasterBandXSize(layer->band_h);
+  band_rows = GDALGetRasterBandYSize(layer->band_h);
+  if(col1<0) { cols += col1; col1 = 0; }
+  if(row1<0) { rows += row1; row1 = 0; }
+  if(col1+cols>band_cols) cols = band_cols-col1;
+  if(row1+rows>band_rows) rows = band_rows-row1;
+  if(cols<=0 || rows<=0) return FALSE;
+
+  layer->win_col = col1;
+  layer->win_row = row1;
+  layer->cols = cols;
+  layer->rows = rows;
+  layer->is_window = TRUE;
+
+  layer->buffer = (double *)realloc(layer->buffer, cols*sizeof(double));
+  /* rows of all bands are allocated again at the next read */
+  free(layer->band_buffer);
+  free(layer->band_no_data);
+  free(layer->band_is_no_data);
+  layer->band_buffer = NULL;
+  layer->band_no_data = NULL;
+  layer->band_is_no_data = NULL;
+  if(layer->buffer==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  free_layer_stats(layer);
+  layer->stats = NULL;
+  if(layer->vmem != NULL)
+    layer->map_data = (char *)CPLVirtualMemGetAddr(layer->vmem) + 
+                      (long)row1*layer->map_line + (long)col1*layer->data_size;
+  if(layer->mask != NULL)
+    ezgdal_layer_set_window(layer->mask, col1, row1, cols, rows);
+  return TRUE;
+}
+
+/* window of the band covering a georeferenced bounding box (north-up rasters) */
+int  ezgdal_layer_set_bbox(EZGDAL_LAYER *layer, double xmin, double ymin, double xmax, double ymax) {
+  double a[6], c1, c2, r1, r2, p;
+  double band_cols, band_rows;
+
+  if(layer == NULL) return FALSE;
+  GDALGetGeoTransform(layer->dataset_h, a);
+  if(a[1]==0.0 || a[5]==0.0) return FALSE;
+
+  c1 = floor((xmin-a[0])/a[1]);
+  c2 = ceil((xmax-a[0])/a[1]);
+  r1 = floor((ymax-a[3])/a[5]);
+  r2 = ceil((ymin-a[3])/a[5]);
+  if(c1>c2) { p = c1; c1 = floor(c2); c2 = ceil(p); }
+  if(r1>r2) { p = r1; r1 = floor(r2); r2 = ceil(p); }
+
+  /* keep far away boxes in the int range */
+  band_cols = GDALGetRasterBandXSize(layer->band_h);
+  band_rows = GDALGetRasterBandYSize(layer->band_h);
+  if(c2<=0.0 || r2<=0.0 || c1>=band_cols || r1>=band_rows) return FALSE;
+  if(c1<0.0) c1 = 0.0;
+  if(r1<0.0) r1 = 0.0;
+  if(c2>band_cols) c2 = band_cols;
+  if(r2>band_rows) r2 = band_rows;
+
+  return ezgdal_layer_set_window(layer, (int)c1, (int)r1, (int)(c2-c1), (int)(r2-r1));
+}
+
+/*
+ * Cells that are null or zero in the mask raster become null cells 
+ * of the layer. The mask has to have the size and the georeference
+ * of the layer's band. The layer keeps its cell type and no-data value,
+ * masked cells are null in the validity bitmasks of stripes and frames.
+ */
+int  ezgdal_layer_set_mask(EZGDAL_LAYER *layer, char *fname) {
+  EZGDAL_LAYER *inputs[2];
+  EZGDAL_LAYER *mask;
+
+  if(layer == NULL || layer->stripe != NULL || layer->frameset != NULL) return FALSE;
+
+  mask = ezgdal_open_layer(fname);
+  if(mask == NULL) return FALSE;
+  if(GDALGetRasterBandXSize(mask->band_h) != GDALGetRasterBandXSize(layer->band_h) ||
+     GDALGetRasterBandYSize(mask->band_h) != GDALGetRasterBandYSize(layer->band_h)) {
+    ezgdal_close_layer(mask);
+    return FALSE;
+  }
+  if(layer->is_window)
+    ezgdal_layer_set_window(mask, layer->win_col, layer->win_row, layer->cols, layer->rows);
+  inputs[0] = layer;
+  inputs[1] = mask;
+  if(!ezgdal_is_bbox_ok(inputs, 2)) {
+    ezgdal_close_layer(mask);
+    return FALSE;
+  }
+
+  if(layer->mask != NULL)
+    ezgdal_close_layer(layer->mask);
+  layer->mask = mask;
+  layer->is_window = TRUE;
+  free_layer_stats(layer);
+  layer->stats = NULL;
+  if(layer->handles > 0)
+    ezgdal_layer_open_handles(mask, layer->handles);
+  return TRUE;
+}
+
+/*
+ * Region of interest given by command line arguments, each may be NULL:
+ * a pixel window "col,row,cols,rows", a bounding box 
+ * "xmin,ymin,xmax,ymax" and a mask raster file name.
+ */
+int  ezgdal_layer_set_region(EZGDAL_LAYER *layer, const char *window, const char *bbox, const char *mask) {
+  int c, r, cols, rows;
+  double x1, y1, x2, y2;
+
+  if(window != NULL) {
+    if(sscanf(window,"%d,%d,%d,%d",&c,&r,&cols,&rows)!=4 ||
+       !ezgdal_layer_set_window(layer, c, r, cols, rows))
+      return FALSE;
+  }
+  if(bbox != NULL) {
+    if(sscanf(bbox,"%lf,%lf,%lf,%lf",&x1,&y1,&x2,&y2)!=4 ||
+       !ezgdal_layer_set_bbox(layer, x1, y1, x2, y2))
+      return FALSE;
+  }
+  if(mask != NULL && !ezgdal_layer_set_mask(layer, (char *)mask))
+    return FALSE;
+  return TRUE;
+}
+
+/* cells of the layer can be null because of a mask raster or a mask band */
+int  ezgdal_is_masked(EZGDAL_LAYER *layer) {
+  return layer->mask != NULL || layer->is_mask_band;
+}
+
+/*
+ * Flags of a block of rows x cols cells of the layer's window starting
+ * at col, row: 0 where the mask is null or zero or the mask band 
+ * is 0, 1 elsewhere. Returns NULL if the layer is not masked, 
+ * the flags are freed by the caller.
+ */
+unsigned char*  ezgdal_read_mask_flags(EZGDAL_LAYER *layer, int col, int row, int cols, int rows) {
+  EZGDAL_LAYER *m = layer->mask;
+  unsigned char *flags;
+  double *buf, v;
+  long i, n = (long)rows*cols;
+  CPLErr res;
+
+  if(!ezgdal_is_masked(layer) || cols <= 0 || rows <= 0) return NULL;
+
+  buf = (double *)malloc(n*sizeof(double));
+  flags = (unsigned char *)malloc(n);
+  if(buf==NULL || flags==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  memset(flags, 1, n);
+
+  if(m != NULL) {
+    res = ezgdal_layer_raster_io(m, GF_Read, col, row, cols, rows,
+                                 buf, cols, rows, GDT_Float64, 0, 0);
+    if(res>CE_Warning) {
+      ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+      exit(EXIT_FAILURE);
+    }
+    for(i=0; i<n; i++) {
+      v = buf[i];
+      if(v==0.0 || v!=v || ezgdal_is_null(m, v))
+        flags[i] = 0;
+    }
+  }
+
+  if(layer->is_mask_band) {
+    res = ezgdal_layer_mask_band_io(layer, col, row, cols, rows, buf);
+    if(res>CE_Warning) {
+      ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+      exit(EXIT_FAILURE);
+    }
+    for(i=0; i<n; i++)
+      if(buf[i]==0.0)
+        flags[i] = 0;
+  }
+  free(buf);
+  return flags;
+}
+
+/*
+ * Sets cells of a block of the layer's window to null where the mask 
+ * is null or zero. The block of rows x cols cells of the given type
+ * starts at col, row; its rows are line bytes apart. Only buffers
+ * able to hold the null value are masked this way: doubles (NaN 
+ * if the layer has no no-data value) and category indices; stripes 
+ * and frames of values keep the mask in their validity bitmasks.
+ */
+void  ezgdal_apply_mask(EZGDAL_LAYER *layer, void *data, EZGDAL_DATA_TYPE data_type, double null,
+                        int col, int row, int cols, int rows, long line) {
+  unsigned char *flags;
+  int r, c, size;
+
+  flags = ezgdal_read_mask_flags(layer, col, row, cols, rows);
+  if(flags == NULL) return;
+
+  size = ezgdal_data_type_size(data_type);
+  for(r=0; r<rows; r++)
+    for(c=0; c<cols; c++)
+      if(!flags[(long)r*cols+c])
+        ezgdal_fill_cells((char *)data + r*line + (long)c*size, data_type, 1, null);
+  free(flags);
+}
+
+/* null of the double rows of a masked layer */
+double  ezgdal_mask_null_value(EZGDAL_LAYER *layer) {
+  return layer->is_no_data ? layer->no_data : NAN;
+}
+
+/* creation options for a data type: DEFLATE, LZW and ZSTD get a predictor */
+char**  ezgdal_create_options(GDALDataType data_type) {
+  char **options = CSLDuplicate(create_options);
+  const char *compress = CSLFetchNameValue(options,"COMPRESS");
+
+  if(compress!=NULL && CSLFetchNameValue(options,"PREDICTOR")==NULL &&
+     (EQUAL(compress,"DEFLATE") || EQUAL(compress,"LZW") || EQUAL(compress,"ZSTD")))
+    options = CSLSetNameValue(options,"PREDICTOR",
+                              (data_type==GDT_Float32 || data_type==GDT_Float64) ? "3" : "2");
+  return options;
+}
+
 EZGDAL_LAYER*  ezgdal_create_layer(char *fname, 
                          char *wkt,
                          char *d_type,
@@ -279,6 +994,7 @@ EZGDAL_LAYER*  ezgdal_create_layer(char *fname,
   int is_no_data = FALSE;
   double no_data = DBL_MIN;
   const char *data_format = "GTiff";
+  char **options;
   GDALDataType data_type;
   GDALDriverH driver;
   
@@ -301,8 +1017,17 @@ EZGDAL_LAYER*  ezgdal_create_layer(char *fname,
 
   o->cols = cols;
   o->rows = rows;
-  
-  o->dataset_h = GDALCreate(driver,fname,o->cols,o->rows,1,data_type,NULL);
+  o->bands = 1;
+
+  options = ezgdal_create_options(data_type);
+
+  /* the COG layout is made from a temporary file when the layer is closed */
+  if(cog_layout) {
+    o->cog_fname = CPLStrdup(fname);
+    o->dataset_h = GDALCreate(driver,CPLSPrintf("%s.tmp.tif",fname),o->cols,o->rows,1,data_type,options);
+  } else
+    o->dataset_h = GDALCreate(driver,fname,o->cols,o->rows,1,data_type,options);
+  CSLDestroy(options);
 
   if(!(o->dataset_h)) {
     ezgdal_show_message(stderr,"Problem with  file!!");
@@ -310,12 +1035,14 @@ EZGDAL_LAYER*  ezgdal_create_layer(char *fname,
   }
      
   o->band_h = GDALGetRasterBand(o->dataset_h,1);
+  GDALGetBlockSize(o->band_h, &(o->block_cols), &(o->block_rows));
 
   o->no_data = no_data;
   o->is_no_data = is_no_data;
 
   if(is_no_data)
     GDALSetRasterNoDataValue(o->band_h,no_data);
+  ezgdal_update_data_type(o);
 
   o->buffer = (double *)malloc(o->cols*sizeof(double));
   o->stripe = NULL;
@@ -336,23 +1063,252 @@ void  ezgdal_read_buffer(EZGDAL_LAYER *layer, int row) {
     p = layer->buffer;
     for(i=0; i<layer->cols; i++)
       *(p++) = d;
-  } else
-    i=GDALRasterIO(layer->band_h, GF_Read,0, row, layer->cols, 1,
+  } else {
+    i=GDALRasterIO(layer->band_h, GF_Read,layer->win_col, layer->win_row+row, layer->cols, 1,
                  layer->buffer, layer->cols, 1, GDT_Float64, 0, 0);
+    ezgdal_apply_mask(layer, layer->buffer, EZGDAL_FLOAT64, ezgdal_mask_null_value(layer), 
+                      0, row, layer->cols, 1, 0);
+  }
 }
 
-void  ezgdal_write_buffer(EZGDAL_LAYER *layer, int row) {
-  if(row<0 || row>=layer->rows) return;
-  CPLErr res = GDALRasterIO(layer->band_h, GF_Write, 0, row, layer->cols, 1,
-               layer->buffer, layer->cols, 1, GDT_Float64, 0, 0);
+/* buffers and no-data values of all bands, band 1 follows the layer */
+void  ezgdal_alloc_bands_buffer(EZGDAL_LAYER *layer) {
+  int b;
+
+  layer->band_buffer = (double *)malloc((long)(layer->bands+1)*layer->cols*sizeof(double));
+  layer->band_no_data = (double *)malloc(layer->bands*sizeof(double));
+  layer->band_is_no_data = (int *)malloc(layer->bands*sizeof(int));
+  if(layer->band_buffer==NULL || layer->band_no_data==NULL || layer->band_is_no_data==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  for(b=1; b<layer->bands; b++)
+    layer->band_no_data[b] = GDALGetRasterNoDataValue(GDALGetRasterBand(layer->dataset_h, b+1),
+                                                      &(layer->band_is_no_data[b]));
+}
+
+/*
+ * Reads the row of all bands in one GDALDatasetRasterIO call:
+ * cell c of band b is band_buffer[b*cols + c].
+ */
+void  ezgdal_read_bands_buffer(EZGDAL_LAYER *layer, int row) {
+  int b, i;
+  double *p, *m;
+  CPLErr res;
+
+  if(layer->band_buffer==NULL)
+    ezgdal_alloc_bands_buffer(layer);
+  layer->band_no_data[0] = layer->no_data;
+  layer->band_is_no_data[0] = layer->is_no_data;
+
+  if(row<0 || row>=layer->rows) {
+    for(b=0; b<layer->bands; b++) {
+      p = layer->band_buffer + (long)b*layer->cols;
+      for(i=0; i<layer->cols; i++)
+        p[i] = layer->band_is_no_data[b] ? layer->band_no_data[b] : 0.0;
+    }
+    return;
+  }
+
+  res = GDALDatasetRasterIO(layer->dataset_h, GF_Read, layer->win_col, layer->win_row+row, layer->cols, 1,
+                            layer->band_buffer, layer->cols, 1, GDT_Float64, layer->bands, NULL,
+                            0, 0, layer->cols*sizeof(double));
   if(res>CE_Warning) {
     ezgdal_show_message(stderr,"GDAL I/O operation faild!");
     exit(EXIT_FAILURE);
   }
+
+  if(!ezgdal_is_masked(layer)) return;
+  /* the mask is read once for all bands, masked cells of bands
+     without no-data are NaN */
+  m = layer->band_buffer + (long)layer->bands*layer->cols;
+  for(i=0; i<layer->cols; i++)
+    m[i] = 1.0;
+  ezgdal_apply_mask(layer, m, EZGDAL_FLOAT64, 0.0, 0, row, layer->cols, 1, 0);
+  for(b=0; b<layer->bands; b++) {
+    p = layer->band_buffer + (long)b*layer->cols;
+    for(i=0; i<layer->cols; i++)
+      if(m[i]==0.0)
+        p[i] = layer->band_is_no_data[b] ? layer->band_no_data[b] : NAN;
+  }
+}
+
+int  ezgdal_is_band_null(EZGDAL_LAYER *layer, int band, double v) {
+  if(band==0 || layer->band_is_no_data==NULL)
+    return ezgdal_is_null(layer, v);
+  if(v != v && ezgdal_is_masked(layer))
+    return TRUE;
+  return (layer->band_is_no_data[band] && 
+          (v == layer->band_no_data[band] || (v != v && layer->band_no_data[band] != layer->band_no_data[band])));
+}
+
+/* minimum and maximum of every band (window and mask included), one pass over rows */
+void  ezgdal_calc_bands_range(EZGDAL_LAYER *layer, double *min, double *max) {
+  int b, r, c;
+  double v;
+
+  for(b=0; b<layer->bands; b++) {
+    min[b] = DBL_MAX;
+    max[b] = -DBL_MAX;
+  }
+  for(r=0; r<layer->rows; r++) {
+    ezgdal_read_bands_buffer(layer, r);
+    for(b=0; b<layer->bands; b++)
+      for(c=0; c<layer->cols; c++) {
+        v = layer->band_buffer[(long)b*layer->cols + c];
+        if(v!=v || ezgdal_is_band_null(layer, b, v)) continue;
+        if(v < min[b]) min[b] = v;
+        if(v > max[b]) max[b] = v;
+      }
+  }
+}
+
+/* writes rows collected in the write buffer, one GDALRasterIO call per run */
+void  ezgdal_flush_write_buffer(EZGDAL_LAYER *layer) {
+  int r, n;
+  long step;
+  CPLErr res;
+
+  if(layer->write_data==NULL) return;
+
+  step = (long)layer->cols * layer->data_size;
+  r = 0;
+  while(r<layer->block_rows) {
+    if(!layer->write_flags[r]) {
+      r++;
+      continue;
+    }
+    n = 1;
+    while(r+n<layer->block_rows && layer->write_flags[r+n])
+      n++;
+    res = GDALRasterIO(layer->band_h, GF_Write, 0, layer->write_block*layer->block_rows + r, 
+                       layer->cols, n, layer->write_data + r*step, layer->cols, n,
+                       ezgdal_gdal_data_type(layer->data_type), 0, step);
+    if(res>CE_Warning) {
+      ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+      exit(EXIT_FAILURE);
+    }
+    memset(layer->write_flags + r, 0, n);
+    r += n;
+  }
+}
+
+/*
+ * Rows are collected in the band's type until their block row is
+ * complete, so tiled and compressed outputs are written and compressed
+ * a whole block row at a time.
+ */
+void  ezgdal_write_buffer(EZGDAL_LAYER *layer, int row) {
+  int block, r;
+
+  if(row<0 || row>=layer->rows) return;
+
+  if(layer->write_data==NULL) {
+    layer->write_data = (char *)malloc((long)layer->block_rows * layer->cols * layer->data_size);
+    layer->write_flags = (char *)calloc(layer->block_rows, sizeof(char));
+    if(layer->write_data==NULL || layer->write_flags==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    layer->write_block = row / layer->block_rows;
+  }
+
+  block = row / layer->block_rows;
+  if(block != layer->write_block) {
+    ezgdal_flush_write_buffer(layer);
+    layer->write_block = block;
+  }
+
+  r = row - block*layer->block_rows;
+  GDALCopyWords(layer->buffer, GDT_Float64, sizeof(double),
+                layer->write_data + (long)r * layer->cols * layer->data_size,
+                ezgdal_gdal_data_type(layer->data_type), layer->data_size, layer->cols);
+  layer->write_flags[r] = 1;
+
+  if(r==layer->block_rows-1 || row==layer->rows-1)
+    ezgdal_flush_write_buffer(layer);
+}
+
+/*
+ * Sets creation options of output layers created later on. 
+ * A compression method (NONE, DEFLATE, LZW, ZSTD, ...) or the COG layout
+ * make the output tiled (256x256) and BigTIFF when needed; DEFLATE, 
+ * LZW and ZSTD get a predictor matching the data type. For the COG 
+ * layout, overviews are built and the file is rewritten when 
+ * the layer is closed.
+ */
+void  ezgdal_set_writer_options(const char *compress, int cog) {
+  if(compress!=NULL)
+    create_options = CSLSetNameValue(create_options,"COMPRESS",compress);
+  if(compress!=NULL || cog) {
+    create_options = CSLSetNameValue(create_options,"TILED","YES");
+    create_options = CSLSetNameValue(create_options,"BLOCKXSIZE","256");
+    create_options = CSLSetNameValue(create_options,"BLOCKYSIZE","256");
+    create_options = CSLSetNameValue(create_options,"BIGTIFF","IF_SAFER");
+  }
+  cog_layout = cog;
+}
+
+/* any GeoTIFF creation option, e.g. ("ZLEVEL","9") */
+void  ezgdal_set_create_option(const char *name, const char *value) {
+  create_options = CSLSetNameValue(create_options,name,value);
+}
+
+/* builds overviews of the temporary file and copies it to the COG layout */
+void  ezgdal_write_cog(EZGDAL_LAYER *layer) {
+  char *tmp_fname = CPLStrdup(GDALGetDescription(layer->dataset_h));
+  int levels[32], n = 0, size;
+  char **options = NULL, **layer_options;
+  const char *v;
+  GDALDataType data_type = GDALGetRasterDataType(layer->band_h);
+  GDALDriverH driver;
+  GDALDatasetH dst;
+
+  size = (layer->cols > layer->rows) ? layer->cols : layer->rows;
+  while(size > 256 && n < 32) {
+    levels[n] = 1 << (n+1);
+    size /= 2;
+    n++;
+  }
+  if(n>0)
+    GDALBuildOverviews(layer->dataset_h,
+                       (data_type==GDT_Float32 || data_type==GDT_Float64) ? "AVERAGE" : "NEAREST",
+                       n, levels, 0, NULL, NULL, NULL);
+
+  layer_options = ezgdal_create_options(data_type);
+  if((v = CSLFetchNameValue(layer_options,"COMPRESS"))!=NULL)
+    options = CSLSetNameValue(options,"COMPRESS",v);
+  if((v = CSLFetchNameValue(layer_options,"PREDICTOR"))!=NULL)
+    options = CSLSetNameValue(options,"PREDICTOR",v);
+  options = CSLSetNameValue(options,"BIGTIFF","IF_SAFER");
+  CSLDestroy(layer_options);
+
+  /* the COG driver (GDAL >= 3.1) or the classic GeoTIFF recipe */
+  driver = GDALGetDriverByName("COG");
+  if(driver==NULL) {
+    driver = GDALGetDriverByName("GTiff");
+    options = CSLSetNameValue(options,"TILED","YES");
+    options = CSLSetNameValue(options,"COPY_SRC_OVERVIEWS","YES");
+  }
+  dst = GDALCreateCopy(driver, layer->cog_fname, layer->dataset_h, FALSE, options, NULL, NULL);
+  CSLDestroy(options);
+  GDALClose(layer->dataset_h);
+  layer->dataset_h = NULL;
+  if(dst==NULL) {
+    ezgdal_show_message(stderr,"GDAL: Problem with writing COG file!");
+    exit(EXIT_FAILURE);
+  }
+  GDALClose(dst);
+  GDALDeleteDataset(GDALGetDriverByName("GTiff"), tmp_fname);
+  CPLFree(tmp_fname);
 }
 
+/* a NaN no-data value matches NaN cells, so do masked cells 
+   of double rows of a masked layer */
 int  ezgdal_is_null(EZGDAL_LAYER *layer, double v) {
-  if((layer->is_no_data) && (v == layer->no_data))
+  if(v != v && ezgdal_is_masked(layer))
+    return TRUE;
+  if((layer->is_no_data) && (v == layer->no_data || (v != v && layer->no_data != layer->no_data)))
     return TRUE;
   return FALSE;
 }
@@ -362,12 +1318,81 @@ void  ezgdal_set_null(EZGDAL_LAYER *layer, double *v) {
     *v = layer->no_data;
 }
 
+/* keeps the validity of frameset frames, bitmasks of stripes are shared by frames */
+void  ezgdal_frame_copy_mapped(EZGDAL_LAYER *layer, EZGDAL_FRAME *frame);
+
+/*
+ * A frame with its own validity bitmask (frameset validity mode) gets
+ * the cell null in the bitmask only: the value is kept, the frame keeps 
+ * the cell type of the layer and a mapped frame is not copied. Other
+ * frames get the no-data value of the layer, if it has one.
+ */
+void  ezgdal_set_frame_null(EZGDAL_LAYER *layer, EZGDAL_FRAME *frame, int r, int c) {
+  EZGDAL_BITS *row;
+
+  if(frame->valid_base == &(frame->private_valid)) {
+    if(ezgdal_frame_is_valid(frame, r, c)) {
+      row = frame->private_valid + (long)r*frame->valid_stride;
+      row[c / EZGDAL_BITS_SIZE] &= ~((EZGDAL_BITS)1 << (c % EZGDAL_BITS_SIZE));
+      frame->nulls++;
+    }
+    return;
+  }
+  if(layer->is_no_data) {
+    ezgdal_frame_copy_mapped(layer, frame);
+    ezgdal_frame_set_value(frame, r, c, layer->no_data);
+  }
+}
+
 
 
 /*==========================================*/
 /*                 STATS                    */
 /*                                          */
 
+/* statistics of a window or of a band with a mask band, GDAL computes
+   them for the whole band without the mask */
+void  ezgdal_calc_window_stats(EZGDAL_LAYER *layer) {
+  double v, d, n = 0.0, mean = 0.0, m2 = 0.0;
+  double min = DBL_MAX, max = -DBL_MAX;
+  int r, c;
+
+  for(r=0; r<layer->rows; r++) {
+    ezgdal_read_buffer(layer, r);
+    for(c=0; c<layer->cols; c++) {
+      v = layer->buffer[c];
+      if(v!=v || ezgdal_is_null(layer,v)) continue;
+      if(v<min) min = v;
+      if(v>max) max = v;
+      n += 1.0;
+      d = v - mean;
+      mean += d/n;
+      m2 += d*(v - mean);
+    }
+  }
+  layer->stats->min = (n>0) ? min : 0.0;
+  layer->stats->max = (n>0) ? max : 0.0;
+  layer->stats->avg = mean;
+  layer->stats->std = (n>0) ? sqrt(m2/n) : 0.0;
+}
+
+/* histogram of a window, GDAL computes it for the whole band only */
+void  ezgdal_calc_window_histogram(EZGDAL_LAYER *layer, double min, double max, int N, GUIntBig *hist) {
+  double v;
+  int r, c, k;
+
+  memset(hist, 0, N*sizeof(GUIntBig));
+  for(r=0; r<layer->rows; r++) {
+    ezgdal_read_buffer(layer, r);
+    for(c=0; c<layer->cols; c++) {
+      v = layer->buffer[c];
+      if(v!=v || ezgdal_is_null(layer,v)) continue;
+      k = (int)floor((v-min)/(max-min)*N);
+      if(k>=0 && k<N) hist[k]++;
+    }
+  }
+}
+
 void  ezgdal_calc_layer_stats(EZGDAL_LAYER *layer) {
 
   if(layer == NULL) return;
@@ -383,6 +1408,15 @@ void  ezgdal_calc_layer_stats(EZGDAL_LAYER *layer) {
     layer->stats->hist_min = 0;
     layer->stats->hist_max = 0;
     layer->stats->hist_step = 0;
+    layer->stats->cat_value = NULL;
+    layer->stats->cat_key = NULL;
+    layer->stats->cat_slot = NULL;
+    layer->stats->cat_hash_mask = 0;
+  }
+
+  if(layer->is_window || layer->is_mask_band) {
+    ezgdal_calc_window_stats(layer);
+    return;
   }
 
   GDALComputeRasterStatistics(layer->band_h, FALSE,
@@ -393,6 +1427,18 @@ void  ezgdal_calc_layer_stats(EZGDAL_LAYER *layer) {
                               NULL,NULL);
 }
 
+void  ezgdal_free_value_map(EZGDAL_STATS *stats) {
+  free(stats->map_cat);
+  free(stats->cat_value);
+  free(stats->cat_key);
+  free(stats->cat_slot);
+  stats->map_cat = NULL;
+  stats->cat_value = NULL;
+  stats->cat_key = NULL;
+  stats->cat_slot = NULL;
+  stats->cat_hash_mask = 0;
+}
+
 void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N) {
 
 #ifdef OLD_GDAL
@@ -408,15 +1454,11 @@ void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N)
   if(min>=max || N<=0) return;
 
   if(layer->stats == NULL) {
-    layer->stats = (EZGDAL_STATS *)malloc(sizeof(EZGDAL_STATS));
+    layer->stats = (EZGDAL_STATS *)calloc(1,sizeof(EZGDAL_STATS));
 
     assert(layer->stats!=NULL);
-
-    layer->stats->min = 0;
-    layer->stats->max = 0;
-    layer->stats->avg = 0;
-    layer->stats->std = 0;
   }
+  ezgdal_free_value_map(layer->stats);
 
   layer->stats->hist_min = min;
   layer->stats->hist_max = max;
@@ -430,6 +1472,13 @@ void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N)
 #endif
 
 #ifdef OLD_GDAL
+  if(layer->is_window || layer->is_mask_band) {
+    GUIntBig *whist = (GUIntBig *) malloc(N * sizeof(GUIntBig));
+    ezgdal_calc_window_histogram(layer, min, max, N, whist);
+    for(i=0; i<N; i++) hist[i] = (int)whist[i];
+    free(whist);
+    res = CE_None;
+  } else
   res = GDALGetRasterHistogram(layer->band_h,
                            min,
                            max,
@@ -438,6 +1487,10 @@ void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N)
                            FALSE, FALSE,
                            NULL, NULL);
 #else
+  if(layer->is_window || layer->is_mask_band) {
+    ezgdal_calc_window_histogram(layer, min, max, N, hist);
+    res = CE_None;
+  } else
   res = GDALGetRasterHistogramEx(layer->band_h,
                            min,
                            max,
@@ -450,11 +1503,13 @@ void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N)
   assert(res==CE_None || res==CE_Debug);
 
   layer->stats->map_cat = (int *)malloc(N * sizeof(int));
+  layer->stats->cat_value = (double *)malloc(N * sizeof(double));
 
   for(i=0; i<N; i++)
-    if(hist[i]>0) 
+    if(hist[i]>0) {
+      layer->stats->cat_value[j] = (i + 0.5) / layer->stats->hist_step + layer->stats->hist_min;
       layer->stats->map_cat[i] = j++;
-    else
+    } else
       layer->stats->map_cat[i] = -1;
 
   layer->stats->map_max_val = j-1;
@@ -463,24 +1518,426 @@ void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N)
 }
 
 int  ezgdal_get_value_index(EZGDAL_LAYER *layer, double val) {
+  EZGDAL_STATS *s = layer->stats;
+  long long k;
+  long h;
+  int i;
 
-  if(val < layer->stats->hist_min || val > layer->stats->hist_max)
+  if(val < s->hist_min || val > s->hist_max)
     return -1;
 
-  return layer->stats->map_cat[(int)( (val - layer->stats->hist_min) * layer->stats->hist_step )];
+  if(s->map_cat != NULL) {
+    i = (int)( (val - s->hist_min) * s->hist_step );
+    return (i < s->hist_N) ? s->map_cat[i] : -1;
+  }
+
+  if(s->cat_slot == NULL)
+    return -1;
+
+  /* sparse map - unit bins, so the key is the nearest integer */
+  k = (long long)floor(val+0.5);
+  h = (long)(((unsigned long long)k * 0x9E3779B97F4A7C15ULL) >> 20) & s->cat_hash_mask;
+  while(s->cat_slot[h] >= 0) {
+    if(s->cat_key[h]==k) return s->cat_slot[h];
+    h = (h+1) & s->cat_hash_mask;
+  }
+  return -1;
 }
 
 double  ezgdal_get_index_value(EZGDAL_LAYER *layer, int idx) {
 
-  if(idx < 0 || idx >= layer->stats->hist_N)
+  if(idx < 0 || idx > layer->stats->map_max_val || layer->stats->cat_value == NULL)
     return -1;
-    
-  int i;
-  for(i=0; i<layer->stats->hist_N; i++)
-    if(layer->stats->map_cat[i]==idx)
-      return (i + 0.5) / layer->stats->hist_step + layer->stats->hist_min;
 
-  return -1;
+  return layer->stats->cat_value[idx];
+}
+
+/*
+ * Set of integer keys (values rounded to the nearest integer)
+ * collected by the category scan. Open addressing, the last key
+ * is remembered because categorical maps come in long runs.
+ */
+typedef struct {
+  long long *keys;
+  char *used;
+  long size;
+  long n;
+  long long last;
+  int has_last;
+} EZGDAL_KEY_SET;
+
+void  ezgdal_key_set_init(EZGDAL_KEY_SET *set) {
+  set->size = 1024;
+  set->n = 0;
+  set->has_last = FALSE;
+  set->keys = (long long *)malloc(set->size*sizeof(long long));
+  set->used = (char *)calloc(set->size,sizeof(char));
+  if(set->keys==NULL || set->used==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void  ezgdal_key_set_free(EZGDAL_KEY_SET *set) {
+  free(set->keys);
+  free(set->used);
+  set->keys = NULL;
+  set->used = NULL;
+  set->n = 0;
+}
+
+void  ezgdal_key_set_add(EZGDAL_KEY_SET *set, long long k);
+
+void  ezgdal_key_set_grow(EZGDAL_KEY_SET *set) {
+  long i, old_size = set->size;
+  long long *old_keys = set->keys;
+  char *old_used = set->used;
+
+  set->size *= 2;
+  set->n = 0;
+  set->has_last = FALSE;
+  set->keys = (long long *)malloc(set->size*sizeof(long long));
+  set->used = (char *)calloc(set->size,sizeof(char));
+  if(set->keys==NULL || set->used==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  for(i=0; i<old_size; i++)
+    if(old_used[i])
+      ezgdal_key_set_add(set, old_keys[i]);
+  free(old_keys);
+  free(old_used);
+}
+
+void  ezgdal_key_set_add(EZGDAL_KEY_SET *set, long long k) {
+  unsigned long long h;
+
+  if(set->has_last && set->last==k) return;
+  set->last = k;
+  set->has_last = TRUE;
+
+  h = ((unsigned long long)k * 0x9E3779B97F4A7C15ULL) >> 20;
+  h &= (unsigned long long)(set->size-1);
+  while(set->used[h]) {
+    if(set->keys[h]==k) return;
+    h = (h+1) & (unsigned long long)(set->size-1);
+  }
+  set->used[h] = 1;
+  set->keys[h] = k;
+  set->n++;
+  if(2*set->n > set->size)
+    ezgdal_key_set_grow(set);
+}
+
+int  ezgdal_compare_keys(const void *a, const void *b) {
+  long long x = *(const long long *)a;
+  long long y = *(const long long *)b;
+  return (x>y) - (x<y);
+}
+
+/*
+ * Value map with unit bins centered on sorted, unique integer keys.
+ * The direct table is used when the range is small or densely
+ * populated, otherwise the keys go to a hash table sized to twice
+ * the number of categories.
+ */
+void  ezgdal_value_map_from_keys(EZGDAL_LAYER *layer, long long *keys, long n) {
+  EZGDAL_STATS *s = layer->stats;
+  long i, h, size;
+  double range;
+  int N;
+
+  range = floor(fabs((s->max+0.5)-(s->min-0.5)));
+  N = (range < INT_MAX) ? (int)range : INT_MAX;
+  if(N<=0) N = 1;
+
+  s->hist_min = s->min - 0.5;
+  s->hist_max = s->max + 0.5;
+  s->hist_step = (double)N/(s->hist_max-s->hist_min);
+  s->hist_N = N;
+
+  ezgdal_free_value_map(s);
+  s->cat_value = (double *)malloc((n+1) * sizeof(double));
+  if(s->cat_value==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  for(i=0; i<n; i++)
+    s->cat_value[i] = (double)keys[i];
+
+  if(N <= EZGDAL_DENSE_MAP_MAX || (long)N <= EZGDAL_DENSE_MAP_RATIO*n) {
+    s->map_cat = (int *)malloc(N * sizeof(int));
+    if(s->map_cat==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    for(i=0; i<N; i++)
+      s->map_cat[i] = -1;
+    for(i=0; i<n; i++)
+      s->map_cat[keys[i]-(long long)s->min] = (int)i;
+  } else {
+    for(size=16; size<2*n; size*=2);
+    s->cat_hash_mask = size-1;
+    s->cat_key = (long long *)malloc(size * sizeof(long long));
+    s->cat_slot = (int *)malloc(size * sizeof(int));
+    if(s->cat_key==NULL || s->cat_slot==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    for(i=0; i<size; i++)
+      s->cat_slot[i] = -1;
+    for(i=0; i<n; i++) {
+      h = (long)(((unsigned long long)keys[i] * 0x9E3779B97F4A7C15ULL) >> 20) & s->cat_hash_mask;
+      while(s->cat_slot[h] >= 0)
+        h = (h+1) & s->cat_hash_mask;
+      s->cat_key[h] = keys[i];
+      s->cat_slot[h] = (int)i;
+    }
+  }
+
+  s->map_max_val = (int)n-1;
+}
+
+char*  ezgdal_stats_cache_name(EZGDAL_LAYER *layer) {
+  const char *fname = GDALGetDescription(layer->dataset_h);
+  char *name;
+
+  if(fname==NULL || fname[0]=='\0') return NULL;
+  name = (char *)malloc(strlen(fname)+16);
+  sprintf(name,"%s.gpat.stats",fname);
+  return name;
+}
+
+/*
+ * The sidecar file keeps statistics and categories of a layer.
+ * It is valid as long as size, modification time and no-data
+ * value of the source file are not changed.
+ */
+int  ezgdal_read_stats_cache(EZGDAL_LAYER *layer, int *is_map) {
+  VSIStatBufL st;
+  FILE *f;
+  char *name;
+  long long size, mtime, *keys;
+  long i, n;
+  int version, is_no_data, ok = FALSE;
+  double no_data;
+
+  *is_map = FALSE;
+  if(VSIStatL(GDALGetDescription(layer->dataset_h),&st)!=0) return FALSE;
+  name = ezgdal_stats_cache_name(layer);
+  if(name==NULL) return FALSE;
+  f = fopen(name,"r");
+  free(name);
+  if(f==NULL) return FALSE;
+
+  if(fscanf(f,"GPAT_STATS %d\n",&version)==1 && version==1 &&
+     fscanf(f,"size %lld\n",&size)==1 && size==(long long)st.st_size &&
+     fscanf(f,"mtime %lld\n",&mtime)==1 && mtime==(long long)st.st_mtime &&
+     fscanf(f,"nodata %d %lf\n",&is_no_data,&no_data)==2 &&
+     is_no_data==layer->is_no_data && (!is_no_data || no_data==layer->no_data) &&
+     fscanf(f,"stats %lf %lf %lf %lf\n",&(layer->stats->min),&(layer->stats->max),
+                                         &(layer->stats->avg),&(layer->stats->std))==4 &&
+     fscanf(f,"categories %ld\n",&n)==1) {
+    if(n<0) 
+      ok = TRUE;
+    else {
+      keys = (long long *)malloc((n+1)*sizeof(long long));
+      for(i=0; i<n; i++)
+        if(fscanf(f,"%lld",&(keys[i]))!=1) break;
+      if(i==n) {
+        ezgdal_value_map_from_keys(layer, keys, n);
+        *is_map = TRUE;
+        ok = TRUE;
+      }
+      free(keys);
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+void  ezgdal_write_stats_cache(EZGDAL_LAYER *layer, long long *keys, long n) {
+  VSIStatBufL st;
+  FILE *f;
+  char *name;
+  long i;
+
+  if(VSIStatL(GDALGetDescription(layer->dataset_h),&st)!=0) return;
+  name = ezgdal_stats_cache_name(layer);
+  if(name==NULL) return;
+  f = fopen(name,"w");
+  free(name);
+  /* no write access - no cache */
+  if(f==NULL) return;
+
+  fprintf(f,"GPAT_STATS 1\n");
+  fprintf(f,"size %lld\n",(long long)st.st_size);
+  fprintf(f,"mtime %lld\n",(long long)st.st_mtime);
+  fprintf(f,"nodata %d %.17g\n",layer->is_no_data,layer->is_no_data?layer->no_data:0.0);
+  fprintf(f,"stats %.17g %.17g %.17g %.17g\n",layer->stats->min,layer->stats->max,
+                                                layer->stats->avg,layer->stats->std);
+  fprintf(f,"categories %ld\n",(keys==NULL)?-1L:n);
+  if(keys!=NULL)
+    for(i=0; i<n; i++)
+      fprintf(f,"%lld\n",keys[i]);
+  fclose(f);
+}
+
+/*
+ * Statistics and value map in one pass. Equivalent to
+ * ezgdal_calc_layer_stats followed by ezgdal_calc_value_map with
+ * unit bins from min-0.5 to max+0.5. The raster is scanned in chunks
+ * aligned to its blocks, in parallel, each thread with its own 
+ * dataset handle. The result is cached in the '<file>.gpat.stats' 
+ * sidecar file.
+ */
+void  ezgdal_calc_layer_categories(EZGDAL_LAYER *layer) {
+  EZGDAL_KEY_SET all;
+  long long *keys = NULL;
+  long n_all = 0, i;
+  int chunk_rows, chunk_cols, nchunk_rows, nchunk_cols, nchunks;
+  int is_map;
+  double sum_n = 0.0, sum_mean = 0.0, sum_m2 = 0.0;
+  double min = DBL_MAX, max = -DBL_MAX;
+
+  if(layer == NULL) return;
+
+  if(layer->stats == NULL) {
+    layer->stats = (EZGDAL_STATS *)calloc(1,sizeof(EZGDAL_STATS));
+    assert(layer->stats!=NULL);
+  }
+
+  /* the cache describes the whole band */
+  if(!layer->is_window && ezgdal_read_stats_cache(layer, &is_map)) {
+    if(!is_map)
+      ezgdal_calc_value_map(layer,layer->stats->min-0.5,layer->stats->max+0.5,
+                            (int)floor(fabs((layer->stats->max+0.5)-(layer->stats->min-0.5))));
+    return;
+  }
+
+  chunk_cols = layer->block_cols;
+  if(chunk_cols<=0 || chunk_cols>layer->cols) chunk_cols = layer->cols;
+  chunk_cols *= (256/chunk_cols > 1) ? 256/chunk_cols : 1;
+  if(chunk_cols>layer->cols) chunk_cols = layer->cols;
+  chunk_rows = layer->block_rows;
+  if(chunk_rows<=0 || chunk_rows>layer->rows) chunk_rows = layer->rows;
+  if((long)chunk_rows*chunk_cols < (1L<<20))
+    chunk_rows *= (int)((1L<<20)/((long)chunk_rows*chunk_cols));
+  if(chunk_rows>layer->rows) chunk_rows = layer->rows;
+  nchunk_rows = (layer->rows+chunk_rows-1)/chunk_rows;
+  nchunk_cols = (layer->cols+chunk_cols-1)/chunk_cols;
+  nchunks = nchunk_rows*nchunk_cols;
+
+  ezgdal_key_set_init(&all);
+
+#pragma omp parallel
+  {
+    EZGDAL_KEY_SET set;
+    GDALDatasetH ds;
+    GDALRasterBandH band;
+    double *buf, v, d, t_n = 0.0, t_mean = 0.0, t_m2 = 0.0;
+    double t_min = DBL_MAX, t_max = -DBL_MAX;
+    long j, m;
+    int k, row, col, rows, cols;
+    CPLErr res;
+
+    ezgdal_key_set_init(&set);
+    buf = (double *)malloc((long)chunk_rows*chunk_cols*sizeof(double));
+    if(buf==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    /* a pool handle or a private one */
+    ds = NULL;
+    band = ezgdal_layer_band(layer);
+    if(band==NULL) {
+      ds = GDALOpen(GDALGetDescription(layer->dataset_h),GA_ReadOnly);
+      band = (ds!=NULL) ? GDALGetRasterBand(ds,1) : NULL;
+    }
+
+#pragma omp for schedule(dynamic)
+    for(k=0; k<nchunks; k++) {
+      row = (k/nchunk_cols)*chunk_rows;
+      col = (k%nchunk_cols)*chunk_cols;
+      rows = (row+chunk_rows>layer->rows) ? layer->rows-row : chunk_rows;
+      cols = (col+chunk_cols>layer->cols) ? layer->cols-col : chunk_cols;
+
+      if(band!=NULL)
+        res = GDALRasterIO(band, GF_Read, layer->win_col+col, layer->win_row+row, cols, rows,
+                           buf, cols, rows, GDT_Float64, 0, 0);
+      else {
+#pragma omp critical(ezgdal_layer_io)
+        res = GDALRasterIO(layer->band_h, GF_Read, layer->win_col+col, layer->win_row+row, cols, rows,
+                           buf, cols, rows, GDT_Float64, 0, 0);
+      }
+      if(res>CE_Warning) {
+        ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+        exit(EXIT_FAILURE);
+      }
+      ezgdal_apply_mask(layer, buf, EZGDAL_FLOAT64, NAN, col, row, cols, rows, (long)cols*sizeof(double));
+
+      m = (long)rows*cols;
+      for(j=0; j<m; j++) {
+        v = buf[j];
+        if(v!=v || ezgdal_is_null(layer,v)) continue;
+        if(v<t_min) t_min = v;
+        if(v>t_max) t_max = v;
+        t_n += 1.0;
+        d = v - t_mean;
+        t_mean += d/t_n;
+        t_m2 += d*(v - t_mean);
+        ezgdal_key_set_add(&set, (long long)floor(v+0.5));
+      }
+    }
+
+    if(ds!=NULL) GDALClose(ds);
+    free(buf);
+
+#pragma omp critical(ezgdal_layer_stats)
+    {
+      if(t_n>0) {
+        if(t_min<min) min = t_min;
+        if(t_max>max) max = t_max;
+        d = t_mean - sum_mean;
+        sum_m2 += t_m2 + d*d*sum_n*t_n/(sum_n+t_n);
+        sum_mean += d*t_n/(sum_n+t_n);
+        sum_n += t_n;
+      }
+      for(j=0; j<set.size; j++)
+        if(set.used[j])
+          ezgdal_key_set_add(&all, set.keys[j]);
+    }
+    ezgdal_key_set_free(&set);
+  }
+
+  if(sum_n>0) {
+    layer->stats->min = min;
+    layer->stats->max = max;
+    layer->stats->avg = sum_mean;
+    layer->stats->std = sqrt(sum_m2/sum_n);
+  } else {
+    layer->stats->min = 0.0;
+    layer->stats->max = 0.0;
+    layer->stats->avg = 0.0;
+    layer->stats->std = 0.0;
+  }
+
+  /* integer categories - the value map comes from the collected keys,
+     otherwise bins do not have unit width and the histogram is needed */
+  if(sum_n>0 && floor(min)==min && floor(max)==max) {
+    keys = (long long *)malloc((all.n+1)*sizeof(long long));
+    for(i=0; i<all.size; i++)
+      if(all.used[i])
+        keys[n_all++] = all.keys[i];
+    qsort(keys, n_all, sizeof(long long), ezgdal_compare_keys);
+    ezgdal_value_map_from_keys(layer, keys, n_all);
+  } else if(sum_n>0)
+    ezgdal_calc_value_map(layer,min-0.5,max+0.5,(int)floor(fabs((max+0.5)-(min-0.5))));
+
+  ezgdal_key_set_free(&all);
+  if(!layer->is_window)
+    ezgdal_write_stats_cache(layer, keys, n_all);
+  free(keys);
 }
 
 void  free_layer_stats(EZGDAL_LAYER *layer) {
@@ -488,8 +1945,7 @@ void  free_layer_stats(EZGDAL_LAYER *layer) {
   if(layer == NULL) return;
 
   if(layer->stats != NULL) {
-    if(layer->stats->map_cat != NULL)
-      free(layer->stats->map_cat);
+    ezgdal_free_value_map(layer->stats);
     free(layer->stats);
   }
 }
@@ -500,47 +1956,177 @@ void  free_layer_stats(EZGDAL_LAYER *layer) {
 /*             STRIPE & FRAME               */
 /*                                          */
 
+/* value of the cells outside the raster */
+double  ezgdal_stripe_null_value(EZGDAL_STRIPE *stripe) {
+  if(stripe->is_category) {
+    switch(stripe->data_type) {
+      case EZGDAL_UINT8:  return EZGDAL_NULL_CAT_UINT8;
+      case EZGDAL_UINT16: return EZGDAL_NULL_CAT_UINT16;
+      default:            return EZGDAL_NULL_CAT;
+    }
+  }
+  if(stripe->layer->is_no_data) 
+    return stripe->layer->no_data;
+  return 0.0;
+}
+
+/* slab of the rows rows of a ring */
+void*  ezgdal_stripe_data_alloc(EZGDAL_STRIPE *stripe) {
+  void *data;
+  long n = (long)stripe->rows * stripe->stride;
+
+  data = malloc(n * stripe->data_size);
+  if(data==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  ezgdal_fill_cells(data, stripe->data_type, n, ezgdal_stripe_null_value(stripe));
+  return data;
+}
+
+/* row r of the ring starting at the physical row head */
+char*  ezgdal_stripe_row(EZGDAL_STRIPE *stripe, void *data, int head, int r) {
+  return (char *)data + (long)((head + r) % stripe->rows) * stripe->stride * stripe->data_size;
+}
+
+/* the ring starts at the physical row head, frames follow its view and wrap row */
+void  ezgdal_set_stripe_head(EZGDAL_STRIPE *stripe, int head) {
+  stripe->head = head;
+  stripe->view = ezgdal_stripe_row(stripe, stripe->data, head, 0);
+  stripe->wrap_row = stripe->rows - head;
+}
+
 EZGDAL_STRIPE*  ezgdal_create_stripe(EZGDAL_LAYER *layer, int row1, int height) {
-  int r, c;
   EZGDAL_STRIPE *s;
-  double d = 0.0, *p;
 
   if(layer==NULL) return NULL;
 
   if(row1<-height || row1>layer->rows-height-1) return NULL;
 
-  if(layer->is_no_data) d = layer->no_data;
+  ezgdal_update_data_type(layer);
   s = malloc(sizeof(EZGDAL_STRIPE));
   s->layer = layer;
+  s->data_type = layer->data_type;
+  s->data_size = layer->data_size;
+  s->is_category = FALSE;
+  s->raw_type = layer->data_type;
   s->rows = height;
   s->row1 = INT_MIN;
   s->row2 = s->row1 + height - 1;
-  s->buffer = malloc((s->rows) * sizeof(double *));
-  for(r=0; r<s->rows; r++) {
-    s->buffer[r] = malloc((layer->cols + 2*height) * sizeof(double));
-    p = s->buffer[r];
-    for(c=0; c<layer->cols+2*height; c++)
-      *(p++) = d;
-  }
+  s->stride = layer->cols + 2*height;
+
+  s->data = ezgdal_stripe_data_alloc(s);
+  ezgdal_set_stripe_head(s, 0);
   s->frame = NULL;
   s->frames = 0;
+  s->map_view = NULL;
+  s->ring_col1 = 0;
+  s->ring_col2 = layer->cols-1;
+  s->is_validity = FALSE;
+  s->valid_row1 = INT_MIN;
+  s->valid_head = 0;
+  s->valid_wrap_row = height;
+  s->valid_words = 0;
+  s->valid = NULL;
+  s->valid_view = NULL;
+  s->col_nulls = NULL;
+  s->null_prefix = NULL;
+  s->is_prefetch = FALSE;
+  s->prefetch_row1 = INT_MIN;
+  s->prefetch_data = NULL;
+  s->prefetch_thread = NULL;
+  s->prefetch_dataset_h = NULL;
+  s->prefetch_band_h = NULL;
 
   layer->stripe = s;
+  /* null cells of a masked layer are known from the bitmask only */
+  if(ezgdal_is_masked(layer))
+    ezgdal_stripe_validity_mode(s);
 
   return s;
 }
 
-void  reset_frame_buffer_pointers(EZGDAL_STRIPE *stripe) {
-  int f,r;
+/* the stripe at row1 can be served from the layer's file mapping */
+int  ezgdal_stripe_is_mappable(EZGDAL_STRIPE *stripe, int row1) {
+  EZGDAL_LAYER *l = stripe->layer;
+
+  return l->map_data != NULL && !stripe->is_category &&
+         stripe->data_type == l->data_type &&
+         row1 >= 0 && row1 + stripe->rows <= l->rows;
+}
+
+/* frames reaching into the stripe's margins need the ring, 
+   the others can look into the mapping */
+void  ezgdal_set_frame_view(EZGDAL_STRIPE *stripe, EZGDAL_FRAME *frame) {
+  if(stripe->map_view != NULL &&
+     frame->col1 >= stripe->rows && frame->col2 < stripe->rows + stripe->layer->cols) {
+    frame->base = &(stripe->map_view);
+    frame->row_stride = stripe->layer->map_line;
+    frame->wrap_row = &(frame->rows);
+    frame->wrap_bytes = 0;
+  } else {
+    frame->base = &(stripe->view);
+    frame->row_stride = (long)stripe->stride * stripe->data_size;
+    frame->wrap_row = &(stripe->wrap_row);
+    frame->wrap_bytes = (long)stripe->rows * frame->row_stride;
+  }
+  frame->offset = (long)frame->col1 * stripe->data_size;
+}
+
+/* raster columns kept in the ring: all of them, or in the mapped 
+   mode only those seen by the frames looking through the ring */
+void  ezgdal_set_ring_cols(EZGDAL_STRIPE *stripe) {
+  int f, c1, c2;
+
+  stripe->ring_col1 = 0;
+  stripe->ring_col2 = stripe->layer->cols-1;
+  if(stripe->map_view == NULL) return;
+
+  c1 = stripe->layer->cols;
+  c2 = -1;
+  for(f=0; f<stripe->frames; f++) {
+    if(stripe->frame[f].base == &(stripe->map_view)) continue;
+    if(stripe->frame[f].col1-stripe->rows < c1) c1 = stripe->frame[f].col1-stripe->rows;
+    if(stripe->frame[f].col2-stripe->rows > c2) c2 = stripe->frame[f].col2-stripe->rows;
+  }
+  if(c1 > stripe->ring_col1) stripe->ring_col1 = c1;
+  if(c2 < stripe->ring_col2) stripe->ring_col2 = c2;
+}
+
+/* null count of a stripe frame from the column sums of the validity mode */
+void  ezgdal_set_frame_nulls(EZGDAL_STRIPE *stripe, EZGDAL_FRAME *frame) {
+  if(!stripe->is_validity) {
+    frame->valid_base = NULL;
+    frame->nulls = -1;
+    return;
+  }
+  frame->valid_base = &(stripe->valid_view);
+  frame->valid_bit = frame->col1;
+  frame->valid_stride = stripe->valid_words;
+  frame->valid_wrap_row = &(stripe->valid_wrap_row);
+  frame->valid_wrap_words = (long)stripe->rows * stripe->valid_words;
+  if(stripe->valid_row1 == INT_MIN || stripe->valid_row1 != stripe->row1)
+    frame->nulls = -1;
+  else
+    frame->nulls = stripe->null_prefix[frame->col2+1] - stripe->null_prefix[frame->col1];
+}
+
+/* frames look through the stripe's view pointers, so they have to be
+   reset only when created, moved or when the cell type changes */
+void  reset_frame_views(EZGDAL_STRIPE *stripe) {
+  int f;
 
   if(stripe->frame==NULL) return;
 
   for(f=0; f<stripe->frames; f++) {
     stripe->frame[f].row1 = stripe->row1;
     stripe->frame[f].row2 = stripe->row2;
-    for(r=0; r<stripe->rows; r++) 
-      stripe->frame[f].buffer[r] = stripe->buffer[r] + stripe->frame[f].col1;
+    stripe->frame[f].data_type = stripe->data_type;
+    stripe->frame[f].is_category = stripe->is_category;
+    ezgdal_set_frame_view(stripe, &(stripe->frame[f]));
+    ezgdal_set_frame_nulls(stripe, &(stripe->frame[f]));
   }
+  ezgdal_set_ring_cols(stripe);
 }
 
 EZGDAL_FRAME*  ezgdal_create_frame(EZGDAL_STRIPE *stripe, int col1) {
@@ -558,10 +2144,9 @@ EZGDAL_FRAME*  ezgdal_create_frame(EZGDAL_STRIPE *stripe, int col1) {
   f->row2 = stripe->row2;
   f->col1 = col1+stripe->rows;
   f->col2 = f->col1 + f->cols - 1;
-  f->buffer = malloc(stripe->rows * sizeof(double *));
   stripe->frame = f;
   stripe->frames = 1;
-  reset_frame_buffer_pointers(stripe);
+  reset_frame_views(stripe);
   return f;
 }
 
@@ -588,10 +2173,9 @@ int  ezgdal_create_all_frames(EZGDAL_STRIPE *stripe, int start, int shift) {
     stripe->frame[r].row2 = stripe->row2;
     stripe->frame[r].col1 = start + stripe->rows;
     stripe->frame[r].col2 = stripe->frame[r].col1 + stripe->rows - 1;
-    stripe->frame[r].buffer = malloc(stripe->rows * sizeof(double *));
     start += shift;
   }
-  reset_frame_buffer_pointers(stripe);
+  reset_frame_views(stripe);
   return N;
 }
 
@@ -603,26 +2187,41 @@ void  ezgdal_shift_frame_pos(EZGDAL_FRAME *frame, int col) {
 
   frame->col1 = col + frame->cols;
   frame->col2 = frame->col1 + frame->cols - 1;
-  reset_frame_buffer_pointers(frame->owner.stripe);
+  frame->offset = (long)frame->col1 * frame->owner.stripe->data_size;
+  ezgdal_set_frame_nulls(frame->owner.stripe, frame);
+  if(frame->owner.stripe->map_view != NULL) {
+    /* the ring may not keep the new columns, the next load reads them */
+    reset_frame_views(frame->owner.stripe);
+    frame->owner.stripe->row1 = INT_MIN;
+  }
 }
 
 void  ezgdal_free_all_frames(EZGDAL_STRIPE *stripe) {
-  int f;
   if(stripe->frame!=NULL) {
-    for(f=0; f<stripe->frames; f++)
-      free(stripe->frame[f].buffer);
     free(stripe->frame);
     stripe->frame = NULL;
     stripe->frames = 0;
   }
 }
 
+void  ezgdal_wait_for_prefetch(EZGDAL_STRIPE *stripe) {
+  if(stripe->prefetch_thread!=NULL) {
+    CPLJoinThread((CPLJoinableThread *)stripe->prefetch_thread);
+    stripe->prefetch_thread = NULL;
+  }
+}
+
 void  ezgdal_free_stripe(EZGDAL_LAYER *layer) {
-  int r;
   ezgdal_free_all_frames(layer->stripe);
-  for(r=0; r<layer->stripe->rows; r++)
-    free(layer->stripe->buffer[r]);
-  free(layer->stripe->buffer);
+  if(layer->stripe->is_prefetch) {
+    ezgdal_wait_for_prefetch(layer->stripe);
+    GDALClose(layer->stripe->prefetch_dataset_h);
+    free(layer->stripe->prefetch_data);
+  }
+  free(layer->stripe->valid);
+  free(layer->stripe->col_nulls);
+  free(layer->stripe->null_prefix);
+  free(layer->stripe->data);
   free(layer->stripe);
   layer->stripe = NULL;
 }
@@ -632,9 +2231,325 @@ EZGDAL_FRAME*  ezgdal_get_frame(EZGDAL_STRIPE *stripe, int idx) {
   return &(stripe->frame[idx]);
 }
 
+void  ezgdal_translate_categories(EZGDAL_STRIPE *stripe, void *src, void *dst, long n) {
+  EZGDAL_LAYER *l = stripe->layer;
+  long i;
+  int idx;
+  double v;
+
+  for(i=0; i<n; i++) {
+    switch(stripe->raw_type) {
+      case EZGDAL_UINT8:   v = ((unsigned char *)src)[i]; break;
+      case EZGDAL_UINT16:  v = ((unsigned short *)src)[i]; break;
+      case EZGDAL_INT16:   v = ((short *)src)[i]; break;
+      case EZGDAL_INT32:   v = ((int *)src)[i]; break;
+      case EZGDAL_FLOAT32: v = ((float *)src)[i]; break;
+      default:             v = ((double *)src)[i]; break;
+    }
+    idx = ezgdal_is_null(l, v) ? EZGDAL_NULL_CAT : ezgdal_get_value_index(l, v);
+    switch(stripe->data_type) {
+      case EZGDAL_UINT8:
+        ((unsigned char *)dst)[i] = (idx<0) ? EZGDAL_NULL_CAT_UINT8 : idx;
+        break;
+      case EZGDAL_UINT16:
+        ((unsigned short *)dst)[i] = (idx<0) ? EZGDAL_NULL_CAT_UINT16 : idx;
+        break;
+      default:
+        ((int *)dst)[i] = (idx<0) ? EZGDAL_NULL_CAT : idx;
+        break;
+    }
+  }
+}
+
+/* 
+ * Reads n raster rows from row, columns col .. col+cols-1, into
+ * n consecutive physical rows of a stripe slab starting at dst. 
+ * The rows lie in one block row or all outside the raster.
+ */
+void  ezgdal_read_stripe_run(EZGDAL_STRIPE *stripe, GDALRasterBandH band_h, char *dst,
+                             int n, int col, int cols, int row) {
+  EZGDAL_LAYER *l = stripe->layer;
+  int k;
+  long off = (long)(stripe->rows + col) * stripe->data_size;
+  long step = (long)stripe->stride * stripe->data_size;
+  long raw_step = (long)cols * ezgdal_data_type_size(stripe->raw_type);
+  char *raw;
+  CPLErr res;
+
+  if(row<0 || row>=l->rows) {
+    for(k=0; k<n; k++)
+      ezgdal_fill_cells(dst + k*step + off, stripe->data_type, cols, 
+                        ezgdal_stripe_null_value(stripe));
+    return;
+  }
+
+  if(stripe->is_category) {
+    /* raw rows go through a scratch buffer and are translated once */
+    raw = (char *)malloc(n * raw_step);
+    if(raw==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    res = GDALRasterIO(band_h, GF_Read, l->win_col+col, l->win_row+row, cols, n,
+                       raw, cols, n,
+                       ezgdal_gdal_data_type(stripe->raw_type),
+                       0, raw_step);
+    if(res<=CE_Warning)
+      for(k=0; k<n; k++)
+        ezgdal_translate_categories(stripe, raw + k*raw_step, 
+                                    dst + k*step + off, cols);
+    free(raw);
+  } else
+    res = GDALRasterIO(band_h, GF_Read, l->win_col+col, l->win_row+row, cols, n,
+                       dst + off, cols, n,
+                       ezgdal_gdal_data_type(stripe->data_type),
+                       0, step);
+
+  if(res>CE_Warning) {
+    ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+    exit(EXIT_FAILURE);
+  }
+  /* category indices have a null, values keep the mask in the validity ring */
+  if(stripe->is_category)
+    ezgdal_apply_mask(l, dst + off, stripe->data_type, ezgdal_stripe_null_value(stripe),
+                      col, row, cols, n, step);
+}
+
+/* 
+ * Reads raster rows row0+r1 .. row0+r2 into rows r1 .. r2 of the ring
+ * starting at the physical row head of a stripe slab, using the given
+ * band handle.
+ * Rows are read in runs aligned to the band's natural blocks: every
+ * run covers rows of one block row only, so each run costs one 
+ * GDALRasterIO call and each block is decompressed once per stripe load.
+ * Runs are also split where the ring wraps to the start of the slab.
+ * If the layer has a handle pool, runs are also split into block aligned
+ * column parts and read by the pool's threads.
+ */
+void  ezgdal_read_stripe_rows(EZGDAL_STRIPE *stripe, GDALRasterBandH band_h, void *data, int head,
+                              int r1, int r2, int row0) {
+  EZGDAL_LAYER *l = stripe->layer;
+  int *run_r, *run_n;
+  int r, n, k, row, last, runs, parts, part_cols, is_parallel;
+  int wrap = stripe->rows - head;
+  int col1 = stripe->ring_col1, cols = stripe->ring_col2 - stripe->ring_col1 + 1;
+
+  if(r1>r2 || stripe->ring_col1>stripe->ring_col2) return;
+
+  run_r = (int *)malloc((r2-r1+1)*sizeof(int));
+  run_n = (int *)malloc((r2-r1+1)*sizeof(int));
+  if(run_r==NULL || run_n==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+
+  runs = 0;
+  r = r1;
+  while(r<=r2) {
+    row = row0 + r;
+    n = 1;
+    if(row<0 || row>=l->rows) {
+      while(r+n<=r2 && r+n!=wrap && (row+n<0 || row+n>=l->rows) && (row<0)==(row+n<0))
+        n++;
+    } else {
+      last = ((l->win_row+row)/l->block_rows + 1)*l->block_rows - 1 - l->win_row;
+      if(last>=l->rows) last = l->rows-1;
+      while(r+n<=r2 && r+n!=wrap && row+n<=last)
+        n++;
+    }
+    run_r[runs] = r;
+    run_n[runs] = n;
+    runs++;
+    r += n;
+  }
+
+  is_parallel = (band_h==l->band_h && l->handles>1);
+#ifdef _OPENMP
+  if(omp_in_parallel()) is_parallel = FALSE;
+#endif
+
+  if(!is_parallel) {
+    for(k=0; k<runs; k++)
+      ezgdal_read_stripe_run(stripe, band_h, ezgdal_stripe_row(stripe, data, head, run_r[k]),
+                             run_n[k], col1, cols, row0+run_r[k]);
+  } else {
+    part_cols = (l->block_cols>0 && l->block_cols<cols) ? l->block_cols : cols;
+    n = (cols + part_cols - 1)/part_cols;
+    part_cols *= (n + l->handles - 1)/l->handles;
+    parts = (cols + part_cols - 1)/part_cols;
+
+#pragma omp parallel for schedule(dynamic) num_threads(l->handles)
+    for(k=0; k<runs*parts; k++) {
+      int col = (k%parts)*part_cols;
+      int n_cols = (col+part_cols>cols) ? cols-col : part_cols;
+      ezgdal_read_stripe_run(stripe, ezgdal_layer_band(l), 
+                             ezgdal_stripe_row(stripe, data, head, run_r[k/parts]),
+                             run_n[k/parts], col1+col, n_cols, row0+run_r[k/parts]);
+    }
+  }
+
+  free(run_r);
+  free(run_n);
+}
+
+/* adds the cells k1 .. k2 of a stripe row to its validity row and column null counts */
+void  ezgdal_valid_cells(EZGDAL_STRIPE *stripe, const char *cells, long k1, long k2, EZGDAL_BITS *bits) {
+  EZGDAL_LAYER *l = stripe->layer;
+  long k;
+  double v;
+  int is_null;
+
+  for(k=k1; k<=k2; k++) {
+    const char *p = cells + k*stripe->data_size;
+    if(stripe->is_category) {
+      switch(stripe->data_type) {
+        case EZGDAL_UINT8:  is_null = (*(unsigned char *)p == EZGDAL_NULL_CAT_UINT8); break;
+        case EZGDAL_UINT16: is_null = (*(unsigned short *)p == EZGDAL_NULL_CAT_UINT16); break;
+        default:            is_null = (*(int *)p < 0); break;
+      }
+    } else {
+      switch(stripe->data_type) {
+        case EZGDAL_UINT8:   v = *(unsigned char *)p; break;
+        case EZGDAL_UINT16:  v = *(unsigned short *)p; break;
+        case EZGDAL_INT16:   v = *(short *)p; break;
+        case EZGDAL_INT32:   v = *(int *)p; break;
+        case EZGDAL_FLOAT32: v = *(float *)p; break;
+        default:             v = *(double *)p; break;
+      }
+      is_null = (v!=v || ezgdal_is_null(l, v));
+    }
+    if(is_null)
+      stripe->col_nulls[k]++;
+    else
+      bits[k / EZGDAL_BITS_SIZE] |= (EZGDAL_BITS)1 << (k % EZGDAL_BITS_SIZE);
+  }
+}
+
+/* validity row r of the ring */
+EZGDAL_BITS*  ezgdal_valid_row(EZGDAL_STRIPE *stripe, int r) {
+  return stripe->valid + (long)((stripe->valid_head + r) % stripe->rows) * stripe->valid_words;
+}
+
+/* removes the null cells of the validity row r from the column counts */
+void  ezgdal_forget_valid_row(EZGDAL_STRIPE *stripe, int r) {
+  EZGDAL_BITS *bits = ezgdal_valid_row(stripe, r);
+  EZGDAL_BITS w;
+  long i, k;
+
+  for(i=0; i<stripe->valid_words; i++) {
+    w = ~bits[i];
+    while(w != 0) {
+      k = i*EZGDAL_BITS_SIZE;
+#ifdef __GNUC__
+      k += __builtin_ctzll(w);
+#else
+      { EZGDAL_BITS x = w; while(!(x & 1)) { x >>= 1; k++; } }
+#endif
+      if(k >= stripe->stride) break;
+      stripe->col_nulls[k]--;
+      w &= w - 1;
+    }
+  }
+}
+
+/* 
+ * Clears the validity bits of cells out of the mask (flags of the raster
+ * columns, NULL for a row out of the raster) and of the margins:
+ * values of a masked layer do not tell its null cells.
+ */
+void  ezgdal_mask_valid_cells(EZGDAL_STRIPE *stripe, const unsigned char *flags, EZGDAL_BITS *bits) {
+  long k, m1 = stripe->rows, m2 = stripe->rows + stripe->layer->cols - 1;
+  EZGDAL_BITS b;
+
+  for(k=0; k<stripe->stride; k++) {
+    if(flags != NULL && k >= m1 && k <= m2 && flags[k-m1]) continue;
+    b = (EZGDAL_BITS)1 << (k % EZGDAL_BITS_SIZE);
+    if(bits[k / EZGDAL_BITS_SIZE] & b) {
+      bits[k / EZGDAL_BITS_SIZE] &= ~b;
+      stripe->col_nulls[k]++;
+    }
+  }
+}
+
+/* builds the validity row r from the cells of the current view 
+   and the mask flags of the row */
+void  ezgdal_build_valid_row(EZGDAL_STRIPE *stripe, int r, const unsigned char *flags) {
+  EZGDAL_BITS *bits = ezgdal_valid_row(stripe, r);
+  const char *cells = ezgdal_stripe_row(stripe, stripe->data, stripe->head, r);
+  long m1 = stripe->rows, m2 = stripe->rows + stripe->layer->cols - 1;
+
+  memset(bits, 0, stripe->valid_words*sizeof(EZGDAL_BITS));
+  if(stripe->map_view == NULL)
+    ezgdal_valid_cells(stripe, cells, 0, stripe->stride-1, bits);
+  else {
+    /* raster columns are in the mapping, margins in the ring */
+    ezgdal_valid_cells(stripe, cells, 0, m1-1, bits);
+    ezgdal_valid_cells(stripe, (char *)stripe->map_view + (long)r*stripe->layer->map_line, m1, m2, bits);
+    ezgdal_valid_cells(stripe, cells, m2+1, stripe->stride-1, bits);
+  }
+  if(!stripe->is_category && ezgdal_is_masked(stripe->layer))
+    ezgdal_mask_valid_cells(stripe, flags, bits);
+}
+
+/* 
+ * Brings the validity ring to the rows of the stripe. Only rows 
+ * that entered the stripe since the last update are scanned.
+ */
+void  ezgdal_update_validity(EZGDAL_STRIPE *stripe) {
+  EZGDAL_LAYER *l = stripe->layer;
+  unsigned char *flags = NULL;
+  int r, r1, r2, d, f, fr1, fr2;
+  long k;
+
+  if(!stripe->is_validity || stripe->valid_row1 == stripe->row1) return;
+
+  if(stripe->valid_row1 == INT_MIN || stripe->row1 == INT_MIN ||
+     stripe->row1 <= stripe->valid_row1 - stripe->rows ||
+     stripe->row1 >= stripe->valid_row1 + stripe->rows) {
+    memset(stripe->col_nulls, 0, stripe->stride*sizeof(long));
+    r1 = 0;
+    r2 = stripe->rows-1;
+  } else if(stripe->row1 > stripe->valid_row1) {
+    /* top rows leave, bottom rows enter */
+    d = stripe->row1 - stripe->valid_row1;
+    for(r=0; r<d; r++)
+      ezgdal_forget_valid_row(stripe, r);
+    stripe->valid_head = (stripe->valid_head + d) % stripe->rows;
+    r1 = stripe->rows - d;
+    r2 = stripe->rows - 1;
+  } else {
+    d = stripe->valid_row1 - stripe->row1;
+    for(r=stripe->rows-d; r<stripe->rows; r++)
+      ezgdal_forget_valid_row(stripe, r);
+    stripe->valid_head = (stripe->valid_head + stripe->rows - d) % stripe->rows;
+    r1 = 0;
+    r2 = d - 1;
+  }
+  stripe->valid_view = ezgdal_valid_row(stripe, 0);
+  stripe->valid_wrap_row = stripe->rows - stripe->valid_head;
+
+  /* the mask of the entering rows lying in the raster, read at once */
+  fr1 = (stripe->row1 + r1 < 0) ? -stripe->row1 : r1;
+  fr2 = (stripe->row1 + r2 >= l->rows) ? l->rows - 1 - stripe->row1 : r2;
+  if(!stripe->is_category)
+    flags = ezgdal_read_mask_flags(l, 0, stripe->row1 + fr1, l->cols, fr2 - fr1 + 1);
+
+  for(r=r1; r<=r2; r++)
+    ezgdal_build_valid_row(stripe, r, (flags != NULL && r >= fr1 && r <= fr2) ? 
+                                      flags + (long)(r - fr1)*l->cols : NULL);
+  free(flags);
+  stripe->valid_row1 = stripe->row1;
+
+  stripe->null_prefix[0] = 0;
+  for(k=0; k<stripe->stride; k++)
+    stripe->null_prefix[k+1] = stripe->null_prefix[k] + stripe->col_nulls[k];
+  for(f=0; f<stripe->frames; f++)
+    ezgdal_set_frame_nulls(stripe, &(stripe->frame[f]));
+}
+
 int  ezgdal_load_stripe_data(EZGDAL_STRIPE *stripe, int row1) {
-  int r, n, f;
-  double *p;
+  int n, f, mapped;
+  void *p;
 
   if(stripe == NULL) return 0;
   /* nothing to do */
@@ -643,58 +2558,59 @@ int  ezgdal_load_stripe_data(EZGDAL_STRIPE *stripe, int row1) {
   /* out of range */
   if(row1<-stripe->rows || row1>stripe->layer->rows-1) return 0;
 
-/*
-    p=stripe->layer->buffer;
-    for(r=0; r<stripe->rows; r++) {
-      stripe->layer->buffer = stripe->buffer[r] + stripe->rows;
-      ezgdal_read_buffer(stripe->layer, r + row1);
+  /* switching between the mapped and the copied views,
+     the ring gets other columns and is read again */
+  mapped = ezgdal_stripe_is_mappable(stripe, row1);
+  if(mapped != (stripe->map_view != NULL)) {
+    ezgdal_wait_for_prefetch(stripe);
+    stripe->prefetch_row1 = INT_MIN;
+    stripe->map_view = mapped ? stripe->layer->map_data : NULL;
+    reset_frame_views(stripe);
+    stripe->row1 = INT_MIN;
+  }
+  if(mapped)
+    stripe->map_view = (char *)stripe->layer->map_data + (long)row1 * stripe->layer->map_line - 
+                       (long)stripe->rows * stripe->data_size;
+
+  /* take the stripe read in the background */
+  if(stripe->prefetch_thread!=NULL) {
+    ezgdal_wait_for_prefetch(stripe);
+    if(stripe->prefetch_row1 == row1) {
+      p = stripe->data;
+      stripe->data = stripe->prefetch_data;
+      stripe->prefetch_data = p;
+      ezgdal_set_stripe_head(stripe, 0);
+      stripe->row1 = row1;
+      stripe->row2 = row1 + stripe->rows - 1;
+      for(f=0; f<stripe->frames; f++) {
+        stripe->frame[f].row1 = stripe->row1;
+        stripe->frame[f].row2 = stripe->row2;
+      }
+      ezgdal_update_validity(stripe);
+      return stripe->rows;
     }
-    stripe->layer->buffer = p;
-    n = stripe->rows;
-return n;
-*/
+  }
 
-  if(row1 < stripe->row1 - stripe->rows ||
+  if(stripe->row1 == INT_MIN ||
+     row1 < stripe->row1 - stripe->rows ||
      row1 > stripe->row2) {
     /* read all rows */
-    p=stripe->layer->buffer;
-    for(r=0; r<stripe->rows; r++) {
-      stripe->layer->buffer = stripe->buffer[r] + stripe->rows;
-      ezgdal_read_buffer(stripe->layer,r + row1);
-    }
-    stripe->layer->buffer = p;
+    ezgdal_read_stripe_rows(stripe, stripe->layer->band_h, stripe->data, stripe->head,
+                            0, stripe->rows-1, row1);
     n = stripe->rows;
   } else if(row1 > stripe->row1) {
-    /* shift up and read only bottom */
-    n = stripe->row2 -row1 + 1;
-    for(r=0; r<n; r++) {
-      p = stripe->buffer[r];
-      stripe->buffer[r] = stripe->buffer[stripe->rows - n + r];
-      stripe->buffer[stripe->rows - n + r] = p;
-    }
-    p=stripe->layer->buffer;
-    for(r=n; r<stripe->rows; r++) {
-      stripe->layer->buffer = stripe->buffer[r] + stripe->rows;
-      ezgdal_read_buffer(stripe->layer,r + row1);
-    }
-    stripe->layer->buffer = p;
-    reset_frame_buffer_pointers(stripe);
+    /* advance the ring and read only bottom */
+    n = stripe->row2 - row1 + 1;
+    ezgdal_set_stripe_head(stripe, (stripe->head + stripe->rows - n) % stripe->rows);
+    ezgdal_read_stripe_rows(stripe, stripe->layer->band_h, stripe->data, stripe->head,
+                            n, stripe->rows-1, row1);
     n = stripe->rows-n;
   } else {
-    /* shift down and read only top */
-    n = row1 - stripe->row1 + 1;
-    for(r=0; r<n; r++) {
-      p = stripe->buffer[stripe->rows - n + r];
-      stripe->buffer[stripe->rows - n + r] = stripe->buffer[r];
-      stripe->buffer[r] = p;
-    }
-    p=stripe->layer->buffer;
-    for(r=0; r<n; r++) {
-      stripe->layer->buffer = stripe->buffer[r] + stripe->rows;
-      ezgdal_read_buffer(stripe->layer,r + row1);
-    }
-    stripe->layer->buffer = p;
-    reset_frame_buffer_pointers(stripe);
+    /* move the ring back and read only top */
+    n = stripe->row1 - row1;
+    ezgdal_set_stripe_head(stripe, (stripe->head + stripe->rows - n) % stripe->rows);
+    ezgdal_read_stripe_rows(stripe, stripe->layer->band_h, stripe->data, stripe->head,
+                            0, n-1, row1);
   }
   stripe->row1 = row1;
   stripe->row2 = row1 + stripe->rows - 1;
@@ -703,28 +2619,183 @@ return n;
     stripe->frame[f].row1 = stripe->row1;
     stripe->frame[f].row2 = stripe->row2;
   }
+  ezgdal_update_validity(stripe);
 
   return n;
 }
 
-int  ezgdal_save_stripe_data(EZGDAL_STRIPE *stripe) {
-  int row1, N;
-  double *p;
+void  ezgdal_prefetch_thread(void *arg) {
+  EZGDAL_STRIPE *stripe = (EZGDAL_STRIPE *)arg;
+  int r, lo, hi;
+  int row1 = stripe->prefetch_row1;
+  int row2 = row1 + stripe->rows - 1;
+
+  /* rows shared with the current stripe are copied, 
+     the current stripe is not modified until the thread is joined */
+  lo = (row1 > stripe->row1) ? row1 : stripe->row1;
+  hi = (row2 < stripe->row2) ? row2 : stripe->row2;
+  if(lo>hi) {
+    ezgdal_read_stripe_rows(stripe, stripe->prefetch_band_h, stripe->prefetch_data, 0,
+                            0, stripe->rows-1, row1);
+    return;
+  }
+
+  /* the prefetched ring starts at the physical row 0 */
+  for(r=lo; r<=hi; r++)
+    memcpy(ezgdal_stripe_row(stripe, stripe->prefetch_data, 0, r-row1),
+           ezgdal_stripe_row(stripe, stripe->data, stripe->head, r-stripe->row1),
+           (long)stripe->stride * stripe->data_size);
+  if(lo>row1)
+    ezgdal_read_stripe_rows(stripe, stripe->prefetch_band_h, stripe->prefetch_data, 0,
+                            0, lo-row1-1, row1);
+  if(hi<row2)
+    ezgdal_read_stripe_rows(stripe, stripe->prefetch_band_h, stripe->prefetch_data, 0,
+                            hi-row1+1, stripe->rows-1, row1);
+}
+
+/*
+ * Switches the stripe to the prefetch mode. A second slab
+ * and a private dataset handle are allocated, so that the next
+ * stripe can be read while the current one is processed.
+ */
+int  ezgdal_stripe_prefetch_mode(EZGDAL_STRIPE *stripe) {
+  EZGDAL_LAYER *l;
+
+  if(stripe == NULL) return FALSE;
+  if(stripe->is_prefetch) return TRUE;
+
+  l = stripe->layer;
+  stripe->prefetch_dataset_h = GDALOpen(GDALGetDescription(l->dataset_h),GA_ReadOnly);
+  if(stripe->prefetch_dataset_h==NULL)
+    return FALSE;
+  stripe->prefetch_band_h = GDALGetRasterBand(stripe->prefetch_dataset_h,1);
+
+  stripe->prefetch_data = ezgdal_stripe_data_alloc(stripe);
+
+  stripe->is_prefetch = TRUE;
+  return TRUE;
+}
+
+/*
+ * Starts reading the stripe at row1 in the background. The data
+ * are taken by the next call of ezgdal_load_stripe_data with
+ * the same row1.
+ */
+int  ezgdal_prefetch_stripe_data(EZGDAL_STRIPE *stripe, int row1) {
 
-  if(stripe->row1<0) 
-    row1 = 0;
+  if(stripe == NULL || !stripe->is_prefetch) return 0;
+  if(row1<-stripe->rows || row1>stripe->layer->rows-1) return 0;
+  /* the ring would be read for other columns */
+  if(ezgdal_stripe_is_mappable(stripe, row1) != (stripe->map_view != NULL)) return 0;
+
+  ezgdal_wait_for_prefetch(stripe);
+  stripe->prefetch_row1 = row1;
+  stripe->prefetch_thread = CPLCreateJoinableThread(ezgdal_prefetch_thread, stripe);
+  if(stripe->prefetch_thread==NULL) {
+    stripe->prefetch_row1 = INT_MIN;
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Switches the stripe to the category mode. Raw values are translated
+ * to category indices (0..map_max_val, EZGDAL_NULL_CAT for nulls) 
+ * once, when rows are loaded, and frames expose the indices 
+ * to ezgdal_frame_get_cat. Layer statistics and the value map 
+ * have to be calculated before. The stripe is reloaded by 
+ * the next ezgdal_load_stripe_data call.
+ */
+int  ezgdal_stripe_category_mode(EZGDAL_STRIPE *stripe) {
+  int K;
+
+  if(stripe == NULL) return FALSE;
+  if(stripe->is_category) return TRUE;
+  if(stripe->layer->stats==NULL || stripe->layer->stats->cat_value==NULL) return FALSE;
+
+  ezgdal_wait_for_prefetch(stripe);
+
+  K = stripe->layer->stats->map_max_val + 1;
+  stripe->raw_type = stripe->data_type;
+  if(K < EZGDAL_NULL_CAT_UINT8)
+    stripe->data_type = EZGDAL_UINT8;
+  else if(K < EZGDAL_NULL_CAT_UINT16)
+    stripe->data_type = EZGDAL_UINT16;
   else
-    row1 = stripe->row1;
+    stripe->data_type = EZGDAL_INT32;
+  stripe->data_size = ezgdal_data_type_size(stripe->data_type);
+  stripe->is_category = TRUE;
+
+  free(stripe->data);
+  stripe->data = ezgdal_stripe_data_alloc(stripe);
+  ezgdal_set_stripe_head(stripe, 0);
+  if(stripe->is_prefetch) {
+    free(stripe->prefetch_data);
+    stripe->prefetch_data = ezgdal_stripe_data_alloc(stripe);
+  }
+  stripe->prefetch_row1 = INT_MIN;
+
+  stripe->row1 = INT_MIN;
+  stripe->row2 = stripe->row1 + stripe->rows - 1;
+  stripe->map_view = NULL;
+  stripe->valid_row1 = INT_MIN;
+  reset_frame_views(stripe);
+
+  return TRUE;
+}
+
+/*
+ * Switches the stripe to the validity mode: loads keep a bitmask 
+ * of not null cells, scanning only the rows that entered the stripe,
+ * and frames know their numbers of null cells 
+ * (ezgdal_frame_nulls, ezgdal_frame_is_valid, ezgdal_frame_next_valid).
+ */
+int  ezgdal_stripe_validity_mode(EZGDAL_STRIPE *stripe) {
+
+  if(stripe == NULL) return FALSE;
+  if(stripe->is_validity) return TRUE;
+
+  stripe->valid_words = EZGDAL_BITS_WORDS(stripe->stride);
+  stripe->valid = (EZGDAL_BITS *)calloc((long)stripe->rows*stripe->valid_words, sizeof(EZGDAL_BITS));
+  stripe->col_nulls = (long *)calloc(stripe->stride, sizeof(long));
+  stripe->null_prefix = (long *)calloc(stripe->stride+1, sizeof(long));
+  if(stripe->valid==NULL || stripe->col_nulls==NULL || stripe->null_prefix==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
+  stripe->valid_head = 0;
+  stripe->valid_view = stripe->valid;
+  stripe->valid_wrap_row = stripe->rows;
+  stripe->valid_row1 = INT_MIN;
+  stripe->is_validity = TRUE;
+
+  reset_frame_views(stripe);
+  if(stripe->row1 != INT_MIN)
+    ezgdal_update_validity(stripe);
+  return TRUE;
+}
+
+int  ezgdal_save_stripe_data(EZGDAL_STRIPE *stripe) {
+  EZGDAL_LAYER *l = stripe->layer;
+  int r, N;
+  CPLErr res;
+
+  /* category indices are not raster values, mapped rows are read-only */
+  if(stripe->is_category || stripe->map_view != NULL) return 0;
 
-  p=stripe->layer->buffer;
   N = 0;
-  while(row1<=stripe->row2) {
-    stripe->layer->buffer = stripe->buffer[row1] + stripe->rows;
-    ezgdal_write_buffer(stripe->layer,row1);
-    row1++;
+  for(r=0; r<stripe->rows; r++) {
+    if(stripe->row1+r<0 || stripe->row1+r>=l->rows) continue;
+    res = GDALRasterIO(l->band_h, GF_Write, l->win_col, l->win_row+stripe->row1+r, l->cols, 1,
+                       ezgdal_stripe_row(stripe, stripe->data, stripe->head, r) + 
+                       (long)stripe->rows * stripe->data_size,
+                       l->cols, 1, ezgdal_gdal_data_type(stripe->data_type), 0, 0);
+    if(res>CE_Warning) {
+      ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+      exit(EXIT_FAILURE);
+    }
     N++;
   }
-  stripe->layer->buffer = p;
   return N;
 }
 
@@ -733,32 +2804,188 @@ int  ezgdal_save_stripe_data(EZGDAL_STRIPE *stripe) {
 /*         FRAMESET & FRAME                 */
 /*                                          */
 
+/* pool of idle buffers of the calling thread, NULL if it has none */
+EZGDAL_BUFFER_POOL*  ezgdal_frameset_pool(EZGDAL_FRAMESET *frameset) {
+  int t = 0;
+
+#ifdef _OPENMP
+  if(omp_in_parallel()) t = omp_get_thread_num();
+#endif
+  return (t < frameset->pools) ? &(frameset->pool[t]) : NULL;
+}
+
+/* takes the best fitting idle buffer, the largest one is grown if none fits */
+void*  ezgdal_pool_take(EZGDAL_FRAMESET *frameset, unsigned long size, unsigned long *capacity) {
+  EZGDAL_BUFFER_POOL *pool = ezgdal_frameset_pool(frameset);
+  void *buffer;
+  int i, best = -1, largest = -1;
+
+  if(pool != NULL)
+    for(i=0; i<pool->buffers; i++) {
+      if(pool->size[i] >= size && (best<0 || pool->size[i] < pool->size[best])) best = i;
+      if(largest<0 || pool->size[i] > pool->size[largest]) largest = i;
+    }
+
+  if(best < 0 && largest >= 0) {
+    pool->bytes -= pool->size[largest];
+    buffer = CPLRealloc(pool->buffer[largest], size);
+    *capacity = size;
+    best = largest;
+  } else if(best >= 0) {
+    pool->bytes -= pool->size[best];
+    buffer = pool->buffer[best];
+    *capacity = pool->size[best];
+  } else {
+    *capacity = size;
+    return CPLMalloc(size);
+  }
+
+  pool->buffers--;
+  pool->buffer[best] = pool->buffer[pool->buffers];
+  pool->size[best] = pool->size[pool->buffers];
+  return buffer;
+}
+
+/* keeps the buffer for the next load while the pool is below max_frame_buffer_size */
+void  ezgdal_pool_give(EZGDAL_FRAMESET *frameset, void *buffer, unsigned long capacity) {
+  EZGDAL_BUFFER_POOL *pool = ezgdal_frameset_pool(frameset);
+
+  if(pool == NULL || pool->buffers == EZGDAL_POOL_LEN ||
+     pool->bytes + capacity > max_frame_buffer_size) {
+    CPLFree(buffer);
+    return;
+  }
+  pool->buffer[pool->buffers] = buffer;
+  pool->size[pool->buffers] = capacity;
+  pool->buffers++;
+  pool->bytes += capacity;
+}
+
 void  ezgdal_unload_frameset_frame_data(EZGDAL_FRAME *frame) {
   if(frame->private_buffer!=NULL) {
-    CPLFree(frame->private_buffer);
-    free(frame->buffer);
+    ezgdal_pool_give(frame->owner.frameset, frame->private_buffer, frame->private_size);
     frame->private_buffer = NULL;
-    frame->buffer = NULL;
+    frame->private_size = 0;
   }
+  frame->base = &(frame->private_buffer);
+  frame->valid_base = NULL;
+  frame->nulls = -1;
 }
 
-void  ezgdal_frameset_frame_alloc(EZGDAL_FRAME *frame) {
+/* validity bitmask and null count of a loaded frameset frame */
+void  ezgdal_frame_build_validity(EZGDAL_FRAME *frame) {
+  EZGDAL_LAYER *l = frame->owner.frameset->layer;
+  EZGDAL_BITS *row;
+  unsigned char *flags = NULL;
+  long len;
+  double v;
+  int r, c, r1, r2, c1, c2, is_masked;
+
+  frame->valid_stride = EZGDAL_BITS_WORDS(frame->cols);
+  frame->valid_bit = 0;
+  len = (long)frame->rows*frame->valid_stride;
+  if(len > frame->private_valid_len) {
+    free(frame->private_valid);
+    frame->private_valid = (EZGDAL_BITS *)malloc(len*sizeof(EZGDAL_BITS));
+    if(frame->private_valid==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    frame->private_valid_len = len;
+  }
+  memset(frame->private_valid, 0, len*sizeof(EZGDAL_BITS));
+  frame->valid_base = &(frame->private_valid);
+  frame->nulls = 0;
+
+  /* values of a masked layer do not tell its null cells: cells 
+     out of the mask and out of the raster are null as well */
+  c1 = (frame->col1 < 0) ? 0 : frame->col1;
+  r1 = (frame->row1 < 0) ? 0 : frame->row1;
+  c2 = (frame->col2 >= l->cols) ? l->cols-1 : frame->col2;
+  r2 = (frame->row2 >= l->rows) ? l->rows-1 : frame->row2;
+  is_masked = ezgdal_is_masked(l);
+  if(is_masked)
+    flags = ezgdal_read_mask_flags(l, c1, r1, c2-c1+1, r2-r1+1);
+
+  for(r=0; r<frame->rows; r++) {
+    row = frame->private_valid + (long)r*frame->valid_stride;
+    for(c=0; c<frame->cols; c++) {
+      v = ezgdal_frame_value(frame, r, c);
+      if(v!=v || ezgdal_is_null(l, v) ||
+         (is_masked && (flags == NULL || 
+                        frame->row1+r < r1 || frame->row1+r > r2 || frame->col1+c < c1 || frame->col1+c > c2 || 
+                        !flags[(long)(frame->row1+r-r1)*(c2-c1+1) + frame->col1+c-c1])))
+        frame->nulls++;
+      else
+        row[c / EZGDAL_BITS_SIZE] |= (EZGDAL_BITS)1 << (c % EZGDAL_BITS_SIZE);
+    }
+  }
+  free(flags);
+}
+
+/* frames loaded from now on know their null cells */
+int  ezgdal_frameset_validity_mode(EZGDAL_FRAMESET *frameset) {
   int i;
+
+  if(frameset == NULL) return FALSE;
+  frameset->is_validity = TRUE;
+  for(i=0; i<frameset->frames; i++)
+    if(frameset->frame[i]->private_buffer!=NULL || frameset->frame[i]->base!=&(frameset->frame[i]->private_buffer))
+      ezgdal_frame_build_validity(frameset->frame[i]);
+  return TRUE;
+}
+
+void  ezgdal_frameset_frame_alloc(EZGDAL_FRAME *frame) {
+  EZGDAL_LAYER *l = frame->owner.frameset->layer;
   
   ezgdal_unload_frameset_frame_data(frame);
 
-  unsigned long size = (unsigned long)(frame->col2-frame->col1+1)*(frame->row2-frame->row1+1);
-  frame->private_buffer = (double *)CPLMalloc(size*sizeof(double));
+  /* the type is set when the frameset is created, frames 
+     are allocated in parallel and only read it */
+  frame->data_type = l->data_type;
+  frame->is_category = FALSE;
 
-  frame->buffer = (double **)malloc(frame->rows*sizeof(double *));
+  unsigned long size = (unsigned long)(frame->col2-frame->col1+1)*(frame->row2-frame->row1+1);
+  frame->private_buffer = ezgdal_pool_take(frame->owner.frameset, size*l->data_size, &(frame->private_size));
 
-  if(frame->buffer==NULL || frame->private_buffer==NULL) {
+  if(frame->private_buffer==NULL) {
     ezgdal_show_message(stderr,"No RAM to proceed!");
     exit(EXIT_FAILURE);
   }
 
-  for(i=0; i<frame->rows; i++) 
-    frame->buffer[i] = frame->private_buffer + i*frame->cols;
+  frame->base = &(frame->private_buffer);
+  frame->offset = 0;
+  frame->row_stride = (long)frame->cols*l->data_size;
+}
+
+/* 
+ * The file mapping is read-only: a frameset frame looking into it
+ * gets its own copy of the cells before they are written. Frames
+ * of stripes are moved with the stripe and cannot be copied.
+ */
+void  ezgdal_frame_copy_mapped(EZGDAL_LAYER *layer, EZGDAL_FRAME *frame) {
+  EZGDAL_BITS **valid_base;
+  char *src;
+  long map_line, nulls;
+  int r;
+
+  if(layer->map_data == NULL) return;
+  if(layer->stripe != NULL && frame->base == &(layer->stripe->map_view)) {
+    ezgdal_show_message(stderr,"Frames of mapped stripes are read-only!");
+    exit(EXIT_FAILURE);
+  }
+  if(frame->base != &(layer->map_data)) return;
+
+  src = (char *)layer->map_data + frame->offset;
+  map_line = frame->row_stride;
+  valid_base = frame->valid_base;
+  nulls = frame->nulls;
+  ezgdal_frameset_frame_alloc(frame);
+  for(r=0; r<frame->rows; r++)
+    memcpy((char *)frame->private_buffer + r*frame->row_stride, src + r*map_line, 
+           (size_t)frame->cols*layer->data_size);
+  frame->valid_base = valid_base;
+  frame->nulls = nulls;
 }
 
 
@@ -768,10 +2995,49 @@ EZGDAL_FRAMESET*  ezgdal_create_frameset_with_size(EZGDAL_LAYER *layer, int size
   fst->frameset_len = size;
   fst->frames = 0;
   fst->layer = layer;
+  ezgdal_update_data_type(layer);
+  /* null cells of a masked layer are known from the bitmasks only */
+  fst->is_validity = ezgdal_is_masked(layer);
+  fst->chunk = NULL;
+  fst->chunks = 0;
+  fst->chunk_len = fst->chunk_used = 0;
+#ifdef _OPENMP
+  fst->pools = omp_get_max_threads();
+#else
+  fst->pools = 1;
+#endif
+  fst->pool = (EZGDAL_BUFFER_POOL *)calloc(fst->pools,sizeof(EZGDAL_BUFFER_POOL));
+  if(fst->pool==NULL) {
+    ezgdal_show_message(stderr,"No RAM to proceed!");
+    exit(EXIT_FAILURE);
+  }
   layer->frameset = fst;
   return fst;
 }
 
+/* next frame header of the arena, a new chunk covers the free part of the frame array */
+EZGDAL_FRAME*  ezgdal_frameset_new_frame(EZGDAL_FRAMESET *frameset) {
+  EZGDAL_FRAME **chunk;
+
+  if(frameset->chunk_used == frameset->chunk_len) {
+    chunk = (EZGDAL_FRAME **)realloc(frameset->chunk, (frameset->chunks+1)*sizeof(EZGDAL_FRAME *));
+    if(chunk==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    frameset->chunk = chunk;
+    frameset->chunk_len = frameset->frameset_len - frameset->frames;
+    frameset->chunk[frameset->chunks] = (EZGDAL_FRAME *)calloc(frameset->chunk_len, sizeof(EZGDAL_FRAME));
+    if(frameset->chunk[frameset->chunks]==NULL) {
+      ezgdal_show_message(stderr,"No RAM to proceed!");
+      exit(EXIT_FAILURE);
+    }
+    frameset->chunks++;
+    frameset->chunk_used = 0;
+  }
+  return &(frameset->chunk[frameset->chunks-1][frameset->chunk_used++]);
+}
+
 EZGDAL_FRAMESET*  ezgdal_create_frameset(EZGDAL_LAYER *layer) {
   return ezgdal_create_frameset_with_size(layer,EZGDAL_FRAMESET_LEN);
 }
@@ -784,28 +3050,43 @@ EZGDAL_FRAME*  ezgdal_add_frameset_frame(EZGDAL_FRAMESET *frameset, int col1, in
   int p;
 
   if(col1>col2) { p = col1; col1 = col2; col2 = p;}
-  if(row1>row2) { p = col1; col1 = col2; col2 = p;}
+  if(row1>row2) { p = row1; row1 = row2; row2 = p;}
 
-  unsigned long size = (unsigned long)(col2-col1+1)*(row2-row1+1)*sizeof(double);
+  unsigned long size = (unsigned long)(col2-col1+1)*(row2-row1+1)*frameset->layer->data_size;
 
   if(size<=0 || size>max_frame_buffer_size)
     return NULL;
 
-  EZGDAL_FRAME *frame = (EZGDAL_FRAME *)malloc(sizeof(EZGDAL_FRAME));
-  frame->owner.frameset = frameset;
-  frame->private_buffer = NULL;
-  frame->buffer = NULL;
-
-  ezgdal_frameset_set_frame(frame, col1, col2, row1, row2);
-  
   if(frameset->frames==frameset->frameset_len) {
     frameset->frameset_len += EZGDAL_FRAMESET_STEP;
-    frameset->frame = realloc(frameset->frame, frameset->frameset_len);
+    frameset->frame = realloc(frameset->frame, frameset->frameset_len*sizeof(EZGDAL_FRAME *));
     if(frameset->frame==NULL) {
       ezgdal_show_message(stderr,"No RAM to proceed!");
       exit(EXIT_FAILURE);
     }
   }
+
+  EZGDAL_FRAME *frame = ezgdal_frameset_new_frame(frameset);
+  frame->owner.frameset = frameset;
+  frame->is_category = FALSE;
+  frame->private_buffer = NULL;
+  frame->private_size = 0;
+  frame->base = &(frame->private_buffer);
+  frame->offset = 0;
+  frame->row_stride = 0;
+  frame->wrap_row = &(frame->rows);
+  frame->wrap_bytes = 0;
+  frame->private_valid = NULL;
+  frame->private_valid_len = 0;
+  frame->valid_base = NULL;
+  frame->valid_bit = 0;
+  frame->valid_stride = 0;
+  frame->valid_wrap_row = &(frame->rows);
+  frame->valid_wrap_words = 0;
+  frame->nulls = -1;
+
+  ezgdal_frameset_set_frame(frame, col1, col2, row1, row2);
+
   frameset->frame[frameset->frames] = frame;
   frameset->frames++;
   
@@ -818,7 +3099,7 @@ void  ezgdal_frameset_set_frame(EZGDAL_FRAME *frame, int col1, int col2, int row
   
   if(frame==NULL) return;
 
-  data_are_loaded = (frame->private_buffer!=NULL);
+  data_are_loaded = (frame->private_buffer!=NULL || frame->base!=&(frame->private_buffer));
   ezgdal_unload_frameset_frame_data(frame);
 
   if(col1>col2) { p = col1; col1 = col2; col2 = p;}
@@ -836,17 +3117,26 @@ void  ezgdal_frameset_set_frame(EZGDAL_FRAME *frame, int col1, int col2, int row
 }
 
 void  ezgdal_free_frameset(EZGDAL_FRAMESET *frameset) {
+  int i;
+
   if(frameset==NULL) return;
   EZGDAL_LAYER *l = frameset->layer;
   ezgdal_free_frameset_all_frames(frameset);
+  for(i=0; i<frameset->pools; i++)
+    while(frameset->pool[i].buffers > 0)
+      CPLFree(frameset->pool[i].buffer[--frameset->pool[i].buffers]);
+  free(frameset->pool);
   free(frameset->frame);
   free(frameset);
   l->frameset = NULL;
 }
 
+/* releases the data of the frame, its header is reclaimed with the whole arena */
 void  ezgdal_free_frameset_frame(EZGDAL_FRAME *frame) {
   ezgdal_unload_frameset_frame_data(frame);
-  free(frame);
+  free(frame->private_valid);
+  frame->private_valid = NULL;
+  frame->private_valid_len = 0;
 }
 
 void  ezgdal_free_frameset_all_frames(EZGDAL_FRAMESET *frameset) {
@@ -854,6 +3144,12 @@ void  ezgdal_free_frameset_all_frames(EZGDAL_FRAMESET *frameset) {
   for(i=0; i<frameset->frames; i++)
     ezgdal_free_frameset_frame(frameset->frame[i]);
   frameset->frames = 0;
+  for(i=0; i<frameset->chunks; i++)
+    free(frameset->chunk[i]);
+  free(frameset->chunk);
+  frameset->chunk = NULL;
+  frameset->chunks = 0;
+  frameset->chunk_len = frameset->chunk_used = 0;
 }
 
 EZGDAL_FRAME*  ezgdal_get_frameset_frame(EZGDAL_FRAMESET *frameset, int idx) {
@@ -866,41 +3162,61 @@ EZGDAL_FRAME*  ezgdal_get_frameset_frame(EZGDAL_FRAMESET *frameset, int idx) {
 void  ezgdal_load_frameset_frame_data(EZGDAL_FRAME *frame) {
 
   if(frame==NULL) return;
-  ezgdal_frameset_frame_alloc(frame);
 
   EZGDAL_LAYER *l = frame->owner.frameset->layer;
 
+  if(l->map_data != NULL &&
+     frame->col1 >= 0 && frame->row1 >= 0 &&
+     frame->col2 < l->cols && frame->row2 < l->rows) {
+    // inside a mapped layer - look into the mapping
+    ezgdal_unload_frameset_frame_data(frame);
+    frame->data_type = l->data_type;
+    frame->is_category = FALSE;
+    frame->base = &(l->map_data);
+    frame->offset = (long)frame->row1*l->map_line + (long)frame->col1*l->data_size;
+    frame->row_stride = l->map_line;
+    if(frame->owner.frameset->is_validity)
+      ezgdal_frame_build_validity(frame);
+    return;
+  }
+
+  ezgdal_frameset_frame_alloc(frame);
+
   if(frame->col1 >= 0 &&
      frame->row1 >= 0 &&
      frame->col2 < l->cols &&
      frame->row2 < l->rows) {
     // inside - read
-    CPLErr res = GDALRasterIO(l->band_h,
+    if(l->cache != NULL)
+      ezgdal_cache_read(l, frame->col1, frame->row1, frame->cols, frame->rows,
+                        frame->private_buffer, frame->data_type, frame->row_stride);
+    else {
+      CPLErr res = ezgdal_layer_raster_io(l,
                                 GF_Read, 
                                 frame->col1, frame->row1,
                                 frame->cols, frame->rows,
                                 frame->private_buffer, 
                                 frame->cols, frame->rows,
-                                GDT_Float64, 0, 0 );
+                                ezgdal_gdal_data_type(frame->data_type), 0, 0 );
       
-    if(res>CE_Warning) {
-      ezgdal_show_message(stderr,"GDAL I/O operation faild!");
-      exit(EXIT_FAILURE);
+      if(res>CE_Warning) {
+        ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+        exit(EXIT_FAILURE);
+      }
     }
     
   } else {
     if(!(frame->col1 >= l->cols ||
          frame->row1 >= l->rows ||
          frame->col2 < 0 || frame->row2 < 0)) {
-      // border crossing - read part and copy
+      // border crossing - read part in place
 
-      int row, col, r, c, new_c1, new_r1, new_c2, new_r2, new_cols, new_rows;
+      int row, col, new_c1, new_r1, new_c2, new_r2, new_cols, new_rows;
 
-      int i;
       long n;
-      double *p;
+      int size = ezgdal_data_type_size(frame->data_type);
 
-      n = frame->cols*frame->rows;
+      n = (long)frame->cols*frame->rows;
       double d = 0.0;
       if(l->is_no_data)
         d = l->no_data;
@@ -910,9 +3226,7 @@ void  ezgdal_load_frameset_frame_data(EZGDAL_FRAME *frame) {
         else 
           d = l->stats->min;
       }
-      p = frame->private_buffer;
-      for(i=0; i<n; i++)
-        *(p++) = d;
+      ezgdal_fill_cells(frame->private_buffer, frame->data_type, n, d);
 
       new_c1 = (frame->col1<0)?0:frame->col1;
       new_r1 = (frame->row1<0)?0:frame->row1;
@@ -920,33 +3234,32 @@ void  ezgdal_load_frameset_frame_data(EZGDAL_FRAME *frame) {
       new_r2 = (frame->row2>=l->rows)?l->rows-1:frame->row2;
       new_cols = new_c2 - new_c1 + 1;
       new_rows = new_r2 - new_r1 + 1;
-      double *buf = (double *)malloc(new_cols*new_rows*sizeof(double));
+      row = new_r1 - frame->row1;
+      col = new_c1 - frame->col1;
       
-      CPLErr res = GDALRasterIO(l->band_h,
+      if(l->cache != NULL)
+        ezgdal_cache_read(l, new_c1, new_r1, new_cols, new_rows,
+                          (char *)frame->private_buffer + row*frame->row_stride + (long)col*size,
+                          frame->data_type, frame->row_stride);
+      else {
+        CPLErr res = ezgdal_layer_raster_io(l,
                                 GF_Read, 
                                 new_c1, new_r1,
                                 new_cols, new_rows,
-                                buf, 
+                                (char *)frame->private_buffer + row*frame->row_stride + (long)col*size, 
                                 new_cols, new_rows,
-                                GDT_Float64, 0, 0);
+                                ezgdal_gdal_data_type(frame->data_type),
+                                0, (long)frame->cols*size);
       
-      if(res>CE_Warning) {
-        free(buf);
-        ezgdal_show_message(stderr,"GDAL I/O operation faild!");
-        exit(EXIT_FAILURE);
+        if(res>CE_Warning) {
+          ezgdal_show_message(stderr,"GDAL I/O operation faild!");
+          exit(EXIT_FAILURE);
+        }
       }
-
-      for(r=0; r<new_rows; r++) {
-        row = new_r1 - frame->row1 + r;
-        col = new_c1 - frame->col1;
-        for(c=0; c<new_cols; c++) 
-          frame->private_buffer[row*frame->cols+col+c] = buf[r*new_cols+c];
-        row += frame->cols;
-      }
-
-      free(buf);
     }
   }
 
+  if(frame->owner.frameset->is_validity)
+    ezgdal_frame_build_validity(frame);
 }
 
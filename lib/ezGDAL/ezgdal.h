@@ -36,7 +36,43 @@ extern "C" {
 #define EZGDAL_FRAMESET_LEN 10240
 #define EZGDAL_FRAMESET_STEP 10240
 #define MAX_FRAME_BUFFER_SIZE 4294967295
-
+#define EZGDAL_POOL_LEN 16
+
+#define EZGDAL_NULL_CAT -1
+#define EZGDAL_NULL_CAT_UINT8 0xFF
+#define EZGDAL_NULL_CAT_UINT16 0xFFFF
+#define EZGDAL_DENSE_MAP_MAX 65536
+#define EZGDAL_DENSE_MAP_RATIO 8
+
+/* words of validity bitmasks */
+typedef unsigned long long EZGDAL_BITS;
+#define EZGDAL_BITS_SIZE 64
+#define EZGDAL_BITS_WORDS(n) (((long)(n) + EZGDAL_BITS_SIZE - 1) / EZGDAL_BITS_SIZE)
+
+/*
+ * Type of the cells kept in stripes and frames. It follows the band's
+ * data type, so 8- and 16-bit categorical maps are not expanded to
+ * doubles. A wider type is used only if the no-data value cannot be
+ * represented by the band's own type.
+ */
+typedef enum {
+  EZGDAL_UINT8,
+  EZGDAL_UINT16,
+  EZGDAL_INT16,
+  EZGDAL_INT32,
+  EZGDAL_FLOAT32,
+  EZGDAL_FLOAT64
+} EZGDAL_DATA_TYPE;
+
+/*
+ * Category dictionary of a layer. Categories are numbered 0..map_max_val
+ * in the order of their values, cat_value[idx] keeps the value of
+ * the category idx. The value -> index lookup uses the direct table
+ * map_cat (one entry per histogram bin) if the value range is small
+ * enough, otherwise map_cat is NULL and the lookup goes through
+ * the cat_key/cat_slot hash table, so sparse codes (e.g. 10000, 20000, ...)
+ * do not need a table spanning the whole range.
+ */
 typedef struct {
   double min,max,avg,std;
   double hist_min,hist_max,hist_step;
@@ -44,6 +80,10 @@ typedef struct {
   int map_max_val;
   int *map_cat;
   GUIntBig *hist;
+  double *cat_value;
+  long long *cat_key;
+  int *cat_slot;
+  long cat_hash_mask;
 } EZGDAL_STATS;
 
 typedef struct EZGDAL_STRIPE EZGDAL_STRIPE;
@@ -55,42 +95,185 @@ union EZGDAL_FRAME_OWNER {
   EZGDAL_FRAMESET *frameset;
 };
 
+/*
+ * A frame is a view: row r starts at *base + offset + r*row_stride,
+ * less wrap_bytes from the row *wrap_row on. Frames of a stripe point 
+ * at the stripe's view pointer and wrap row, so moving the stripe does
+ * not touch them; frames of a frameset point at their own private_buffer
+ * and never wrap (wrap_row points at rows). In a mapped layer both may
+ * point into the file mapping instead.
+ */
 typedef struct {
   union EZGDAL_FRAME_OWNER owner;
   int cols, rows;
   int col1, col2;
   int row1, row2;
-  double *private_buffer;
-  double **buffer;
+  EZGDAL_DATA_TYPE data_type;
+  int is_category;
+  void *private_buffer;
+  unsigned long private_size;
+  void **base;
+  long offset;
+  long row_stride;
+  int *wrap_row;
+  long wrap_bytes;
+  /* validity (if nulls>=0): bit valid_bit+c of the row r starting 
+     at *valid_base + r*valid_stride (less valid_wrap_words from 
+     the row *valid_wrap_row on) is set for a not null cell, 
+     nulls is the number of null cells of the frame */
+  EZGDAL_BITS **valid_base;
+  EZGDAL_BITS *private_valid;
+  long private_valid_len;
+  long valid_bit;
+  long valid_stride;
+  int *valid_wrap_row;
+  long valid_wrap_words;
+  long nulls;
 } EZGDAL_FRAME;
 
+/* idle pixel buffers of frameset frames, one pool per thread */
+typedef struct {
+  void *buffer[EZGDAL_POOL_LEN];
+  unsigned long size[EZGDAL_POOL_LEN];
+  int buffers;
+  unsigned long bytes;
+} EZGDAL_BUFFER_POOL;
+
+/*
+ * Frame headers are kept in chunks of the arena, frame[i] points 
+ * into them. Buffers of unloaded frames go back to the pool of 
+ * the thread and are reused by the next loads.
+ */
 struct EZGDAL_FRAMESET {
   EZGDAL_LAYER *layer;
   int frames;
   int frameset_len;
   EZGDAL_FRAME **frame;
+  int is_validity;
+  EZGDAL_FRAME **chunk;
+  int chunks;
+  int chunk_len, chunk_used;
+  EZGDAL_BUFFER_POOL *pool;
+  int pools;
 };
 
 struct EZGDAL_STRIPE {
   EZGDAL_LAYER *layer;
   int row1, row2;
   int rows;
-  double **buffer;
+  EZGDAL_DATA_TYPE data_type;
+  int data_size;
+  /* category mode: cells keep category indices,
+     raw_type is the type of cells read from the band */
+  int is_category;
+  EZGDAL_DATA_TYPE raw_type;
+  /* circular buffer: data keeps rows rows, the row r is the
+     physical row (head+r) % rows; view points at the row 0, 
+     the rows from wrap_row = rows-head on continue at data */
+  int stride;
+  void *data;
+  int head;
+  void *view;
+  int wrap_row;
   int frames;
   EZGDAL_FRAME *frame;
+  /* mapped layer: frames inside the raster look through map_view 
+     into the file mapping, the ring keeps only raster columns 
+     ring_col1 .. ring_col2 needed by the others */
+  void *map_view;
+  int ring_col1, ring_col2;
+  /* validity mode: a ring of bitmasks of rows rows, addressed like
+     data and following rows valid_row1 ..; col_nulls counts nulls 
+     of each column, null_prefix sums them over columns */
+  int is_validity;
+  int valid_row1;
+  int valid_head;
+  int valid_wrap_row;
+  long valid_words;
+  EZGDAL_BITS *valid;
+  EZGDAL_BITS *valid_view;
+  long *col_nulls;
+  long *null_prefix;
+  /* prefetch mode: the next stripe is read in the background
+     into a second buffer set through a private dataset handle */
+  int is_prefetch;
+  int prefetch_row1;
+  void *prefetch_data;
+  void *prefetch_thread;
+  GDALDatasetH prefetch_dataset_h;
+  GDALRasterBandH prefetch_band_h;
 };
 
+/* a decoded block of the band, linked in LRU order and in a hash chain */
+typedef struct {
+  int block_row, block_col;
+  void *data;
+  int prev, next;
+  int hash_next;
+} EZGDAL_CACHE_BLOCK;
+
+/*
+ * Block cache of a layer: frameset frames are assembled from 
+ * decoded blocks of data_type kept within size bytes; 
+ * head is the most and tail the least recently used block.
+ */
+typedef struct {
+  unsigned long size;
+  EZGDAL_DATA_TYPE data_type;
+  int blocks;
+  int blocks_len;
+  EZGDAL_CACHE_BLOCK *block;
+  int *hash;
+  int hash_len;
+  int head, tail;
+  long hits, misses;
+  void *lock;
+} EZGDAL_BLOCK_CACHE;
+
 struct EZGDAL_LAYER {
   GDALDatasetH dataset_h;
   GDALRasterBandH band_h;
   int rows;
   int cols;
+  int block_rows;
+  int block_cols;
   int is_no_data;
   double no_data;
+  EZGDAL_DATA_TYPE data_type;
+  int data_size;
   double *buffer;
   EZGDAL_STRIPE *stripe;
   EZGDAL_FRAMESET *frameset;
   EZGDAL_STATS *stats;
+  /* handle pool: independently opened copies of the dataset, 
+     band_pool[t] is used by the thread t of a parallel region */
+  int handles;
+  GDALDatasetH *dataset_pool;
+  GDALRasterBandH *band_pool;
+  /* output layers: rows of one block row waiting for writing */
+  char *write_data;
+  char *write_flags;
+  int write_block;
+  char *cog_fname;
+  /* region of interest: the layer shows only the window of the band
+     starting at win_col, win_row; cells outside the mask are null */
+  int is_window;
+  int win_col, win_row;
+  EZGDAL_LAYER *mask;
+  /* the band has a GDAL mask band (alpha, .msk, per dataset), 
+     cells out of it are null as well */
+  int is_mask_band;
+  /* mapped mode: the band's file mapping, map_line bytes per row */
+  CPLVirtualMem *vmem;
+  void *map_data;
+  long map_line;
+  EZGDAL_BLOCK_CACHE *cache;
+  /* all bands: band_buffer keeps a row of every band, band after band,
+     and a row of the mask; no-data of band b is band_no_data[b] */
+  int bands;
+  double *band_buffer;
+  double *band_no_data;
+  int *band_is_no_data;
 };
 
 /*==========================================*/
@@ -104,6 +287,8 @@ EZGDAL_DLL_API int  ezgdal_is_bbox_ok(EZGDAL_LAYER **inputs, int ninputs);
 EZGDAL_DLL_API int  ezgdal_is_projection_ok(EZGDAL_LAYER **inputs, int ninputs);
 
 EZGDAL_DLL_API GDALDataType  ezgdal_data_type(char *data);
+EZGDAL_DLL_API GDALDataType  ezgdal_gdal_data_type(EZGDAL_DATA_TYPE data_type);
+EZGDAL_DLL_API int  ezgdal_data_type_size(EZGDAL_DATA_TYPE data_type);
 
 EZGDAL_DLL_API int  ezgdal_xy2c(EZGDAL_LAYER *layer, double x, double y);
 EZGDAL_DLL_API double  ezgdal_cr2x(EZGDAL_LAYER *layer, int col, int row);
@@ -122,23 +307,45 @@ EZGDAL_DLL_API EZGDAL_LAYER*  ezgdal_create_layer(char *fname,
                          int *nodata);
 EZGDAL_DLL_API EZGDAL_LAYER*  ezgdal_open_layer(char *fname);
 EZGDAL_DLL_API void  ezgdal_close_layer(EZGDAL_LAYER *layer);
+EZGDAL_DLL_API int  ezgdal_layer_open_handles(EZGDAL_LAYER *layer, int n);
+EZGDAL_DLL_API GDALRasterBandH  ezgdal_layer_band(EZGDAL_LAYER *layer);
+EZGDAL_DLL_API int  ezgdal_layer_mmap_mode(EZGDAL_LAYER *layer);
+EZGDAL_DLL_API int  ezgdal_layer_cache_mode(EZGDAL_LAYER *layer, unsigned long size);
+EZGDAL_DLL_API int  ezgdal_layer_set_window(EZGDAL_LAYER *layer, int col1, int row1, int cols, int rows);
+EZGDAL_DLL_API int  ezgdal_layer_set_bbox(EZGDAL_LAYER *layer, double xmin, double ymin, double xmax, double ymax);
+EZGDAL_DLL_API int  ezgdal_layer_set_mask(EZGDAL_LAYER *layer, char *fname);
+EZGDAL_DLL_API int  ezgdal_layer_set_region(EZGDAL_LAYER *layer, const char *window, const char *bbox, const char *mask);
+EZGDAL_DLL_API CPLErr  ezgdal_layer_raster_io(EZGDAL_LAYER *layer, GDALRWFlag rw,
+                         int col, int row, int cols, int rows,
+                         void *data, int buf_cols, int buf_rows,
+                         GDALDataType data_type, int pixel_space, int line_space);
+EZGDAL_DLL_API CPLErr  ezgdal_layer_mask_band_io(EZGDAL_LAYER *layer, int col, int row, int cols, int rows, double *data);
 
 EZGDAL_DLL_API void  ezgdal_set_palette255(EZGDAL_LAYER *layer, double palette[][5], int n);
 
 EZGDAL_DLL_API void  ezgdal_read_buffer(EZGDAL_LAYER *layer, int row);
+EZGDAL_DLL_API void  ezgdal_read_bands_buffer(EZGDAL_LAYER *layer, int row);
+EZGDAL_DLL_API int  ezgdal_is_band_null(EZGDAL_LAYER *layer, int band, double v);
+EZGDAL_DLL_API void  ezgdal_calc_bands_range(EZGDAL_LAYER *layer, double *min, double *max);
 EZGDAL_DLL_API void  ezgdal_write_buffer(EZGDAL_LAYER *layer, int row);
+EZGDAL_DLL_API void  ezgdal_flush_write_buffer(EZGDAL_LAYER *layer);
+EZGDAL_DLL_API void  ezgdal_set_writer_options(const char *compress, int cog);
+EZGDAL_DLL_API void  ezgdal_set_create_option(const char *name, const char *value);
 
 EZGDAL_DLL_API char*  ezgdal_layer_get_wkt(EZGDAL_LAYER *layer);
 EZGDAL_DLL_API double*  ezgdal_layer_get_at(EZGDAL_LAYER *layer);
 
 EZGDAL_DLL_API int  ezgdal_is_null(EZGDAL_LAYER *layer, double v);
 EZGDAL_DLL_API void  ezgdal_set_null(EZGDAL_LAYER *layer, double *v);
+EZGDAL_DLL_API void  ezgdal_set_frame_null(EZGDAL_LAYER *layer, EZGDAL_FRAME *frame, int r, int c);
 
 /*==========================================*/
 /*              STATS                       */
 
 EZGDAL_DLL_API void  ezgdal_calc_layer_stats(EZGDAL_LAYER *layer);
 EZGDAL_DLL_API void  ezgdal_calc_value_map(EZGDAL_LAYER *layer, double min, double max, int N);
+EZGDAL_DLL_API void  ezgdal_free_value_map(EZGDAL_STATS *stats);
+EZGDAL_DLL_API void  ezgdal_calc_layer_categories(EZGDAL_LAYER *layer);
 EZGDAL_DLL_API int  ezgdal_get_value_index(EZGDAL_LAYER *layer, double val);
 EZGDAL_DLL_API double  ezgdal_get_index_value(EZGDAL_LAYER *layer, int idx);
 
@@ -156,6 +363,10 @@ EZGDAL_DLL_API void  ezgdal_shift_frame_pos(EZGDAL_FRAME *frame, int col);
 
 EZGDAL_DLL_API int  ezgdal_load_stripe_data(EZGDAL_STRIPE *stripe, int row1);
 EZGDAL_DLL_API int  ezgdal_save_stripe_data(EZGDAL_STRIPE *stripe);
+EZGDAL_DLL_API int  ezgdal_stripe_prefetch_mode(EZGDAL_STRIPE *stripe);
+EZGDAL_DLL_API int  ezgdal_prefetch_stripe_data(EZGDAL_STRIPE *stripe, int row1);
+EZGDAL_DLL_API int  ezgdal_stripe_category_mode(EZGDAL_STRIPE *stripe);
+EZGDAL_DLL_API int  ezgdal_stripe_validity_mode(EZGDAL_STRIPE *stripe);
 
 /*==========================================*/
 /*         FRAMESET & FRAME                 */
@@ -172,6 +383,135 @@ EZGDAL_DLL_API void  ezgdal_free_frameset_all_frames(EZGDAL_FRAMESET *frameset);
 EZGDAL_DLL_API EZGDAL_FRAME*  ezgdal_get_frameset_frame(EZGDAL_FRAMESET *frameset, int idx);
 EZGDAL_DLL_API void  ezgdal_load_frameset_frame_data(EZGDAL_FRAME *frame);
 EZGDAL_DLL_API void  ezgdal_unload_frameset_frame_data(EZGDAL_FRAME *frame);
+EZGDAL_DLL_API int  ezgdal_frameset_validity_mode(EZGDAL_FRAMESET *frameset);
+
+/*==========================================*/
+/*         TYPED FRAME ACCESS               */
+
+#define EZGDAL_FRAME_ROW(frame,r) \
+  ((char *)*((frame)->base) + (frame)->offset + (long)(r)*(frame)->row_stride - \
+   (((r) >= *((frame)->wrap_row)) ? (frame)->wrap_bytes : 0))
+
+#define EZGDAL_ROW_UINT8(frame,r)   ((unsigned char *)EZGDAL_FRAME_ROW(frame,r))
+#define EZGDAL_ROW_UINT16(frame,r)  ((unsigned short *)EZGDAL_FRAME_ROW(frame,r))
+#define EZGDAL_ROW_INT16(frame,r)   ((short *)EZGDAL_FRAME_ROW(frame,r))
+#define EZGDAL_ROW_INT32(frame,r)   ((int *)EZGDAL_FRAME_ROW(frame,r))
+#define EZGDAL_ROW_FLOAT32(frame,r) ((float *)EZGDAL_FRAME_ROW(frame,r))
+#define EZGDAL_ROW_FLOAT64(frame,r) ((double *)EZGDAL_FRAME_ROW(frame,r))
+
+static inline double ezgdal_frame_value(EZGDAL_FRAME *frame, int r, int c) {
+  switch(frame->data_type) {
+    case EZGDAL_UINT8:   return EZGDAL_ROW_UINT8(frame,r)[c];
+    case EZGDAL_UINT16:  return EZGDAL_ROW_UINT16(frame,r)[c];
+    case EZGDAL_INT16:   return EZGDAL_ROW_INT16(frame,r)[c];
+    case EZGDAL_INT32:   return EZGDAL_ROW_INT32(frame,r)[c];
+    case EZGDAL_FLOAT32: return EZGDAL_ROW_FLOAT32(frame,r)[c];
+    default:             return EZGDAL_ROW_FLOAT64(frame,r)[c];
+  }
+}
+
+static inline void ezgdal_frame_set_value(EZGDAL_FRAME *frame, int r, int c, double v) {
+  switch(frame->data_type) {
+    case EZGDAL_UINT8:   EZGDAL_ROW_UINT8(frame,r)[c] = (unsigned char)v; break;
+    case EZGDAL_UINT16:  EZGDAL_ROW_UINT16(frame,r)[c] = (unsigned short)v; break;
+    case EZGDAL_INT16:   EZGDAL_ROW_INT16(frame,r)[c] = (short)v; break;
+    case EZGDAL_INT32:   EZGDAL_ROW_INT32(frame,r)[c] = (int)v; break;
+    case EZGDAL_FLOAT32: EZGDAL_ROW_FLOAT32(frame,r)[c] = (float)v; break;
+    default:             EZGDAL_ROW_FLOAT64(frame,r)[c] = v; break;
+  }
+}
+
+/*==========================================*/
+/*         VALIDITY                         */
+
+/* number of null cells, -1 if the frame has no validity bitmask */
+static inline long ezgdal_frame_nulls(EZGDAL_FRAME *frame) {
+  return frame->nulls;
+}
+
+static inline EZGDAL_BITS* ezgdal_frame_valid_row(EZGDAL_FRAME *frame, int r) {
+  EZGDAL_BITS *row = *(frame->valid_base) + (long)r*frame->valid_stride;
+
+  return (r >= *(frame->valid_wrap_row)) ? row - frame->valid_wrap_words : row;
+}
+
+static inline int ezgdal_frame_is_valid(EZGDAL_FRAME *frame, int r, int c) {
+  EZGDAL_BITS *row = ezgdal_frame_valid_row(frame, r);
+  long b = frame->valid_bit + c;
+
+  return (int)((row[b / EZGDAL_BITS_SIZE] >> (b % EZGDAL_BITS_SIZE)) & 1);
+}
+
+/* 
+ * First not null cell of the row r at or after the column c, 
+ * frame->cols if there is none. Null runs are skipped a word at a time.
+ */
+static inline int ezgdal_frame_next_valid(EZGDAL_FRAME *frame, int r, int c) {
+  EZGDAL_BITS *row = ezgdal_frame_valid_row(frame, r);
+  long b = frame->valid_bit + c;
+  long end = frame->valid_bit + frame->cols;
+  EZGDAL_BITS w;
+
+  if(b >= end) return frame->cols;
+  w = row[b / EZGDAL_BITS_SIZE] & (~(EZGDAL_BITS)0 << (b % EZGDAL_BITS_SIZE));
+  b -= b % EZGDAL_BITS_SIZE;
+  while(w == 0) {
+    b += EZGDAL_BITS_SIZE;
+    if(b >= end) return frame->cols;
+    w = row[b / EZGDAL_BITS_SIZE];
+  }
+#ifdef __GNUC__
+  b += __builtin_ctzll(w);
+#else
+  while(!(w & 1)) { w >>= 1; b++; }
+#endif
+  return (b < end) ? (int)(b - frame->valid_bit) : frame->cols;
+}
+
+/*
+ * Null cell of a frame of values: the no-data value, or a cleared 
+ * validity bit (cells out of the mask of a masked layer are null
+ * only in the bitmask, their values are kept).
+ */
+static inline int ezgdal_frame_is_null(EZGDAL_FRAME *frame, int r, int c) {
+  if(frame->nulls > 0 && !ezgdal_frame_is_valid(frame, r, c))
+    return 1;
+  return ezgdal_is_null(frame->owner.stripe->layer, ezgdal_frame_value(frame, r, c));
+}
+
+/*
+ * Category index of a cell: 0..map_max_val or EZGDAL_NULL_CAT.
+ * Frames of a stripe in the category mode keep the indices,
+ * other frames are translated with the layer's value map.
+ */
+static inline int ezgdal_frame_get_cat(EZGDAL_FRAME *frame, int r, int c) {
+  int i;
+  double v;
+  EZGDAL_LAYER *l;
+
+  if(frame->is_category) {
+    switch(frame->data_type) {
+      case EZGDAL_UINT8:
+        i = EZGDAL_ROW_UINT8(frame,r)[c];
+        return (i==EZGDAL_NULL_CAT_UINT8) ? EZGDAL_NULL_CAT : i;
+      case EZGDAL_UINT16:
+        i = EZGDAL_ROW_UINT16(frame,r)[c];
+        return (i==EZGDAL_NULL_CAT_UINT16) ? EZGDAL_NULL_CAT : i;
+      default:
+        return EZGDAL_ROW_INT32(frame,r)[c];
+    }
+  }
+
+  /* cells out of the mask are null in the bitmask only */
+  if(frame->nulls > 0 && !ezgdal_frame_is_valid(frame, r, c))
+    return EZGDAL_NULL_CAT;
+  l = frame->owner.stripe->layer;
+  v = ezgdal_frame_value(frame, r, c);
+  if(ezgdal_is_null(l, v))
+    return EZGDAL_NULL_CAT;
+  return ezgdal_get_value_index(l, v);
+}
+
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,8 @@
 #include <math.h>
 #include <stdarg.h>
 
+#include "measures.h"
+
 double euclidean(double **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
   int i;
   double distance = 0.0;
@@ -27,3 +29,46 @@ double euclidean(double **signatures, int num_of_signatures, int size_of_signatu
   return sqrt(distance);
 }
 
+double euclidean_sparse(sparse_signature **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  int i = 0, j = 0;
+  double distance = 0.0;
+  double h0, h1, p; 
+
+  if(num_of_signatures<2) return 0.0;
+
+  while(sparse_next_pair(signatures[0],signatures[1],&i,&j,&h0,&h1)) {
+    p = h0 - h1;
+    distance += p*p;
+  }
+  distance /=(double)size_of_signature;
+  return sqrt(distance);
+}
+
+double euclidean_float(float **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  int i;
+  double distance = 0.0;
+  double p = 0.0; 
+
+  if(num_of_signatures<2) return 0.0;
+
+  for(i=0; i<size_of_signature; i++) {
+    p = (double)signatures[0][i] - signatures[1][i];
+    distance += p*p;
+  }
+  distance /=(double)size_of_signature;
+  return sqrt(distance);
+}
+
+/* differences of quantized values are exact */
+double euclidean_q16(unsigned short **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  int i;
+  long long p, distance = 0; 
+
+  if(num_of_signatures<2) return 0.0;
+
+  for(i=0; i<size_of_signature; i++) {
+    p = (int)signatures[0][i] - (int)signatures[1][i];
+    distance += p*p;
+  }
+  return sqrt((double)distance/(double)size_of_signature)/Q16_MAX;
+}
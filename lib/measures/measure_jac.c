@@ -12,6 +12,8 @@
 #include <math.h>
 #include <stdarg.h>
 
+#include "measures.h"
+
 double jaccard(double **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
 
   int i;
@@ -29,3 +31,61 @@ double jaccard(double **signatures, int num_of_signatures, int size_of_signature
   return 1.0 - d/(d0+d1-d);
 }
 
+double jaccard_sparse(sparse_signature **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+
+  int i = 0, j = 0;
+  double h0, h1;
+
+  double d = 0.0, d0 = 0.0, d1 = 0.0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  while(sparse_next_pair(signatures[0],signatures[1],&i,&j,&h0,&h1)) {
+    d  += h0*h1;
+    d0 += h0*h0;
+    d1 += h1*h1;
+  }
+
+  return 1.0 - d/(d0+d1-d);
+}
+
+double jaccard_float(float **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+
+  int i;
+  double h0, h1;
+
+  double d = 0.0, d0 = 0.0, d1 = 0.0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  for(i=0; i<size_of_signature; i++) {
+    h0 = signatures[0][i];
+    h1 = signatures[1][i];
+    d  += h0*h1;
+    d0 += h0*h0;
+    d1 += h1*h1;
+  }
+
+  return 1.0 - d/(d0+d1-d);
+}
+
+/* the ratio does not depend on the scale of values */
+double jaccard_q16(unsigned short **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+
+  int i;
+  double h0, h1;
+
+  double d = 0.0, d0 = 0.0, d1 = 0.0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  for(i=0; i<size_of_signature; i++) {
+    h0 = signatures[0][i];
+    h1 = signatures[1][i];
+    d  += h0*h1;
+    d0 += h0*h0;
+    d1 += h1*h1;
+  }
+
+  return 1.0 - d/(d0+d1-d);
+}
@@ -9,9 +9,13 @@
  *		for details.
  *
  *****************************************************************************/
+#include <stdlib.h>
+#include <limits.h>
 #include <math.h>
 #include <stdarg.h>
 
+#include "measures.h"
+
 double jensen_shannon(double **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
   double w = 1.0/(double)num_of_signatures;
   double sumE, sumH, entH, h;
@@ -46,3 +50,122 @@ double jensen_shannon(double **signatures, int num_of_signatures, int size_of_si
   return distance;
 }
 
+/* the same for sparse signatures, elements zero in all signatures add nothing */
+double jensen_shannon_sparse(sparse_signature **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  double w = 1.0/(double)num_of_signatures;
+  double sumE, sumH, entH, h;
+  int i, j, _pos[16];
+  int *pos = _pos;
+  double lg, distance = 0.0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  if(num_of_signatures>16)
+    pos = (int *)malloc(num_of_signatures*sizeof(int));
+  for(i=0; i<num_of_signatures; i++)
+    pos[i] = 0;
+
+  lg = 1.0/log(2);
+  
+  for(;;) {
+    j = INT_MAX;
+    for(i=0; i<num_of_signatures; i++)
+      if(pos[i]<signatures[i]->n && signatures[i]->idx[pos[i]]<j)
+        j = signatures[i]->idx[pos[i]];
+    if(j==INT_MAX) break;
+
+    sumH = 0.0;
+    sumE = 0.0;
+    for(i=0; i<num_of_signatures; i++) {
+      if(pos[i]>=signatures[i]->n || signatures[i]->idx[pos[i]]!=j) continue;
+      h=signatures[i]->val[pos[i]++];
+      if(h>0) {
+        sumH+=h;
+	sumE+=h*lg*log(h);
+      }
+    }
+    sumE *= w;
+    sumH *= w;
+
+    entH = (sumH==0)?0.0:sumH*lg*log(sumH);
+    distance +=sumE-entH;
+  }
+  if(pos != _pos)
+    free(pos);
+  if(num_of_signatures>2)
+    distance /= lg*log((double)num_of_signatures);
+
+  if(distance>1.0) distance = 1.0;
+  
+  return distance;
+}
+
+/* the same for float and quantized signatures */
+double jensen_shannon_float(float **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  double w = 1.0/(double)num_of_signatures;
+  double sumE, sumH, entH, h;
+  int i,j;
+  double lg, distance = 0.0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  lg = 1.0/log(2);
+  
+  for(j=0; j<size_of_signature; j++) {
+    sumH = 0.0;
+    sumE = 0.0;
+    for(i=0; i<num_of_signatures; i++) {
+      h=signatures[i][j];
+      if(h>0) {
+        sumH+=h;
+	sumE+=h*lg*log(h);
+      }
+    }
+    sumE *= w;
+    sumH *= w;
+
+    entH = (sumH==0)?0.0:sumH*lg*log(sumH);
+    distance +=sumE-entH;
+  }
+  if(num_of_signatures>2)
+    distance /= lg*log((double)num_of_signatures);
+
+  if(distance>1.0) distance = 1.0;
+  
+  return distance;
+}
+
+double jensen_shannon_q16(unsigned short **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  double w = 1.0/(double)num_of_signatures;
+  double s = 1.0/Q16_MAX;
+  double sumE, sumH, entH, h;
+  int i,j;
+  double lg, distance = 0.0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  lg = 1.0/log(2);
+  
+  for(j=0; j<size_of_signature; j++) {
+    sumH = 0.0;
+    sumE = 0.0;
+    for(i=0; i<num_of_signatures; i++) {
+      if(signatures[i][j]>0) {
+        h=s*signatures[i][j];
+        sumH+=h;
+	sumE+=h*lg*log(h);
+      }
+    }
+    sumE *= w;
+    sumH *= w;
+
+    entH = (sumH==0)?0.0:sumH*lg*log(sumH);
+    distance +=sumE-entH;
+  }
+  if(num_of_signatures>2)
+    distance /= lg*log((double)num_of_signatures);
+
+  if(distance>1.0) distance = 1.0;
+  
+  return distance;
+}
@@ -12,6 +12,8 @@
 #include <math.h>
 #include <stdarg.h>
 
+#include "measures.h"
+
 double triangular(double **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...)
 {
         /* distance */
@@ -31,3 +33,53 @@ double triangular(double **signatures, int num_of_signatures, int size_of_signat
         /* dist = 1-dist; */
         return dist;
 }
+
+double triangular_sparse(sparse_signature **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...)
+{
+        int i = 0, j = 0;
+        double h0, h1;
+        double dist     = 0.0;
+        double divisor  = 0.0;
+        
+        while(sparse_next_pair(signatures[0],signatures[1],&i,&j,&h0,&h1)) {
+                divisor = h0 + h1;
+                dist += (divisor>0)?(h0-h1)*(h0-h1)/divisor:0;
+        }
+        dist = fabs(dist/2.0);
+        return dist;
+}
+
+double triangular_float(float **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...)
+{
+        int i;
+        double h0, h1;
+        double dist     = 0.0;
+        double divisor  = 0.0;
+        
+        for(i=0; i<size_of_signature; i++) {
+                h0 = signatures[0][i];
+                h1 = signatures[1][i];
+                divisor = h0 + h1;
+                dist += (divisor>0)?(h0-h1)*(h0-h1)/divisor:0;
+        }
+        dist = fabs(dist/2.0);
+        return dist;
+}
+
+/* (a-b)^2/(a+b) scales linearly with values */
+double triangular_q16(unsigned short **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...)
+{
+        int i, divisor;
+        double p;
+        double dist     = 0.0;
+        
+        for(i=0; i<size_of_signature; i++) {
+                divisor = (int)signatures[0][i] + (int)signatures[1][i];
+                if(divisor>0) {
+                        p = (int)signatures[0][i] - (int)signatures[1][i];
+                        dist += p*p/divisor;
+                }
+        }
+        dist = fabs(dist/2.0)/Q16_MAX;
+        return dist;
+}
@@ -12,6 +12,8 @@
 #include <math.h>
 #include <stdarg.h>
 
+#include "measures.h"
+
 double wave_hedges(double **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
   int i;
 
@@ -37,3 +39,75 @@ double wave_hedges(double **signatures, int num_of_signatures, int size_of_signa
   return dist;
 }
 
+double wave_hedges_sparse(sparse_signature **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  int i = 0, j = 0;
+
+  double h0, h1;
+  double dist = 0.0;
+  double d    = 0.0;
+  int cnt_non_empty = 0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  while(sparse_next_pair(signatures[0],signatures[1],&i,&j,&h0,&h1)) {
+    d  = (h0<h1)?h1:h0;
+    if(d > 0) {
+      h0 = h0-h1;
+      dist += ((h0<0.0)?-h0:h0)/d;
+      cnt_non_empty++;
+    }
+  }
+
+  dist /= (double)cnt_non_empty;
+  return dist;
+}
+
+double wave_hedges_float(float **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  int i;
+
+  double h0, h1;
+  double dist = 0.0;
+  double d    = 0.0;
+  int cnt_non_empty = 0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  for(i=0; i<size_of_signature; i++) {
+    h0 = signatures[0][i];
+    h1 = signatures[1][i];
+    d  = (h0<h1)?h1:h0;
+    if(d > 0) {
+      h0 = h0-h1;
+      dist += ((h0<0.0)?-h0:h0)/d;
+      cnt_non_empty++;
+    }
+  }
+
+  dist /= (double)cnt_non_empty;
+  return dist;
+}
+
+/* ratios do not depend on the scale of values */
+double wave_hedges_q16(unsigned short **signatures, int num_of_signatures, int size_of_signature, int num_dims, int* dims, ...) {
+  int i;
+
+  int h0, h1, d;
+  double dist = 0.0;
+  int cnt_non_empty = 0;
+
+  if(num_of_signatures<2) return 0.0;
+
+  for(i=0; i<size_of_signature; i++) {
+    h0 = signatures[0][i];
+    h1 = signatures[1][i];
+    d  = (h0<h1)?h1:h0;
+    if(d > 0) {
+      h0 = h0-h1;
+      dist += (double)((h0<0)?-h0:h0)/d;
+      cnt_non_empty++;
+    }
+  }
+
+  dist /= (double)cnt_non_empty;
+  return dist;
+}
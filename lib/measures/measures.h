@@ -16,7 +16,47 @@
 
 typedef double distance_func(double**, int, int, int, int*, ...);
 
+/* not zero elements of a signature, indices in increasing order */
+typedef struct {
+  int n;
+  int *idx;
+  double *val;
+} sparse_signature;
+
+typedef double sparse_distance_func(sparse_signature**, int, int, int, int*, ...);
+
+/* 
+ * next element not zero in a or b, h0 and h1 are its values;
+ * i and j start from 0, returns 0 after the last element
+ */
+static inline int sparse_next_pair(sparse_signature *a, sparse_signature *b, int *i, int *j, double *h0, double *h1) {
+  if(*i>=a->n && *j>=b->n) return 0;
+  if(*j>=b->n || (*i<a->n && a->idx[*i]<b->idx[*j])) {
+    *h0 = a->val[(*i)++];
+    *h1 = 0.0;
+  } else if(*i>=a->n || b->idx[*j]<a->idx[*i]) {
+    *h0 = 0.0;
+    *h1 = b->val[(*j)++];
+  } else {
+    *h0 = a->val[(*i)++];
+    *h1 = b->val[(*j)++];
+  }
+  return 1;
+}
+
+/* 
+ * signatures stored as float and as unsigned short quantized to 
+ * the interval [0, 1], the value of q is q/Q16_MAX
+ */
+#define Q16_MAX 65535.0
+
+typedef double float_distance_func(float**, int, int, int, int*, ...);
+typedef double q16_distance_func(unsigned short**, int, int, int, int*, ...);
+
 distance_func *get_distance(char *distance_name);
+float_distance_func *get_float_distance(char *distance_name);
+q16_distance_func *get_q16_distance(char *distance_name);
+sparse_distance_func *get_sparse_distance(char *distance_name);
 char *get_distance_description(char *distance_name);
 char *list_all_distances();
 
@@ -28,6 +28,48 @@ distance_func *get_distance(char *distance_name) {
   return NULL;
 }
 
+/* NULL if the measure has no sparse version */
+sparse_distance_func *get_sparse_distance(char *distance_name) {
+  
+  measure_rec *p = measures_list;
+  
+  while(p->name != NULL) {
+    if(strcmp(distance_name,p->name)==0)
+      return p->sparse;
+    p++;
+  }
+  
+  return NULL;
+}
+
+/* NULL if the measure has no version for float signatures */
+float_distance_func *get_float_distance(char *distance_name) {
+  
+  measure_rec *p = measures_list;
+  
+  while(p->name != NULL) {
+    if(strcmp(distance_name,p->name)==0)
+      return p->flt;
+    p++;
+  }
+  
+  return NULL;
+}
+
+/* NULL if the measure has no version for quantized signatures */
+q16_distance_func *get_q16_distance(char *distance_name) {
+  
+  measure_rec *p = measures_list;
+  
+  while(p->name != NULL) {
+    if(strcmp(distance_name,p->name)==0)
+      return p->q16;
+    p++;
+  }
+  
+  return NULL;
+}
+
 char *get_distance_description(char *distance_name) {
   
   measure_rec *p = measures_list;
@@ -35,6 +35,32 @@ extern distance_func rozickap;
 extern distance_func hassanat;
 extern distance_func ardiff;
 
+/**
+* sparse versions
+*/
+extern sparse_distance_func jensen_shannon_sparse;
+extern sparse_distance_func wave_hedges_sparse;
+extern sparse_distance_func triangular_sparse;
+extern sparse_distance_func euclidean_sparse;
+extern sparse_distance_func euclidean_norm_sparse;
+extern sparse_distance_func jaccard_sparse;
+
+/**
+* float and quantized versions
+*/
+extern float_distance_func jensen_shannon_float;
+extern float_distance_func wave_hedges_float;
+extern float_distance_func triangular_float;
+extern float_distance_func euclidean_float;
+extern float_distance_func euclidean_norm_float;
+extern float_distance_func jaccard_float;
+extern q16_distance_func jensen_shannon_q16;
+extern q16_distance_func wave_hedges_q16;
+extern q16_distance_func triangular_q16;
+extern q16_distance_func euclidean_q16;
+extern q16_distance_func euclidean_norm_q16;
+extern q16_distance_func jaccard_q16;
+
 /**
 * distances of 2 time series
 */
@@ -48,15 +74,24 @@ typedef struct {
         char *name;
         distance_func *dist;
         char *description;
+        sparse_distance_func *sparse;
+        float_distance_func *flt;
+        q16_distance_func *q16;
 } measure_rec;
 
 measure_rec measures_list[] = {
-        { "jsd",  jensen_shannon, "Jensen Shannon Divergence" },
-        { "tri",  triangular, "Triangular"},
-        { "euc",  euclidean,      "Euclidean distance" },
-        { "eucn", euclidean_norm, "Normalized euclidean distance" },
-        { "wh",   wave_hedges,    "Wave-Hedges distance" },
-        { "jac",  jaccard,        "Jaccard distance" },
+        { "jsd",  jensen_shannon, "Jensen Shannon Divergence", jensen_shannon_sparse,
+          jensen_shannon_float, jensen_shannon_q16 },
+        { "tri",  triangular, "Triangular", triangular_sparse,
+          triangular_float, triangular_q16 },
+        { "euc",  euclidean,      "Euclidean distance", euclidean_sparse,
+          euclidean_float, euclidean_q16 },
+        { "eucn", euclidean_norm, "Normalized euclidean distance", euclidean_norm_sparse,
+          euclidean_norm_float, euclidean_norm_q16 },
+        { "wh",   wave_hedges,    "Wave-Hedges distance", wave_hedges_sparse,
+          wave_hedges_float, wave_hedges_q16 },
+        { "jac",  jaccard,        "Jaccard distance", jaccard_sparse,
+          jaccard_float, jaccard_q16 },
         /*************************
          *
          *   Experimental code
@@ -73,7 +108,7 @@ measure_rec measures_list[] = {
         { "tsDTW",   tsDTW,       "time series - Dynamic Time Warping distance" },
         { "tsDTWP",  tsDTWP,      "time series - Periodic Dynamic Time Warping distance" },
         { "tsDTWPa", tsDTWPa,     "time series - Synchoronized Dynamic Time Warping distance" },
-        { NULL, NULL, NULL }
+        { NULL, NULL, NULL, NULL, NULL, NULL }
 };
 
 #endif
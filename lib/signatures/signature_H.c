@@ -9,15 +9,14 @@
  *		for details.
  *
  *****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "../../lib/ezGDAL/ezgdal.h"
 #include <assert.h>
 #include <stdarg.h>
 
 
-#define SIGNATURE_H_MAX_N 409600
-
-
 /**
  * The signature contains 3 columns:
  * 1 - entropy
@@ -27,70 +26,94 @@
 
 
 
-typedef struct  {
-  int id;
-  int count;
-} SIGNATURE_H_ELEMENT;
+/* entropy signature from the counts of categories, categories are
+   summed in the order of their indices (also used by the integral
+   histograms, see signatures_integral.c) */
+void H_from_counts(unsigned int *counts, int ncats, double *signature) {
+  int i, N, N_elements;
+  double sum, x, w;
 
-void insert_cell(SIGNATURE_H_ELEMENT *elements, int *N, int id) {
-  int i;
-  
-  for(i=0; i<(*N); i++)
-    if(elements[i].id == id) {
-      elements[i].count++;
-      return;
+  N = 0;
+  N_elements = 0;
+  for(i=0; i<ncats; i++)
+    if(counts[i] > 0) {
+      N += counts[i];
+      N_elements++;
     }
 
-  assert(*N<SIGNATURE_H_MAX_N);
+  signature[1] = N_elements;
+  signature[2] = N; 
 
-  elements[*N].id = id;
-  elements[*N].count = 1;
-  (*N)++;
+  w = (double)1.0/(double)N;
+  sum = 0.0;
+  for(i=0; i<ncats; i++)
+    if(counts[i] > 0) {
+      x = w*counts[i];
+      sum -= x*log(x);
+    }
+  sum /= log(2);
+  
+  signature[0] = sum;
 }
 
 
+/* counts of categories, one buffer for every thread, kept between calls */
+static unsigned int *H_counts = NULL;
+static int H_counts_len = 0;
+#pragma omp threadprivate(H_counts, H_counts_len)
+
+/* frees the counts of every thread, the number of threads
+   has to be the same as in the calls of H() */
+void H_free(void) {
+#pragma omp parallel
+  {
+    free(H_counts);
+    H_counts = NULL;
+    H_counts_len = 0;
+  }
+}
+
 int H(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signature_len, ...) {
-  int N, i, N_elements;
   int r, c, rows, cols;
-  double **buf, sum, x, w;
-  SIGNATURE_H_ELEMENT *elements = calloc(SIGNATURE_H_MAX_N,sizeof(SIGNATURE_H_ELEMENT));
-  EZGDAL_LAYER *l = frames[0]->owner.frameset->layer;
-  
+  int cat;
+  EZGDAL_LAYER *l = frames[0]->owner.stripe->layer;
+  int ncats;
+  unsigned int *counts;
+
+  if(l->stats == NULL) {
+    memset(signature, 0, signature_len*sizeof(double));
+    return 0;
+  }
+  ncats = l->stats->map_max_val+1;
+
+  if(ncats > H_counts_len) {
+    free(H_counts);
+    H_counts = malloc(ncats*sizeof(unsigned int));
+    H_counts_len = ncats;
+  }
+  counts = H_counts;
+  memset(counts, 0, ncats*sizeof(unsigned int));
   
-  N = 0;
-  N_elements = 0;
   rows = frames[0]->rows;
   cols = frames[0]->cols;
-  buf = frames[0]->buffer;
   
   for(r=0; r<rows; r++)
-    for(c=0; c<cols; c++) 
-      if(!ezgdal_is_null(l,buf[r][c])) {
-        insert_cell(elements, &N_elements, (int)buf[r][c]);
-        N++;
+    if(ezgdal_frame_nulls(frames[0]) >= 0) {
+      /* null runs are skipped with the validity bitmask */
+      for(c=ezgdal_frame_next_valid(frames[0],r,0); c<cols; c=ezgdal_frame_next_valid(frames[0],r,c+1)) {
+        cat = ezgdal_frame_get_cat(frames[0],r,c);
+        if(cat>=0)
+          counts[cat]++;
+      }
+    } else
+      for(c=0; c<cols; c++) {
+        cat = ezgdal_frame_get_cat(frames[0],r,c);
+        if(cat>=0)
+          counts[cat]++;
       }
 
-  signature[1] = N_elements;
-  signature[2] = N; 
+  H_from_counts(counts, ncats, signature);
 
-/*
-  if(2*N < cols * rows) {
-    free(elements);
-  signature[3] = 1;
-    return 0;
-  }
-*/
-  w = (double)1.0/(double)N;
-  sum = 0.0;
-  for(i=0; i<N_elements; i++) {
-    x = w*elements[i].count;
-    sum -= x*log(x);
-  }
-  sum /= log(2);
-  
-  signature[0] = sum;
-  
-  free(elements);
   return 1;
 }
 
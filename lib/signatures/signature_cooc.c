@@ -27,9 +27,7 @@ int triangular_index(int r, int c) {
 
 int coocurrence(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signature_len, ...) {
   int i, r, c, cat1, cat2, N, cols, rows;
-  EZGDAL_LAYER *l;
   EZGDAL_FRAME *f;
-  double v;
 
   for(i=0; i<signature_len; i++)
     signature[i]=0.0;
@@ -37,35 +35,25 @@ int coocurrence(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int
 
   f = frames[0];
   N = 0;
-  l = f->owner.stripe->layer;
   cols = f->cols;
   rows = f->rows;
 
   for(r=0; r<rows-1; r++) {
     for(c=0; c<cols-1; c++) {
 
-      v = f->buffer[r][c];
-      if(!ezgdal_is_null(l,v)) {
+      cat1 = ezgdal_frame_get_cat(f, r, c);
+      if(cat1>=0) {
 
-        cat1 = ezgdal_get_value_index(l, v);
-        assert(cat1>=0);
-
-        v = f->buffer[r+1][c];
-        if(!ezgdal_is_null(l,v)) {
-
-          cat2 = ezgdal_get_value_index(l, v);
-          assert(cat2>=0);
+        cat2 = ezgdal_frame_get_cat(f, r+1, c);
+        if(cat2>=0) {
 
           i = triangular_index(cat1,cat2);
           signature[i]+=1.0;
           N++;
         }
 
-        v = f->buffer[r][c+1];
-        if(!ezgdal_is_null(l,v)) {
-
-          cat2 = ezgdal_get_value_index(l, v);
-          assert(cat2>=0);
+        cat2 = ezgdal_frame_get_cat(f, r, c+1);
+        if(cat2>=0) {
 
           i = triangular_index(cat1,cat2);
           assert(i>=0 && i<signature_len);
@@ -78,17 +66,11 @@ int coocurrence(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int
 
   for(r=0; r<rows-1; r++) {
 
-    v = f->buffer[r][cols-1];
-    if(!ezgdal_is_null(l,v)) {
-
-      cat1 = ezgdal_get_value_index(l, v);
-      assert(cat1>=0);
+    cat1 = ezgdal_frame_get_cat(f, r, cols-1);
+    if(cat1>=0) {
 
-      v = f->buffer[r+1][cols-1];
-      if(!ezgdal_is_null(l,v)) {
-
-        cat2 = ezgdal_get_value_index(l, v);
-        assert(cat2>=0);
+      cat2 = ezgdal_frame_get_cat(f, r+1, cols-1);
+      if(cat2>=0) {
 
         i = triangular_index(cat1,cat2);
         signature[i]+=1.0;
@@ -99,17 +81,11 @@ int coocurrence(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int
 
   for(c=0; c<cols-1; c++) {
 
-    v = f->buffer[rows-1][c];
-    if(!ezgdal_is_null(l,v)) {
-
-      cat1 = ezgdal_get_value_index(l, v);
-      assert(cat1>=0);
-
-      v = f->buffer[rows-1][c+1];
-      if(!ezgdal_is_null(l,v)) {
+    cat1 = ezgdal_frame_get_cat(f, rows-1, c);
+    if(cat1>=0) {
 
-        cat2 = ezgdal_get_value_index(l, v);
-        assert(cat2>=0);
+      cat2 = ezgdal_frame_get_cat(f, rows-1, c+1);
+      if(cat2>=0) {
 
         i = triangular_index(cat1,cat2);
         signature[i]+=1.0;
@@ -47,11 +47,11 @@ int decompose_area(EZGDAL_LAYER* layer, EZGDAL_FRAME* f, DC_PARAMS* p, int row,
 		for(c=0;c<p->dc_region_size;++c) {
 			er=r+row;
 			ec=c+col;
-			if(ezgdal_is_null(layer, f->buffer[er][ec])){
+			category=ezgdal_frame_get_cat(f, er, ec);
+			if(category<0){
 				nulls+=1;
 				continue;
 			}
-			category=ezgdal_get_value_index(layer, f->buffer[er][ec]);
 			th_coarse[category]++;
 
 			fine_index=(r/size_of_fine_quad)*decomp_level+(c/size_of_fine_quad); /* integer division to determine sub-region */
@@ -44,7 +44,7 @@ int get_size_division(int num, int quad_area, int num_of_size_divisions)
 int full_decompose_area(EZGDAL_LAYER* layer, EZGDAL_FRAME* f, DC_PARAMS* p, int row, int col, double *signature)
 {
 	int q,k,l,r,c,er,ec;
-	int category,cat_index,quad_index,index;
+	int cat_index,quad_index,index;
 	int num_of_quads_at_level;
 	int total_quads_at_level;
 	int quad_size_at_level;
@@ -63,12 +63,11 @@ int full_decompose_area(EZGDAL_LAYER* layer, EZGDAL_FRAME* f, DC_PARAMS* p, int
 		for(c=0;c<p->dc_region_size;++c) {
 			er=r+row;
 			ec=c+col;
-			category = (int)(f->buffer[er][ec]);
-			if(ezgdal_is_null(layer, f->buffer[er][ec])){
+			cat_index = ezgdal_frame_get_cat(f, er, ec);
+			if(cat_index<0){
 				nulls++;
 				continue;
 			}
-			cat_index=ezgdal_get_value_index(layer, category);
 			/* update quad's histogram at each level */
 			for(l=0;l<p->dc_level;++l){
 				quad_size_at_level=p->dc_base_size*(int)pow(2,l);
@@ -168,6 +167,10 @@ int full_decomposition(EZGDAL_FRAME **frames, int num_of_frames, double *signatu
 
 	/* round to value divided by REGION_SIZE */
 
+	/* the signature is accumulated, the buffer may keep a previous motifel */
+	for(r=0;r<signature_len;++r)
+		signature[r]=0.0;
+
 	nrows=f->rows - p->dc_region_size + 1;
 	ncols=f->cols - p->dc_region_size + 1;
 
@@ -27,16 +27,13 @@ int jcov_triangular_index(int r, int c) {
 
 int jcov(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signature_len, ...) {
   int i, r, c, cat1, cat2, cols, rows;
-  EZGDAL_LAYER *l;
   EZGDAL_FRAME *f;
-  double v;
   double *sx, *sy, *ssx, *ssy;
   int *N, sumN;
   double wx, wy, x, y;
   int cx, cy, len;
 
   f = frames[0];
-  l = f->owner.stripe->layer;
   cols = f->cols;
   rows = f->rows;
   len = signature_len/2;
@@ -54,18 +51,11 @@ int jcov(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signat
   for(r=0; r<rows-1; r++) {
     for(c=0; c<cols-1; c++) {
 
-      v = f->buffer[r][c];
-      if(!ezgdal_is_null(l,v)) {
+      cat1 = ezgdal_frame_get_cat(f, r, c);
+      if(cat1>=0) {
 
-        cat1 = ezgdal_get_value_index(l, v);
-        assert(cat1>=0);
-
-        v = f->buffer[r+1][c];
-        if(!ezgdal_is_null(l,v)) {
-
-
-          cat2 = ezgdal_get_value_index(l, v);
-          assert(cat2>=0);
+        cat2 = ezgdal_frame_get_cat(f, r+1, c);
+        if(cat2>=0) {
 
           i = jcov_triangular_index(cat1,cat2);
           x = wx*(c-cx);
@@ -77,11 +67,8 @@ int jcov(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signat
           N[i]++;
         }
 
-        v = f->buffer[r][c+1];
-        if(!ezgdal_is_null(l,v)) {
-
-          cat2 = ezgdal_get_value_index(l, v);
-          assert(cat2>=0);
+        cat2 = ezgdal_frame_get_cat(f, r, c+1);
+        if(cat2>=0) {
           i = jcov_triangular_index(cat1,cat2);
           x = wx*(c-cx+0.5);
           y = wy*(r-cy);
@@ -97,17 +84,11 @@ int jcov(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signat
 
   for(r=0; r<rows-1; r++) {
 
-    v = f->buffer[r][cols-1];
-    if(!ezgdal_is_null(l,v)) {
+    cat1 = ezgdal_frame_get_cat(f, r, cols-1);
+    if(cat1>=0) {
 
-      cat1 = ezgdal_get_value_index(l, v);
-      assert(cat1>=0);
-
-      v = f->buffer[r+1][cols-1];
-      if(!ezgdal_is_null(l,v)) {
-
-        cat2 = ezgdal_get_value_index(l, v);
-        assert(cat2>=0);
+      cat2 = ezgdal_frame_get_cat(f, r+1, cols-1);
+      if(cat2>=0) {
 
         i = jcov_triangular_index(cat1,cat2);
         x = wx*(c-cx);
@@ -123,17 +104,11 @@ int jcov(EZGDAL_FRAME **frames, int num_of_frames, double *signature, int signat
 
   for(c=0; c<cols-1; c++) {
 
-    v = f->buffer[rows-1][c];
-    if(!ezgdal_is_null(l,v)) {
-
-      cat1 = ezgdal_get_value_index(l, v);
-      assert(cat1>=0);
-
-      v = f->buffer[rows-1][c+1];
-      if(!ezgdal_is_null(l,v)) {
+    cat1 = ezgdal_frame_get_cat(f, rows-1, c);
+    if(cat1>=0) {
 
-        cat2 = ezgdal_get_value_index(l, v);
-        assert(cat2>=0);
+      cat2 = ezgdal_frame_get_cat(f, rows-1, c+1);
+      if(cat2>=0) {
 
         i = jcov_triangular_index(cat1,cat2);
         x = wx*(c-cx+0.5);
@@ -334,7 +334,7 @@ char* get_index_name(int number)
 
 void li_set_params_all(H_PARAMS* p, EZGDAL_LAYER* l, int eight_flag){
 	/* eight_flag: 0 - 4-neighborhood; 1 - 8-neighborhood */
-	int count,i,j;
+	int count,i;
 
 	p->eight_flag = eight_flag;
 	/* pick all class level */
@@ -349,10 +349,8 @@ void li_set_params_all(H_PARAMS* p, EZGDAL_LAYER* l, int eight_flag){
 		}
 	p->num_of_classes=l->stats->map_max_val+1;
 	p->classes=malloc(p->num_of_classes*sizeof(int));
-	j=0;
-	for(i=0; i<l->stats->hist_N; i++)
-		if(l->stats->map_cat[i] >= 0)
-			p->classes[j++] = i + (int)(l->stats->min);
+	for(i=0; i<p->num_of_classes; i++)
+		p->classes[i] = (int)ezgdal_get_index_value(l,i);
 
 	/* pick all landscape level */
 	p->li_land_flags=calloc(num_of_indices,sizeof(int)); // init to 0
@@ -370,7 +368,7 @@ void li_set_params_all(H_PARAMS* p, EZGDAL_LAYER* l, int eight_flag){
 /* sets parameters for computing only composition and all landscape level indices */
 void li_set_params_short(H_PARAMS* p, EZGDAL_LAYER* l, int eight_flag){
 	/* eight_flag: 0 - 4-neighborhood; 1 - 8-neighborhood */
-	int count,i,j;
+	int count,i;
 
 	p->eight_flag = eight_flag;
 	/* pick all class level */
@@ -385,10 +383,8 @@ void li_set_params_short(H_PARAMS* p, EZGDAL_LAYER* l, int eight_flag){
 	}
 	p->num_of_classes=l->stats->map_max_val+1;
 	p->classes=malloc(p->num_of_classes*sizeof(int));
-	j=0;
-	for(i=0; i<l->stats->hist_N; i++)
-		if(l->stats->map_cat[i] >= 0)
-			p->classes[j++] = i + (int)(l->stats->min);
+	for(i=0; i<p->num_of_classes; i++)
+		p->classes[i] = (int)ezgdal_get_index_value(l,i);
 
 	/* pick all landscape level */
 	p->li_land_flags=calloc(num_of_indices,sizeof(int)); // init to 0
@@ -26,7 +26,6 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 	int pos;
 	int cat, target_cat;
 	unsigned long int curr_clump=0;
-	double** map; /* input map */
 	unsigned long int* map_clump; /* clump map */
 	long int* queue = NULL;
 	LI_LANDSCAPE land_stats;
@@ -47,10 +46,8 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 	/* read map categories */
 	map_cats.num = l->stats->map_max_val+1;
 	map_cats.cat=malloc(map_cats.num*sizeof(int));
-	j=0;
-	for(i=0; i<(int)l->stats->hist_N; i++)
-		if(l->stats->map_cat[i] >= 0)
-			map_cats.cat[j++] = i + (int)(l->stats->min);
+	for(i=0; i<map_cats.num; i++)
+		map_cats.cat[i] = (int)ezgdal_get_index_value(l,i);
 
 	/* SET HARDCODED PARAMETERS FOR INDICES */
 	/* 0 - 4-neighborhood; 1 - 8-neighborhood */
@@ -60,11 +57,6 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 	nrows = f->rows;
 	ncols = f->cols;
 
-	/* set easy-to-use input map buffer */
-	map = malloc(nrows * sizeof(double*));
-	for(row=0; row<nrows; ++row)
-		map[row] = &(f->buffer[row][0]);
-
 	/* allocate clump map */
 	map_clump = calloc(nrows*ncols, sizeof(unsigned long int)); // calloc initializes to 0
 	queue = malloc(4*nrows*ncols*sizeof(long int));
@@ -83,14 +75,14 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 	for(row=0; row<nrows; ++row){
 		for(col=0; col<ncols; ++col){
 			land_stats.total_area+=res_area;
-			if(map_clump[row*ncols+col] || ezgdal_is_null(l, map[row][col]))
+			if(map_clump[row*ncols+col] || ezgdal_frame_get_cat(f, row, col)<0)
 				continue; // already clumped or null value or not in the circle
 
 			curr_clump++;
 			last=1;
 			first=0;
 			queue[0]=INDEX(row,col);
-			clump_stats = li_add_clump(clump_stats, &land_stats, curr_clump, (int)map[row][col], row, col);
+			clump_stats = li_add_clump(clump_stats, &land_stats, curr_clump, map_cats.cat[ezgdal_frame_get_cat(f, row, col)], row, col);
 			cat = clump_stats[curr_clump].category;
 
 			do {
@@ -101,7 +93,7 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 				c=index%ncols;
 				/* update clump and landscape area statistics */
 				map_clump[index] = curr_clump;
-				li_update_clump(clump_stats, &land_stats, curr_clump, (int)map[r][c], r, c, res_area, p->eight_flag);
+				li_update_clump(clump_stats, &land_stats, curr_clump, map_cats.cat[ezgdal_frame_get_cat(f, r, c)], r, c, res_area, p->eight_flag);
 
 				/* check neighbors */
 				for(i=start;i<9;i+=increment) {
@@ -113,9 +105,9 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 							clump_stats[curr_clump].perimeter+=resolution;
 						continue;
 					}
-					target_cat = (int)map[next_r][next_c];
+					target_cat = ezgdal_frame_get_cat(f, next_r, next_c);
 					
-					if(ezgdal_is_null(l, (double)target_cat)) {
+					if(target_cat<0) {
 						if(IS_FOUR_CONN(i)){
 							clump_stats[curr_clump].perimeter+=resolution;
 							land_stats.total_edge+=resolution;
@@ -123,6 +115,7 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 						}
 						continue;
 					}
+					target_cat = map_cats.cat[target_cat];
 
 					target=INDEX(next_r,next_c);
 
@@ -153,7 +146,6 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 		li_contig(map_clump, clump_stats, land_stats.total_clumps, nrows, ncols, resolution);
 	
 	if(land_stats.notnull_area==0){ /* no data for the landscape */
-		free(map);
 		free(map_clump);
 		free(queue);
 		free(clump_stats);
@@ -192,7 +184,6 @@ int landind_short(EZGDAL_FRAME **frames, int num_of_frames, double *signature, i
 		}
 	}
 
-	free(map);
 	free(map_clump);
 	free(queue);
 	free(clump_stats);
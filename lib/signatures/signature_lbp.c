@@ -36,13 +36,13 @@ int lbp(EZGDAL_LAYER *l, EZGDAL_FRAME *f, int r, int c) {
   double v,v1;
   int i, b;
 
-  v = f->buffer[r][c];
-  if(ezgdal_is_null(l,v)) return -1;
+  if(ezgdal_frame_is_null(f, r, c)) return -1;
+  v = ezgdal_frame_value(f, r, c);
 
   b=0;
   for(i=0; i<8; i++) {
-    v1 = f->buffer[r+direction[i][0]][c+direction[i][1]];
-    if(ezgdal_is_null(l,v1)) return -1;
+    if(ezgdal_frame_is_null(f, r+direction[i][0], c+direction[i][1])) return -1;
+    v1 = ezgdal_frame_value(f, r+direction[i][0], c+direction[i][1]);
     if(v>v1) b=b | 1<<i;
   }
 
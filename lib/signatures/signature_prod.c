@@ -18,7 +18,6 @@ int cartesianproduct(EZGDAL_FRAME **frames, int num_of_frames, double *signature
   int i, r, c, mx, ct, cat, N;
   EZGDAL_LAYER *l;
   EZGDAL_FRAME *f;
-  double v;
   int cell_null = FALSE;
 
   for(i=0; i<signature_len; i++)
@@ -32,23 +31,19 @@ int cartesianproduct(EZGDAL_FRAME **frames, int num_of_frames, double *signature
   for(r=0; r<f->rows; r++) 
     for(c=0; c<f->cols; c++) {
 
-      v = f->buffer[r][c];
-      cell_null = ezgdal_is_null(l,v);
+      cat = ezgdal_frame_get_cat(f, r, c);
+      cell_null = (cat<0);
 
       if(!cell_null) {
 
-        cat = ezgdal_get_value_index(l, v);
-        assert(cat>=0);
         for(i=num_of_frames-1; i>0; i--) {
 
-          v = frames[i]->buffer[r][c];
-          cell_null = cell_null || ezgdal_is_null(l,v);
+          ct = ezgdal_frame_get_cat(frames[i], r, c);
+          cell_null = cell_null || (ct<0);
           if(!cell_null) {
             l = frames[i]->owner.stripe->layer;
             mx = l->stats->map_max_val;
             cat*=mx;
-            ct = ezgdal_get_value_index(l, v);
-            assert(ct>=0);
             cat+=ct;
           }
         }
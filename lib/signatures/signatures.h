@@ -19,9 +19,120 @@
 typedef int signature_func(EZGDAL_FRAME**, int, double*, int, ...);
 typedef int signature_len_func(EZGDAL_LAYER**, int, ...);
 
+/* additive histograms, which can be calculated by the integral histograms */
+typedef enum {
+  SIGNATURE_INTEGRAL_NONE = 0,
+  SIGNATURE_INTEGRAL_CELLS,     /* categories of cells (prod) */
+  SIGNATURE_INTEGRAL_PAIRS,     /* pairs of adjacent cells (cooc) */
+  SIGNATURE_INTEGRAL_ENTROPY    /* categories of the first layer (ent) */
+} SIGNATURE_INTEGRAL_TYPE;
+
+/*
+ * Integral histograms of a row of overlapping motifels. Columns of
+ * the stripes are split into blocks of gcd(size,shift) columns and
+ * counts of the blocks are summed from the left, so the histogram
+ * of a motifel is a difference of two sums instead of a pass over
+ * all its cells.
+ * In the sliding mode (no block sums) every thread keeps counts of
+ * its last motifel and moves them to the next one, adding columns
+ * coming in on the right and subtracting those leaving on the left.
+ */
+typedef struct {
+  SIGNATURE_INTEGRAL_TYPE type;
+  EZGDAL_LAYER **layers;
+  int num_of_layers;
+  int size, shift;
+  int block;                /* columns in a block */
+  int blocks;
+  int frames;
+  int bins;                 /* length of the histogram */
+  int signature_len;
+  unsigned int *prefix;     /* (blocks+1) x bins, counts of blocks 0..j-1 */
+  unsigned int *border;     /* blocks x bins, pairs crossing borders 1..j */
+  unsigned int *counts;     /* bins for every thread */
+  int is_sliding;
+  int *last_frame;          /* sliding mode: frame of counts of every thread */
+  int *last_row1;           /* and the stripe row of them */
+  EZGDAL_FRAME **frame_lists;  /* num_of_layers frames for every thread */
+} SIGNATURE_INTEGRAL;
+
+/*
+ * Pyramid of additive histograms. Histograms of square blocks of 
+ * a raster are counted once (blocks are frames of stripes of size 
+ * and shift block) and histograms of motifels of any size and shift 
+ * being multiples of block are summed from them. A ring of block rows 
+ * is kept, enough for the largest motifels.
+ */
+typedef struct {
+  SIGNATURE_INTEGRAL_TYPE type;
+  EZGDAL_LAYER **layers;
+  int num_of_layers;
+  int block;                /* columns and rows in a block */
+  int cols;                 /* blocks in a row */
+  int rows;                 /* block rows in the ring */
+  int row;                  /* block rows counted */
+  int bins;
+  int signature_len;
+  unsigned int *cells;      /* rows x cols x bins, cells or pairs inside blocks */
+  unsigned int *left;       /* pairs crossing the left border of blocks */
+  unsigned int *top;        /* pairs crossing the top border of blocks */
+  long *nulls;              /* rows x cols, null cells of the first layer */
+  int *last_row;            /* categories of the last raster row counted */
+  int levels;
+  unsigned int **sums;      /* every level: 3 x (cols+1) x bins sums of a row of motifels */
+  long **null_sums;         /* every level: (cols+1) */
+  unsigned int *counts;     /* bins for every thread */
+  EZGDAL_FRAME **frame_lists;  /* num_of_layers frames for every thread */
+} SIGNATURE_PYRAMID;
+
+/* the same as normalization_func of the normalization library */
+typedef int signature_norm_func(double*, int);
+
+/*
+ * Several signatures of the same motifels. Frames are loaded once
+ * and every signature of the set is calculated from them and
+ * normalized by its own method.
+ */
+typedef struct {
+  int signatures;
+  char **names;
+  signature_func **signature;
+  signature_norm_func **normalization;
+  int *num_of_frames;       /* prod uses all layers, others the first one */
+  int *signature_len;
+  int *offset;              /* of signatures in the concatenated vector */
+  int len;                  /* length of the concatenated vector */
+  int level;                /* full decomposition level */
+  SIGNATURE_INTEGRAL **integral;  /* NULL - calculated from frames */
+  int is_sliding;
+} SIGNATURE_SET;
+
 signature_func *get_signature(char *signature_name);
 signature_len_func *get_signature_len(char *signature_name);
 char *get_signature_description(char *signature_name);
+int is_signature_categorical(char *signature_name);
 char *list_all_signatures();
+void H_free(void);
+int get_signature_integral_type(char *signature_name);
+
+SIGNATURE_INTEGRAL *signature_integral_create(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len);
+SIGNATURE_INTEGRAL *signature_sliding_create(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len);
+void signature_integral_free(SIGNATURE_INTEGRAL *ih);
+void signature_integral_load(SIGNATURE_INTEGRAL *ih);
+int signature_integral_get(SIGNATURE_INTEGRAL *ih, int frame, double *signature);
+
+SIGNATURE_PYRAMID *signature_pyramid_create(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len, int max_size, int levels);
+void signature_pyramid_free(SIGNATURE_PYRAMID *py);
+void signature_pyramid_load(SIGNATURE_PYRAMID *py);
+int signature_pyramid_sum(SIGNATURE_PYRAMID *py, int level, int row1, int size);
+int signature_pyramid_get(SIGNATURE_PYRAMID *py, int level, int col1, int size, double *signature);
+
+SIGNATURE_SET *signature_set_create(char **signature_names, signature_norm_func **normalizations,
+                                    int signatures, EZGDAL_LAYER **layers, int num_of_layers, int level);
+void signature_set_free(SIGNATURE_SET *set);
+int signature_set_integrals(SIGNATURE_SET *set, EZGDAL_LAYER **layers);
+void signature_set_load(SIGNATURE_SET *set);
+int signature_set_calc(SIGNATURE_SET *set, EZGDAL_FRAME **frames, int frame,
+                       double **signatures, int *results);
 
 #endif
@@ -0,0 +1,629 @@
+/****************************************************************************
+ *
+ * MODULE:	Signatures library - integral histograms
+ * AUTHOR(S):	Pawel Netzel
+ * PURPOSE:	prod, cooc and ent signatures of overlapping motifels
+ *		of a stripe calculated from summed block histograms
+ *		or from histograms sliding along the stripe
+ * COPYRIGHT:	(C) Space Informatics Lab, Univeristy of Cincinnati
+ *
+ *		This program is free software under the GNU General Public
+ *		License (>=v2). Read the file COPYING that comes with GRASS
+ *		for details.
+ *
+ *****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <omp.h>
+
+#include "signatures.h"
+
+/* limits of memory used by block sums and by the pyramid */
+#define SIGNATURE_INTEGRAL_MAX_BYTES (512L*1024L*1024L)
+#define SIGNATURE_PYRAMID_MAX_BYTES (2048L*1024L*1024L)
+
+extern int triangular_index(int r, int c);
+extern void H_from_counts(unsigned int *counts, int ncats, double *signature);
+
+static int gcd(int a, int b) {
+  int t;
+
+  while(b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* frame of the layer covering the column p of a stripe row and the
+   column of p in the frame; p is relative to the first frame */
+static EZGDAL_FRAME *frame_at(SIGNATURE_INTEGRAL *ih, int layer, int p, int *col) {
+  int f = p / ih->shift;
+
+  if(f > ih->frames-1) f = ih->frames-1;
+  *col = p - f*ih->shift;
+  return &(ih->layers[layer]->stripe->frame[f]);
+}
+
+/* category of the cartesian product, the same as in cartesianproduct():
+   categories are combined up to the first layer with a null cell */
+static int product_cat(EZGDAL_LAYER **layers, int num_of_layers, EZGDAL_FRAME **f, int r, int c) {
+  int i, ct, cat;
+
+  cat = ezgdal_frame_get_cat(f[0], r, c);
+  if(cat<0) return -1;
+  for(i=num_of_layers-1; i>0; i--) {
+    ct = ezgdal_frame_get_cat(f[i], r, c);
+    if(ct<0) break;
+    cat *= layers[i]->stats->map_max_val;
+    cat += ct;
+  }
+  return cat;
+}
+
+/* 
+ * Adds inc (1 or -1 wrapped) to counts of cells of columns p1 .. p2-1, 
+ * for pairs: vertical pairs of these columns and horizontal pairs 
+ * starting in columns h1 .. h2-1. Ranges are split between frames at
+ * shift, so the second cell of a pair is in the same frame as the first.
+ */
+static void add_cols(SIGNATURE_INTEGRAL *ih, int p1, int p2, int h1, int h2, 
+                     EZGDAL_FRAME **f, unsigned int *counts, unsigned int inc) {
+  int i, r, c, c1, c2, p, cat1, cat2;
+
+  for(p=p1; p<p2; p+=c2-c1) {
+    f[0] = frame_at(ih, 0, p, &c1);
+    for(i=1; i<ih->num_of_layers; i++)
+      f[i] = frame_at(ih, i, p, &c2);
+    c2 = c1 + (p2-p);
+    if(c1 < ih->shift && c2 > ih->shift)
+      c2 = ih->shift;
+
+    switch(ih->type) {
+      case SIGNATURE_INTEGRAL_CELLS:
+        for(r=0; r<ih->size; r++)
+          for(c=c1; c<c2; c++) {
+            cat1 = product_cat(ih->layers, ih->num_of_layers, f, r, c);
+            if(cat1>=0) {
+              assert(cat1<ih->bins);
+              counts[cat1] += inc;
+            }
+          }
+        break;
+
+      case SIGNATURE_INTEGRAL_PAIRS:
+        for(r=0; r<ih->size-1; r++)
+          for(c=c1; c<c2; c++) {
+            cat1 = ezgdal_frame_get_cat(f[0], r, c);
+            if(cat1<0) continue;
+            cat2 = ezgdal_frame_get_cat(f[0], r+1, c);
+            if(cat2>=0)
+              counts[triangular_index(cat1,cat2)] += inc;
+          }
+        break;
+
+      case SIGNATURE_INTEGRAL_ENTROPY:
+        for(r=0; r<ih->size; r++)
+          for(c=c1; c<c2; c++) {
+            cat1 = ezgdal_frame_get_cat(f[0], r, c);
+            if(cat1>=0)
+              counts[cat1] += inc;
+          }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  if(ih->type != SIGNATURE_INTEGRAL_PAIRS) return;
+
+  for(p=h1; p<h2; p+=c2-c1) {
+    f[0] = frame_at(ih, 0, p, &c1);
+    c2 = c1 + (h2-p);
+    if(c1 < ih->shift && c2 > ih->shift)
+      c2 = ih->shift;
+    for(r=0; r<ih->size; r++)
+      for(c=c1; c<c2; c++) {
+        cat1 = ezgdal_frame_get_cat(f[0], r, c);
+        if(cat1<0) continue;
+        cat2 = ezgdal_frame_get_cat(f[0], r, c+1);
+        if(cat2>=0)
+          counts[triangular_index(cat1,cat2)] += inc;
+      }
+  }
+}
+
+/* signature from counts of a square motifel, the same as from the
+   signature functions if they return 1; a motifel without enough
+   valid cells gets a zero signature at once */
+static int signature_from_counts(SIGNATURE_INTEGRAL_TYPE type, int bins, int signature_len, 
+                                 int size, long nulls, unsigned int *counts, double *signature) {
+  int i;
+  long k, N, cells = (long)size*size;
+
+  if(nulls >= 0 &&
+     ((type == SIGNATURE_INTEGRAL_CELLS && 2L*(cells - nulls) < cells) ||
+      (type == SIGNATURE_INTEGRAL_PAIRS && 2L*(cells - nulls) < (long)size*(size-1)))) {
+    for(i=0; i<signature_len; i++)
+      signature[i]=0.0;
+    return 0;
+  }
+
+  if(type == SIGNATURE_INTEGRAL_ENTROPY) {
+    H_from_counts(counts, bins, signature);
+    return 1;
+  }
+
+  N = 0;
+  for(k=0; k<bins; k++) {
+    signature[k] = (double)counts[k];
+    N += counts[k];
+  }
+  if(type == SIGNATURE_INTEGRAL_PAIRS)
+    return (N < (long)size*(size-1)) ? 0 : 1;
+  return (2*N < cells) ? 0 : 1;
+}
+
+static int finish_signature(SIGNATURE_INTEGRAL *ih, int frame, unsigned int *counts, double *signature) {
+  EZGDAL_FRAME *f = &(ih->layers[0]->stripe->frame[frame]);
+
+  return signature_from_counts(ih->type, ih->bins, ih->signature_len, ih->size, 
+                               ezgdal_frame_nulls(f), counts, signature);
+}
+
+static SIGNATURE_INTEGRAL *integral_alloc(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len) {
+  SIGNATURE_INTEGRAL *ih;
+  EZGDAL_STRIPE *s;
+  int i, type, shift;
+
+  type = get_signature_integral_type(signature_name);
+  if(type == SIGNATURE_INTEGRAL_NONE) return NULL;
+
+  s = layers[0]->stripe;
+  if(s == NULL || s->frames < 2) return NULL;
+  for(i=0; i<num_of_layers; i++)
+    if(layers[i]->stripe == NULL || layers[i]->stripe->frames != s->frames ||
+       layers[i]->stats == NULL)
+      return NULL;
+
+  shift = s->frame[1].col1 - s->frame[0].col1;
+  if(shift < 1 || 2*shift > s->rows) return NULL;
+
+  ih = calloc(1, sizeof(SIGNATURE_INTEGRAL));
+  ih->type = type;
+  ih->layers = layers;
+  ih->num_of_layers = num_of_layers;
+  ih->size = s->rows;
+  ih->shift = shift;
+  ih->frames = s->frames;
+  ih->bins = (type == SIGNATURE_INTEGRAL_ENTROPY) ? layers[0]->stats->map_max_val+1 : signature_len;
+  ih->signature_len = signature_len;
+  ih->frame_lists = malloc((long)omp_get_max_threads()*num_of_layers*sizeof(EZGDAL_FRAME *));
+
+  return ih;
+}
+
+/*
+ * Integral histograms of stripes of layers, all stripes have the same
+ * frames. NULL if the signature is not an additive histogram or if
+ * motifels overlap too little to pay for the block sums: a motifel
+ * costs size*size cells directly and about size*shift cells plus
+ * a few lookups of bins here.
+ */
+SIGNATURE_INTEGRAL *signature_integral_create(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len) {
+  SIGNATURE_INTEGRAL *ih;
+  long bytes;
+
+  ih = integral_alloc(signature_name, layers, num_of_layers, signature_len);
+  if(ih == NULL) return NULL;
+
+  ih->block = gcd(ih->size, ih->shift);
+  ih->blocks = ((ih->frames-1)*ih->shift + ih->size) / ih->block;
+  bytes = 2L*(ih->blocks+1)*ih->bins*sizeof(unsigned int);
+  if((long)ih->size*ih->size <= 2*((long)ih->size*ih->shift + 4L*ih->bins) ||
+     bytes > SIGNATURE_INTEGRAL_MAX_BYTES) {
+    signature_integral_free(ih);
+    return NULL;
+  }
+
+  ih->prefix = malloc((long)(ih->blocks+1)*ih->bins*sizeof(unsigned int));
+  if(ih->type == SIGNATURE_INTEGRAL_PAIRS)
+    ih->border = malloc((long)(ih->blocks+1)*ih->bins*sizeof(unsigned int));
+  ih->counts = malloc((long)omp_get_max_threads()*ih->bins*sizeof(unsigned int));
+
+  return ih;
+}
+
+/*
+ * Sliding histograms, without memory for block sums. Every thread 
+ * should take successive frames (e.g. schedule(static)), a motifel 
+ * then costs about 2*size*shift cells. NULL as above or if motifels 
+ * overlap less than twice.
+ */
+SIGNATURE_INTEGRAL *signature_sliding_create(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len) {
+  SIGNATURE_INTEGRAL *ih;
+  int t, threads = omp_get_max_threads();
+
+  ih = integral_alloc(signature_name, layers, num_of_layers, signature_len);
+  if(ih == NULL) return NULL;
+
+  ih->is_sliding = TRUE;
+  ih->counts = malloc((long)threads*ih->bins*sizeof(unsigned int));
+  ih->last_frame = malloc(threads*sizeof(int));
+  ih->last_row1 = malloc(threads*sizeof(int));
+  for(t=0; t<threads; t++)
+    ih->last_frame[t] = -1;
+
+  return ih;
+}
+
+void signature_integral_free(SIGNATURE_INTEGRAL *ih) {
+  if(ih == NULL) return;
+  free(ih->prefix);
+  free(ih->border);
+  free(ih->counts);
+  free(ih->last_frame);
+  free(ih->last_row1);
+  free(ih->frame_lists);
+  free(ih);
+}
+
+/* block sums of the stripes, called after the stripes are loaded */
+void signature_integral_load(SIGNATURE_INTEGRAL *ih) {
+  int j;
+  long k, bins = ih->bins;
+
+  /* sliding counts notice a new stripe row by themselves */
+  if(ih->is_sliding) return;
+
+  memset(ih->prefix, 0, bins*sizeof(unsigned int));
+  if(ih->border != NULL)
+    memset(ih->border, 0, bins*sizeof(unsigned int));
+
+#pragma omp parallel for schedule(dynamic)
+  for(j=0; j<ih->blocks; j++) {
+    EZGDAL_FRAME **f = ih->frame_lists + omp_get_thread_num()*ih->num_of_layers;
+    int p = j*ih->block;
+
+    memset(ih->prefix + (j+1)*bins, 0, bins*sizeof(unsigned int));
+    add_cols(ih, p, p+ih->block, p, p+ih->block-1, f, ih->prefix + (j+1)*bins, 1);
+    /* horizontal pairs crossing the left border of the block */
+    if(ih->border != NULL && j > 0) {
+      memset(ih->border + j*bins, 0, bins*sizeof(unsigned int));
+      add_cols(ih, p, p, p-1, p, f, ih->border + j*bins, 1);
+    }
+  }
+
+  /* unsigned sums may wrap, their differences are still exact */
+  for(j=1; j<=ih->blocks; j++) {
+    unsigned int *p = ih->prefix + j*bins;
+    for(k=0; k<bins; k++)
+      p[k] += p[k-bins];
+  }
+  if(ih->border != NULL)
+    for(j=1; j<ih->blocks; j++) {
+      unsigned int *p = ih->border + j*bins;
+      for(k=0; k<bins; k++)
+        p[k] += p[k-bins];
+    }
+}
+
+/* counts of the frame of this thread moved from its last frame */
+static void slide_counts(SIGNATURE_INTEGRAL *ih, int frame, unsigned int *counts) {
+  int t = omp_get_thread_num();
+  int row1 = ih->layers[0]->stripe->row1;
+  int last = ih->last_frame[t];
+  int p1, p2;
+  EZGDAL_FRAME **f = ih->frame_lists + t*ih->num_of_layers;
+
+  p2 = frame*ih->shift;
+  if(last >= 0 && ih->last_row1[t] == row1 && last < frame &&
+     2*(frame-last)*ih->shift < ih->size) {
+    /* columns leaving on the left and coming in on the right */
+    p1 = last*ih->shift;
+    add_cols(ih, p1, p2, p1, p2, f, counts, (unsigned int)-1);
+    p1 += ih->size;
+    add_cols(ih, p1, p2+ih->size, p1-1, p2+ih->size-1, f, counts, 1);
+  } else {
+    memset(counts, 0, ih->bins*sizeof(unsigned int));
+    add_cols(ih, p2, p2+ih->size, p2, p2+ih->size-1, f, counts, 1);
+  }
+  ih->last_frame[t] = frame;
+  ih->last_row1[t] = row1;
+}
+
+/*
+ * Signature of the frame, the same as the one calculated by
+ * the signature function from the frames of the stripes.
+ */
+int signature_integral_get(SIGNATURE_INTEGRAL *ih, int frame, double *signature) {
+  long a, b, k, bins = ih->bins;
+  unsigned int *p1, *p2, *b1, *b2;
+  unsigned int *counts = ih->counts + (long)omp_get_thread_num()*bins;
+
+  if(ih->is_sliding) {
+    slide_counts(ih, frame, counts);
+    return finish_signature(ih, frame, counts, signature);
+  }
+
+  /* blocks a .. b-1 of the frame */
+  a = (long)frame*ih->shift / ih->block;
+  b = a + ih->size / ih->block;
+  p1 = ih->prefix + a*bins;
+  p2 = ih->prefix + b*bins;
+
+  if(ih->type == SIGNATURE_INTEGRAL_PAIRS) {
+    /* and pairs crossing borders a+1 .. b-1 */
+    b1 = ih->border + a*bins;
+    b2 = ih->border + (b-1)*bins;
+    for(k=0; k<bins; k++)
+      counts[k] = p2[k] - p1[k] + b2[k] - b1[k];
+  } else
+    for(k=0; k<bins; k++)
+      counts[k] = p2[k] - p1[k];
+
+  return finish_signature(ih, frame, counts, signature);
+}
+
+/*
+ * Pyramid of stripes of layers: size and shift of their frames is
+ * the block. max_size is the size of the largest motifels, levels 
+ * is the number of motifel sizes summed at the same time. NULL if 
+ * the signature is not an additive histogram or if the ring of 
+ * block rows needs too much memory.
+ */
+SIGNATURE_PYRAMID *signature_pyramid_create(char *signature_name, EZGDAL_LAYER **layers, int num_of_layers, int signature_len, int max_size, int levels) {
+  SIGNATURE_PYRAMID *py;
+  EZGDAL_STRIPE *s;
+  int i, type;
+  long n;
+
+  type = get_signature_integral_type(signature_name);
+  if(type == SIGNATURE_INTEGRAL_NONE) return NULL;
+
+  s = layers[0]->stripe;
+  if(s == NULL || s->frames < 1) return NULL;
+  if(s->frames > 1 && s->frame[1].col1 - s->frame[0].col1 != s->rows) return NULL;
+  if(max_size % s->rows != 0) return NULL;
+  for(i=0; i<num_of_layers; i++)
+    if(layers[i]->stripe == NULL || layers[i]->stripe->frames != s->frames ||
+       layers[i]->stats == NULL)
+      return NULL;
+
+  n = (long)(max_size/s->rows)*(layers[0]->cols/s->rows)*((type == SIGNATURE_INTEGRAL_PAIRS) ? 3 : 1);
+  if(n*((type == SIGNATURE_INTEGRAL_ENTROPY) ? layers[0]->stats->map_max_val+1 : signature_len)*sizeof(unsigned int) >
+     SIGNATURE_PYRAMID_MAX_BYTES)
+    return NULL;
+
+  py = calloc(1, sizeof(SIGNATURE_PYRAMID));
+  py->type = type;
+  py->layers = layers;
+  py->num_of_layers = num_of_layers;
+  py->block = s->rows;
+  py->cols = layers[0]->cols / py->block;
+  py->rows = max_size / py->block;
+  py->row = 0;
+  py->bins = (type == SIGNATURE_INTEGRAL_ENTROPY) ? layers[0]->stats->map_max_val+1 : signature_len;
+  py->signature_len = signature_len;
+
+  n = (long)py->rows*py->cols*py->bins;
+  py->cells = malloc(n*sizeof(unsigned int));
+  if(type == SIGNATURE_INTEGRAL_PAIRS) {
+    py->left = malloc(n*sizeof(unsigned int));
+    py->top = malloc(n*sizeof(unsigned int));
+    py->last_row = malloc((long)py->cols*py->block*sizeof(int));
+  }
+  py->nulls = malloc((long)py->rows*py->cols*sizeof(long));
+
+  py->levels = levels;
+  py->sums = malloc(levels*sizeof(unsigned int *));
+  py->null_sums = malloc(levels*sizeof(long *));
+  for(i=0; i<levels; i++) {
+    py->sums[i] = malloc(3L*(py->cols+1)*py->bins*sizeof(unsigned int));
+    py->null_sums[i] = malloc((py->cols+1)*sizeof(long));
+  }
+  py->counts = malloc((long)omp_get_max_threads()*py->bins*sizeof(unsigned int));
+  py->frame_lists = malloc((long)omp_get_max_threads()*num_of_layers*sizeof(EZGDAL_FRAME *));
+
+  return py;
+}
+
+void signature_pyramid_free(SIGNATURE_PYRAMID *py) {
+  int i;
+
+  if(py == NULL) return;
+  for(i=0; i<py->levels; i++) {
+    free(py->sums[i]);
+    free(py->null_sums[i]);
+  }
+  free(py->sums);
+  free(py->null_sums);
+  free(py->cells);
+  free(py->left);
+  free(py->top);
+  free(py->nulls);
+  free(py->last_row);
+  free(py->counts);
+  free(py->frame_lists);
+  free(py);
+}
+
+/* counts the next row of blocks from the stripes loaded at row*block */
+void signature_pyramid_load(SIGNATURE_PYRAMID *py) {
+  int c, b = py->block;
+  long slot = py->row % py->rows;
+
+#pragma omp parallel for schedule(dynamic)
+  for(c=0; c<py->cols; c++) {
+    int i, r, x, cat1, cat2;
+    long off = (slot*py->cols + c)*py->bins;
+    unsigned int *cells = py->cells + off;
+    long nulls = 0;
+    EZGDAL_FRAME **f = py->frame_lists + omp_get_thread_num()*py->num_of_layers;
+
+    for(i=0; i<py->num_of_layers; i++)
+      f[i] = &(py->layers[i]->stripe->frame[c]);
+    memset(cells, 0, py->bins*sizeof(unsigned int));
+
+    for(r=0; r<b; r++)
+      for(x=0; x<b; x++) {
+        cat1 = ezgdal_frame_get_cat(f[0], r, x);
+        if(cat1<0) {
+          nulls++;
+          continue;
+        }
+        switch(py->type) {
+          case SIGNATURE_INTEGRAL_CELLS:
+            cat1 = product_cat(py->layers, py->num_of_layers, f, r, x);
+            if(cat1>=0) {
+              assert(cat1<py->bins);
+              cells[cat1]++;
+            }
+            break;
+          case SIGNATURE_INTEGRAL_PAIRS:
+            if(r+1<b) {
+              cat2 = ezgdal_frame_get_cat(f[0], r+1, x);
+              if(cat2>=0)
+                cells[triangular_index(cat1,cat2)]++;
+            }
+            if(x+1<b) {
+              cat2 = ezgdal_frame_get_cat(f[0], r, x+1);
+              if(cat2>=0)
+                cells[triangular_index(cat1,cat2)]++;
+            }
+            break;
+          default:
+            cells[cat1]++;
+            break;
+        }
+      }
+    py->nulls[slot*py->cols + c] = nulls;
+
+    if(py->type == SIGNATURE_INTEGRAL_PAIRS) {
+      unsigned int *left = py->left + off;
+      unsigned int *top = py->top + off;
+
+      memset(left, 0, py->bins*sizeof(unsigned int));
+      memset(top, 0, py->bins*sizeof(unsigned int));
+      for(r=0; c>0 && r<b; r++) {
+        cat1 = ezgdal_frame_get_cat(&(py->layers[0]->stripe->frame[c-1]), r, b-1);
+        cat2 = ezgdal_frame_get_cat(f[0], r, 0);
+        if(cat1>=0 && cat2>=0)
+          left[triangular_index(cat1,cat2)]++;
+      }
+      for(x=0; py->row>0 && x<b; x++) {
+        cat1 = py->last_row[(long)c*b + x];
+        cat2 = ezgdal_frame_get_cat(f[0], 0, x);
+        if(cat1>=0 && cat2>=0)
+          top[triangular_index(cat1,cat2)]++;
+      }
+    }
+  }
+
+  /* the top borders of the next row */
+  if(py->type == SIGNATURE_INTEGRAL_PAIRS)
+    for(c=0; c<py->cols; c++) {
+      int x;
+      EZGDAL_FRAME *f = &(py->layers[0]->stripe->frame[c]);
+      for(x=0; x<b; x++)
+        py->last_row[(long)c*b + x] = ezgdal_frame_get_cat(f, b-1, x);
+    }
+
+  py->row++;
+}
+
+/*
+ * Sums of blocks of the row of motifels of the level, starting at 
+ * the raster row row1. Block rows of the motifels have to be counted 
+ * and still kept in the ring. Returns 0 if they are not.
+ */
+int signature_pyramid_sum(SIGNATURE_PYRAMID *py, int level, int row1, int size) {
+  int c, br1 = row1 / py->block, nb = size / py->block;
+  long bins = py->bins, len = (py->cols+1)*bins;
+  unsigned int *sums = py->sums[level];
+  long *null_sums = py->null_sums[level];
+
+  if(br1 + nb > py->row || br1 < py->row - py->rows) return 0;
+
+#pragma omp parallel for
+  for(c=0; c<py->cols; c++) {
+    int br;
+    long k, off;
+    unsigned int *s = sums + (c+1)*bins;
+
+    memset(s, 0, bins*sizeof(unsigned int));
+    if(py->type == SIGNATURE_INTEGRAL_PAIRS) {
+      memset(s + len, 0, bins*sizeof(unsigned int));
+      memset(s + 2*len, 0, bins*sizeof(unsigned int));
+    }
+    null_sums[c+1] = 0;
+    for(br=br1; br<br1+nb; br++) {
+      off = ((long)(br % py->rows)*py->cols + c)*bins;
+      for(k=0; k<bins; k++)
+        s[k] += py->cells[off+k];
+      if(py->type == SIGNATURE_INTEGRAL_PAIRS) {
+        /* pairs crossing left borders of all block rows, 
+           top borders only inside the motifel */
+        for(k=0; k<bins; k++)
+          s[len+k] += py->left[off+k];
+        if(br > br1)
+          for(k=0; k<bins; k++)
+            s[2*len+k] += py->top[off+k];
+      }
+      null_sums[c+1] += py->nulls[(long)(br % py->rows)*py->cols + c];
+    }
+  }
+
+  /* sums from the left */
+  memset(sums, 0, bins*sizeof(unsigned int));
+  memset(sums + len, 0, bins*sizeof(unsigned int));
+  memset(sums + 2*len, 0, bins*sizeof(unsigned int));
+  null_sums[0] = 0;
+  for(c=1; c<=py->cols; c++) {
+    long k;
+    unsigned int *s = sums + c*bins;
+    for(k=0; k<bins; k++)
+      s[k] += s[k-bins];
+    if(py->type == SIGNATURE_INTEGRAL_PAIRS)
+      for(k=0; k<bins; k++) {
+        s[len+k] += s[len+k-bins];
+        s[2*len+k] += s[2*len+k-bins];
+      }
+    null_sums[c] += null_sums[c-1];
+  }
+
+  return 1;
+}
+
+/* signature of the motifel of the summed row of the level at the column col1 */
+int signature_pyramid_get(SIGNATURE_PYRAMID *py, int level, int col1, int size, double *signature) {
+  long a, b, k, bins = py->bins, len = (py->cols+1)*bins;
+  unsigned int *sums = py->sums[level];
+  unsigned int *counts = py->counts + (long)omp_get_thread_num()*bins;
+  unsigned int *c1, *c2;
+
+  /* blocks a .. b-1 of the motifel */
+  a = col1 / py->block;
+  b = a + size / py->block;
+  c1 = sums + a*bins;
+  c2 = sums + b*bins;
+
+  if(py->type == SIGNATURE_INTEGRAL_PAIRS) {
+    /* and pairs crossing left borders of blocks a+1 .. b-1 */
+    unsigned int *l1 = sums + len + (a+1)*bins;
+    unsigned int *l2 = sums + len + b*bins;
+    unsigned int *t1 = sums + 2*len + a*bins;
+    unsigned int *t2 = sums + 2*len + b*bins;
+    for(k=0; k<bins; k++)
+      counts[k] = c2[k] - c1[k] + l2[k] - l1[k] + t2[k] - t1[k];
+  } else
+    for(k=0; k<bins; k++)
+      counts[k] = c2[k] - c1[k];
+
+  return signature_from_counts(py->type, py->bins, py->signature_len, size,
+                               py->null_sums[level][b] - py->null_sums[level][a],
+                               counts, signature);
+}
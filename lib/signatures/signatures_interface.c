@@ -54,6 +54,32 @@ char *get_signature_description(char *signature_name) {
   return NULL;
 }
 
+int is_signature_categorical(char *signature_name) {
+  
+  signature_rec *p = signatures_list;
+  
+  while(p->name != NULL) {
+    if(strcmp(signature_name,p->name)==0)
+      return p->categorical;
+    p++;
+  }
+  
+  return 0;
+}
+
+int get_signature_integral_type(char *signature_name) {
+  
+  signature_rec *p = signatures_list;
+  
+  while(p->name != NULL) {
+    if(strcmp(signature_name,p->name)==0)
+      return p->integral;
+    p++;
+  }
+  
+  return SIGNATURE_INTEGRAL_NONE;
+}
+
 char *list_all_signatures() {
   int len;
   char *buf;
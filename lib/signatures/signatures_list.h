@@ -37,25 +37,27 @@ typedef struct {
 	char *name;
 	signature_func *signature;
 	signature_len_func *signature_len;
+	int categorical;   /* uses category indices only (ezgdal_frame_get_cat) */
+	int integral;      /* SIGNATURE_INTEGRAL_TYPE of an additive histogram */
 	char *description;
 } signature_rec;
 
 signature_rec signatures_list[] = {
-	{ "prod", cartesianproduct, cartesianproduct_len, "Cartesian product of input category lists" },
-	{ "cooc", coocurrence, coocurrence_len, "Spatial coocurrence of categories" },
-	{ "fdec", full_decomposition, full_decomposition_len, "Full decomposition" },
-	{ "lind", landind, landind_len, "Landscape indices vector" },
-	{ "linds", landind_short, landind_short_len, "Selected landscape indices vector" },
+	{ "prod", cartesianproduct, cartesianproduct_len, 1, SIGNATURE_INTEGRAL_CELLS, "Cartesian product of input category lists" },
+	{ "cooc", coocurrence, coocurrence_len, 1, SIGNATURE_INTEGRAL_PAIRS, "Spatial coocurrence of categories" },
+	{ "fdec", full_decomposition, full_decomposition_len, 1, SIGNATURE_INTEGRAL_NONE, "Full decomposition" },
+	{ "lind", landind, landind_len, 1, SIGNATURE_INTEGRAL_NONE, "Landscape indices vector" },
+	{ "linds", landind_short, landind_short_len, 1, SIGNATURE_INTEGRAL_NONE, "Selected landscape indices vector" },
 /*************************
  *
  *   Experimental code
-  { "sdec", decomposition, decomposition_len, "Simple 2-level decomposition" },
-	{ "lbp", local_binary_pattern, local_binary_pattern_len, "Histogram of local binary patterns" },
-	{ "jcov", jcov, jcov_len, "J-Coocurrence vector" },
+  { "sdec", decomposition, decomposition_len, 1, SIGNATURE_INTEGRAL_NONE, "Simple 2-level decomposition" },
+	{ "lbp", local_binary_pattern, local_binary_pattern_len, 0, SIGNATURE_INTEGRAL_NONE, "Histogram of local binary patterns" },
+	{ "jcov", jcov, jcov_len, 1, SIGNATURE_INTEGRAL_NONE, "J-Coocurrence vector" },
  *
  ************************/
-	{ "ent", H, H_len, "Shannon entropy" },
-	{ NULL, NULL, NULL, 0 }
+	{ "ent", H, H_len, 1, SIGNATURE_INTEGRAL_ENTROPY, "Shannon entropy" },
+	{ NULL, NULL, NULL, 0, SIGNATURE_INTEGRAL_NONE, 0 }
 };
 
 #endif
@@ -0,0 +1,131 @@
+/****************************************************************************
+ *
+ * MODULE:	Signatures library
+ * AUTHOR(S):	Pawel Netzel
+ * COPYRIGHT:	(C) Space Informatics Lab, Univeristy of Cincinnati
+ *
+ *		This program is free software under the GNU General Public
+ *		License (>=v2). Read the file COPYING that comes with GRASS
+ *		for details.
+ *
+ *****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "signatures.h"
+
+/*
+ * signatures of the set, every one with its own normalization method
+ * (NULL - not normalized); returns NULL if a name is wrong or a length
+ * of a signature cannot be determined
+ */
+SIGNATURE_SET *signature_set_create(char **signature_names, signature_norm_func **normalizations,
+                                    int signatures, EZGDAL_LAYER **layers, int num_of_layers, int level) {
+  int i;
+  SIGNATURE_SET *set = (SIGNATURE_SET *)calloc(1, sizeof(SIGNATURE_SET));
+
+  set->signatures = signatures;
+  set->level = level;
+  set->names = (char **)malloc(signatures*sizeof(char *));
+  set->signature = (signature_func **)malloc(signatures*sizeof(signature_func *));
+  set->normalization = (signature_norm_func **)malloc(signatures*sizeof(signature_norm_func *));
+  set->num_of_frames = (int *)malloc(signatures*sizeof(int));
+  set->signature_len = (int *)malloc(signatures*sizeof(int));
+  set->offset = (int *)malloc(signatures*sizeof(int));
+  set->integral = (SIGNATURE_INTEGRAL **)calloc(signatures, sizeof(SIGNATURE_INTEGRAL *));
+
+  for(i=0; i<signatures; i++) {
+    signature_len_func *len_func = get_signature_len(signature_names[i]);
+
+    set->names[i] = signature_names[i];
+    set->signature[i] = get_signature(signature_names[i]);
+    set->normalization[i] = (normalizations != NULL) ? normalizations[i] : NULL;
+    /* only 'prod' combines all layers, other signatures use the first one */
+    set->num_of_frames[i] = (strcmp(signature_names[i],"prod")==0) ? num_of_layers : 1;
+    if(set->signature[i] == NULL || len_func == NULL ||
+       (set->signature_len[i] = len_func(layers, set->num_of_frames[i], level)) < 0) {
+      set->signatures = i;
+      signature_set_free(set);
+      return NULL;
+    }
+    set->offset[i] = set->len;
+    set->len += set->signature_len[i];
+  }
+
+  return set;
+}
+
+void signature_set_free(SIGNATURE_SET *set) {
+  int i;
+
+  if(set == NULL) return;
+  for(i=0; i<set->signatures; i++)
+    signature_integral_free(set->integral[i]);
+  free(set->names);
+  free(set->signature);
+  free(set->normalization);
+  free(set->num_of_frames);
+  free(set->signature_len);
+  free(set->offset);
+  free(set->integral);
+  free(set);
+  H_free();
+}
+
+/*
+ * additive signatures are taken from integral histograms of the stripes,
+ * or from sliding ones if block sums need too much memory; the stripes
+ * and frames have to be created, returns number of such signatures
+ */
+int signature_set_integrals(SIGNATURE_SET *set, EZGDAL_LAYER **layers) {
+  int i, n = 0;
+
+  for(i=0; i<set->signatures; i++) {
+    set->integral[i] = signature_integral_create(set->names[i], layers, set->num_of_frames[i], set->signature_len[i]);
+    if(set->integral[i] == NULL)
+      set->integral[i] = signature_sliding_create(set->names[i], layers, set->num_of_frames[i], set->signature_len[i]);
+    if(set->integral[i] != NULL) {
+      if(set->integral[i]->is_sliding)
+        set->is_sliding = 1;
+      n++;
+    }
+  }
+
+  return n;
+}
+
+/* called after the stripes are loaded */
+void signature_set_load(SIGNATURE_SET *set) {
+  int i;
+
+  for(i=0; i<set->signatures; i++)
+    if(set->integral[i] != NULL)
+      signature_integral_load(set->integral[i]);
+}
+
+/*
+ * all signatures of the motifel of frames (the frame of stripes),
+ * signatures[i] points to space for the i-th one; results[i] is 1
+ * for a valid signature, 0 for an empty motifel and -1 if normalization
+ * failed; returns number of valid signatures
+ */
+int signature_set_calc(SIGNATURE_SET *set, EZGDAL_FRAME **frames, int frame,
+                       double **signatures, int *results) {
+  int i, n = 0;
+
+  for(i=0; i<set->signatures; i++) {
+    if(set->integral[i] != NULL)
+      results[i] = signature_integral_get(set->integral[i], frame, signatures[i]);
+    else
+      results[i] = set->signature[i](frames, set->num_of_frames[i], signatures[i],
+                                     set->signature_len[i], set->level);
+    if(results[i] != 1)
+      continue;
+    if(set->normalization[i] != NULL && set->normalization[i](signatures[i], set->signature_len[i]) != 0)
+      results[i] = -1;
+    else
+      n++;
+  }
+
+  return n;
+}